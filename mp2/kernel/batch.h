@@ -0,0 +1,82 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Batched system calls.
+ *
+ * User space queues system calls in a struct batch_ring in its own
+ * memory and runs all of them with a single batch() trap, reading
+ * their results back from the ring's completion queue. The kernel
+ * runs each entry through the same syscalls[] table as an ordinary
+ * ecall. This header is shared with user space.
+ */
+
+#define BATCH_ENTRIES 64 // slots in each queue, must be a power of 2
+
+// sqe flags: argument k holds the queue position (the sq_tail it was
+// queued at) of an earlier entry run by the same batch() call, whose
+// result is passed instead. Lets e.g. an fstat() use the descriptor
+// an open() in the same batch returned.
+#define BATCH_ARGREF(k) (1 << (k))
+
+/**
+ * struct batch_sqe - A queued system call (64 bytes)
+ * @num: System call number from syscall.h
+ * @flags: BATCH_ARGREF() bits
+ * @args: Arguments, as they would be in a0-a5
+ * @user_data: Copied to the call's &struct batch_cqe
+ */
+struct batch_sqe
+{
+  int num;
+  int flags;
+  uint64 args[6];
+  uint64 user_data;
+};
+
+/**
+ * struct batch_cqe - A finished system call (16 bytes)
+ * @user_data: From the &struct batch_sqe
+ * @result: What the system call returned; -1 if it is not allowed
+ *          in a batch or an %BATCH_ARGREF() index is bad
+ */
+struct batch_cqe
+{
+  uint64 user_data;
+  uint64 result;
+};
+
+/**
+ * struct batch_ring - Submission and completion queues
+ * @sq_head: Next submission the kernel runs; written by the kernel
+ * @sq_tail: Where user space queues the next submission
+ * @cq_head: Next completion user space reads
+ * @cq_tail: Where the kernel posts the next completion
+ * @sq: Submission slots, indexed by head/tail mod %BATCH_ENTRIES
+ * @cq: Completion slots, likewise
+ *
+ * The counters only grow; a queue is empty when its head equals its
+ * tail and full when they are %BATCH_ENTRIES apart.
+ */
+struct batch_ring
+{
+  uint sq_head;
+  uint sq_tail;
+  uint cq_head;
+  uint cq_tail;
+  struct batch_sqe sq[BATCH_ENTRIES];
+  struct batch_cqe cq[BATCH_ENTRIES];
+};
+
+/**
+ * sys_batch - System call to run the queued system calls
+ *
+ * Takes a user pointer to a &struct batch_ring. Runs submissions in
+ * order until the submission queue is empty, the completion queue is
+ * full, or the process is killed. fork(), exit(), exec() and batch()
+ * itself cannot be batched.
+ *
+ * Return: Number of submissions run, or -1 on a bad ring pointer
+ */
+uint64 sys_batch(void);
@@ -22,6 +22,7 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 struct {
   struct spinlock lock;
@@ -96,8 +97,11 @@ bread(uint dev, uint blockno)
 
   b = bget(dev, blockno);
   if(!b->valid) {
+    trace(TRACE_BIO_MISS, dev, blockno);
     virtio_disk_rw(b, 0);
     b->valid = 1;
+  } else {
+    trace(TRACE_BIO_HIT, dev, blockno);
   }
   return b;
 }
@@ -108,6 +112,7 @@ bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
+  trace(TRACE_BIO_WRITE, b->dev, b->blockno);
   virtio_disk_rw(b, 1);
 }
 
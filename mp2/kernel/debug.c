@@ -21,5 +21,5 @@ uint64
 sys_debugswitch(void)
 {
   debugswitch();
-  return 0;
+  return get_mode();
 }
@@ -39,7 +39,7 @@ enum debug_mode_t get_mode(void);
  * Provides the system call interface to toggle the debug mode.
  * This function is intended to be invoked via a syscall mechanism.
  *
- * Return: 0 on success, or an error code on failure
+ * Return: The new debug mode, %OFF (0) or %ON (1)
  */
 uint64 sys_debugswitch(void);
 
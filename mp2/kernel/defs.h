@@ -24,6 +24,7 @@ void            consputc(int);
 
 // exec.c
 int             exec(char*, char**);
+int             loadpage(struct proc*, uint64, char*, int*);
 
 // file.c
 struct file*    filealloc(void);
@@ -61,6 +62,8 @@ void            ramdiskrw(struct buf*);
 
 // kalloc.c
 void*           kalloc(void);
+void*           kallocmega(void);
+void            kfreemega(void *);
 void            kfree(void *);
 void            kinit(void);
 
@@ -71,7 +74,7 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
-int             pipealloc(struct file**, struct file**);
+int             pipealloc(struct file**, struct file**, int, int);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
@@ -80,6 +83,9 @@ int             pipewrite(struct pipe*, uint64, int);
 int            printf(char*, ...) __attribute__ ((format (printf, 1, 2)));
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
+void            prputc(int);
+void            prflush(void);
+int             prgetc(void);
 
 // proc.c
 int             cpuid(void);
@@ -113,8 +119,10 @@ void            swtch(struct context*, struct context*);
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
+int             holdingany(void);
 void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
+int             tryacquire(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
@@ -142,17 +150,18 @@ int             fetchaddr(uint64, uint64*);
 void            syscall();
 
 // trap.c
-extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+void            sendipi(int);
 
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
 void            uartputc_sync(int);
+void            uartkick(void);
 int             uartgetc(void);
 
 // vm.c
@@ -169,10 +178,15 @@ void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
+pte_t *         walklevel(pagetable_t, uint64, int, int);
+uint64          ptpages(pagetable_t);
+uint64          kvmptpages(void);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
+int             uvmfault(uint64, int);
+void            uvmprefault(uint64, uint64, int);
 
 // plic.c
 void            plicinit(void);
@@ -6,8 +6,10 @@
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
-
-static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "mmap.h"
 
 int flags2perm(int flags)
 {
@@ -26,8 +28,10 @@ exec(char *path, char **argv)
   int i, off;
   uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *execip = 0, *oldip;
   struct proghdr ph;
+  struct execseg seg[NEXECSEG];
+  int nseg = 0;
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
@@ -49,7 +53,8 @@ exec(char *path, char **argv)
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Note where the program's segments are; loadpage() reads
+  // each page in when it is first touched.
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -61,15 +66,24 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz, flags2perm(ph.flags))) == 0)
+    if(ph.vaddr < sz || nseg == NEXECSEG)
       goto bad;
-    sz = sz1;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(ph.off + ph.filesz < ph.off || ph.off + ph.filesz > ip->size)
       goto bad;
+    seg[nseg].va = ph.vaddr;
+    seg[nseg].memsz = ph.memsz;
+    seg[nseg].filesz = ph.filesz;
+    seg[nseg].off = ph.off;
+    seg[nseg].perm = flags2perm(ph.flags);
+    nseg++;
+    sz = ph.vaddr + ph.memsz;
   }
-  iunlockput(ip);
+  if(PGROUNDUP(sz) + (USERSTACK+1)*PGSIZE > TRAPFRAME)
+    goto bad;
+  // keep a reference to the file for loadpage().
+  iunlock(ip);
   end_op();
+  execip = ip;
   ip = 0;
 
   p = myproc();
@@ -121,12 +135,25 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  munmapall(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  oldip = p->execip;
+  p->execip = execip;
+  memmove(p->seg, seg, sizeof(seg));
+  p->nseg = nseg;
+  p->nfault = 0;
+  p->nload = 0;
+  p->megapages = 0;
   proc_freepagetable(oldpagetable, oldsz);
+  if(oldip){
+    begin_op();
+    iput(oldip);
+    end_op();
+  }
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
@@ -137,30 +164,53 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(execip){
+    begin_op();
+    iput(execip);
+    end_op();
+  }
   return -1;
 }
 
-// Load a program segment into pagetable at virtual address va.
-// va must be page-aligned
-// and the pages from va to va+sz must already be mapped.
-// Returns 0 on success, -1 on failure.
-static int
-loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
+// Fill mem, a zeroed page, with the contents of user page va of
+// p's executable, up to the end of the file-backed part of its
+// segment. Returns 1 and sets *perm to the segment's PTE bits if
+// va is in a segment, 0 if it is not, or -1 if the file could not
+// be read.
+int
+loadpage(struct proc *p, uint64 va, char *mem, int *perm)
 {
-  uint i, n;
-  uint64 pa;
-
-  for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == 0)
-      panic("loadseg: address should exist");
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
-      return -1;
+  struct execseg *s;
+  uint64 n;
+
+  for(s = p->seg; s < &p->seg[p->nseg]; s++)
+    if(va >= s->va && va < s->va + s->memsz)
+      break;
+  if(s == &p->seg[p->nseg])
+    return 0;
+  *perm = s->perm;
+  if(va - s->va >= s->filesz)
+    return 1;
+
+  // readi() may sleep, which is not allowed with a spinlock held;
+  // system calls that copy to user space under one prefault the
+  // buffer with uvmprefault() first.
+  if(holdingany())
+    return -1;
+  // a read() of the executable into one of its own pages that
+  // uvmprefault() could not load holds the inode lock already.
+  if(holdingsleep(&p->execip->lock))
+    return -1;
+
+  n = s->filesz - (va - s->va);
+  if(n > PGSIZE)
+    n = PGSIZE;
+  ilock(p->execip);
+  if(readi(p->execip, 0, (uint64)mem, s->off + (va - s->va), n) != n){
+    iunlock(p->execip);
+    return -1;
   }
-  
-  return 0;
+  iunlock(p->execip);
+  p->nload++;
+  return 1;
 }
@@ -3,3 +3,17 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+
+// pipe2() flags
+#define PIPE_ZEROCOPY 0x1 // exchange whole aligned pages instead of copying
+
+// mmap() protection
+#define PROT_READ     0x1
+#define PROT_WRITE    0x2
+
+// mmap() flags
+#define MAP_SHARED    0x01 // writes reach the file and other mappers
+#define MAP_PRIVATE   0x02 // read-only private view of a file
+#define MAP_ANON      0x04 // zero-filled memory, no file
+
+#define MAP_FAILED    ((void*)-1)
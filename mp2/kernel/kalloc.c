@@ -1,6 +1,7 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// and 2 MiB megapages from a pool at the top of RAM.
 
 #include "types.h"
 #include "param.h"
@@ -23,11 +24,32 @@ struct {
   struct run *freelist;
 } kmem;
 
+// Megapages need 2 MiB of contiguous, aligned memory, which the
+// page free list cannot find, so the top NMEGAPOOL megapages of
+// RAM are kept apart for them. kalloc() breaks one up into pages
+// when it runs out; those pages never return to the pool.
+#ifdef NOMEGAPAGE
+#define NMEGAPOOL 0
+#else
+#define NMEGAPOOL 8
+#endif
+#define MEGAPOOL (PHYSTOP - NMEGAPOOL * MEGAPGSIZE)
+
+struct {
+  struct spinlock lock;
+  struct run *freelist;
+} kmega;
+
 void
 kinit()
 {
+  char *p;
+
   initlock(&kmem.lock, "kmem");
-  freerange(end, (void*)PHYSTOP);
+  initlock(&kmega.lock, "kmega");
+  freerange(end, (void*)MEGAPOOL);
+  for(p = (char*)MEGAPOOL; p + MEGAPGSIZE <= (char*)PHYSTOP; p += MEGAPGSIZE)
+    kfreemega(p);
 }
 
 void
@@ -76,7 +98,45 @@ kalloc(void)
     kmem.freelist = r->next;
   release(&kmem.lock);
 
+  if(r == 0 && (r = kallocmega()) != 0){
+    // out of pages: break up a megapage.
+    for(char *p = (char*)r + PGSIZE; p < (char*)r + MEGAPGSIZE; p += PGSIZE)
+      kfree(p);
+  }
+
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
+
+// Free a megapage returned by kallocmega().
+void
+kfreemega(void *pa)
+{
+  struct run *r;
+
+  if(((uint64)pa % MEGAPGSIZE) != 0 || (uint64)pa < MEGAPOOL || (uint64)pa >= PHYSTOP)
+    panic("kfreemega");
+
+  r = (struct run*)pa;
+
+  acquire(&kmega.lock);
+  r->next = kmega.freelist;
+  kmega.freelist = r;
+  release(&kmega.lock);
+}
+
+// Allocate one 2 MiB, 2 MiB-aligned megapage, not zeroed.
+// Returns 0 if the pool is empty.
+void *
+kallocmega(void)
+{
+  struct run *r;
+
+  acquire(&kmega.lock);
+  r = kmega.freelist;
+  if(r)
+    kmega.freelist = r->next;
+  release(&kmega.lock);
+  return (void*)r;
+}
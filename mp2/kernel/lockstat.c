@@ -0,0 +1,126 @@
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "lockstat.h"
+
+// Counters one CPU keeps for one lock class. Only that CPU writes
+// them, with interrupts off, so they need no atomics; the alignment
+// keeps CPUs off each other's cache lines.
+struct lockstat_cpu {
+  uint64 nacquire;
+  uint64 ncontended;
+  uint64 spins;
+  uint64 maxwait;
+  uint64 hist[LOCKSTAT_NHIST];
+} __attribute__((aligned(64)));
+
+struct lockclass {
+  char name[LOCKSTAT_NAME];
+  struct lockstat_cpu cpu[NCPU];
+};
+
+static struct lockclass classes[NLOCKSTAT];
+static int nclasses;
+
+// protects classes[] and nclasses. a bare flag rather than a
+// struct spinlock, since initlock() is what calls in here.
+static uint registry_busy;
+
+struct lockclass *
+lockstat_class(char *name)
+{
+  struct lockclass *lc = 0;
+  int i;
+
+  push_off();
+  while(__sync_lock_test_and_set(&registry_busy, 1) != 0)
+    ;
+  __sync_synchronize();
+
+  for(i = 0; i < nclasses; i++){
+    if(strncmp(classes[i].name, name, LOCKSTAT_NAME - 1) == 0){
+      lc = &classes[i];
+      break;
+    }
+  }
+  if(lc == 0 && nclasses < NLOCKSTAT){
+    lc = &classes[nclasses];
+    safestrcpy(lc->name, name, LOCKSTAT_NAME);
+    __sync_synchronize();
+    nclasses++;
+  }
+
+  __sync_synchronize();
+  __sync_lock_release(&registry_busy);
+  pop_off();
+  return lc;
+}
+
+void
+lockstat_record(struct lockclass *lc, int contended, uint64 wait)
+{
+  struct lockstat_cpu *s = &lc->cpu[cpuid()];
+  int b;
+
+  s->nacquire++;
+  if(!contended)
+    return;
+  s->ncontended++;
+  s->spins += wait;
+  if(wait > s->maxwait)
+    s->maxwait = wait;
+  for(b = 0; b < LOCKSTAT_NHIST - 1 && (wait >> (b + 1)) != 0; b++)
+    ;
+  s->hist[b]++;
+}
+
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int max, n, i, c, b;
+  struct lockstat ls;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argint(1, &max);
+
+  if(addr == 0){
+    // racing updates may survive the reset; that is fine for
+    // statistics.
+    n = nclasses;
+    for(i = 0; i < n; i++)
+      memset(classes[i].cpu, 0, sizeof(classes[i].cpu));
+#ifdef LOCK_TICKET
+    return LOCKSTAT_TICKET;
+#else
+    return LOCKSTAT_TAS;
+#endif
+  }
+
+  n = nclasses;
+  if(n > max)
+    n = max;
+  for(i = 0; i < n; i++){
+    struct lockclass *lc = &classes[i];
+    memset(&ls, 0, sizeof(ls));
+    safestrcpy(ls.name, lc->name, LOCKSTAT_NAME);
+    for(c = 0; c < NCPU; c++){
+      struct lockstat_cpu *s = &lc->cpu[c];
+      ls.nacquire += s->nacquire;
+      ls.ncontended += s->ncontended;
+      ls.spins += s->spins;
+      if(s->maxwait > ls.maxwait)
+        ls.maxwait = s->maxwait;
+      for(b = 0; b < LOCKSTAT_NHIST; b++)
+        ls.hist[b] += s->hist[b];
+    }
+    if(copyout(p->pagetable, addr + i * sizeof(ls), (char *)&ls, sizeof(ls)) < 0)
+      return -1;
+  }
+  return n;
+}
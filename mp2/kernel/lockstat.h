@@ -0,0 +1,71 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Spinlock contention statistics.
+ *
+ * Counters are kept per lock class, i.e. per name passed to
+ * initlock(), the way the many "proc" or "pipe" locks are really
+ * one lock as far as contention goes. This header is shared with
+ * user space for the lockstat() system call.
+ */
+
+#define NLOCKSTAT       48 // maximum number of lock classes
+#define LOCKSTAT_NAME   16 // bytes of class name kept
+#define LOCKSTAT_NHIST  24 // log2 buckets of wait time
+
+// lock implementations, reported by lockstat(0, 0).
+#define LOCKSTAT_TAS    0  // test-and-set
+#define LOCKSTAT_TICKET 1  // FIFO ticket lock
+
+/**
+ * struct lockstat - Contention counters for one lock class
+ * @name: Name given to initlock()
+ * @nacquire: Number of acquire() calls
+ * @ncontended: Acquisitions that found the lock held
+ * @spins: Total r_time() ticks spent waiting
+ * @maxwait: Longest single wait, in r_time() ticks
+ * @hist: hist[i] counts contended waits of [2^i, 2^(i+1)) ticks
+ */
+struct lockstat
+{
+  char name[LOCKSTAT_NAME];
+  uint64 nacquire;
+  uint64 ncontended;
+  uint64 spins;
+  uint64 maxwait;
+  uint64 hist[LOCKSTAT_NHIST];
+};
+
+struct lockclass;
+
+/**
+ * lockstat_class - Find or create the counters for a lock name
+ * @name: Lock name as given to initlock()
+ *
+ * Return: The class, or 0 if the table is full
+ */
+struct lockclass *lockstat_class(char *name);
+
+/**
+ * lockstat_record - Account one acquisition
+ * @lc: Class of the lock that was acquired
+ * @contended: Non-zero if the lock was held when acquire() started
+ * @wait: r_time() ticks spent spinning
+ *
+ * Called by acquire() with interrupts off; counters are per CPU so
+ * no atomic operations are needed.
+ */
+void lockstat_record(struct lockclass *lc, int contended, uint64 wait);
+
+/**
+ * sys_lockstat - System call to read lock statistics
+ *
+ * Takes a user buffer of &struct lockstat and its capacity. With a
+ * null buffer, resets all counters instead.
+ *
+ * Return: Number of classes copied, or the lock implementation
+ *         (%LOCKSTAT_TAS or %LOCKSTAT_TICKET) on reset, or -1 on error
+ */
+uint64 sys_lockstat(void);
@@ -6,6 +6,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -135,6 +136,7 @@ begin_op(void)
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      trace(TRACE_LOG_BEGIN, log.outstanding, log.lh.n);
       release(&log.lock);
       break;
     }
@@ -194,6 +196,7 @@ static void
 commit()
 {
   if (log.lh.n > 0) {
+    trace(TRACE_LOG_COMMIT, log.lh.n, 0);
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
     install_trans(0); // Now install writes to home locations
@@ -4,6 +4,9 @@
 #include "riscv.h"
 #include "defs.h"
 #include "mp2_checker.h"
+#include "mmap.h"
+#include "prof.h"
+#include "trace.h"
 
 volatile static int started = 0;
 
@@ -29,6 +32,9 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    mmapinit();      // mmap() objects
+    traceinit();     // trace ring readers
+    profinit();      // profiler sample readers
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
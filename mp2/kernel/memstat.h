@@ -0,0 +1,64 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * User memory statistics of a process, shared with user space for
+ * the memstat() system call. Pages are PGSIZE bytes.
+ */
+
+/**
+ * struct memstat - Memory use of one process
+ * @exited: Non-zero if the process has exited and awaits wait()
+ * @sz: Size of the address space in bytes, stack included
+ * @resident: User pages actually mapped
+ * @nfault: Pages made resident on demand since exec()
+ * @nload: How many of those were read from the executable
+ * @ptpages: Pages used by the process's page table
+ * @kptpages: Pages used by the kernel page table
+ */
+struct memstat
+{
+  int exited;
+  uint64 sz;
+  uint64 resident;
+  uint64 nfault;
+  uint64 nload;
+  uint64 ptpages;
+  uint64 kptpages;
+};
+
+/**
+ * procmemstat - Collect the memory statistics of a process
+ * @pid: The process, or 0 for the caller
+ * @st: Filled in on success
+ *
+ * Only the caller itself and its exited, not yet waited-for
+ * children can be inspected, so the page table cannot be freed
+ * while it is walked.
+ *
+ * Return: 0 on success, or -1 if @pid is not one of those
+ */
+int procmemstat(int pid, struct memstat *st);
+
+/**
+ * sys_memstat - System call to read memory statistics
+ *
+ * Takes a pid (0 for the caller) and a user &struct memstat.
+ *
+ * Return: 0 on success, or -1 on error
+ */
+uint64 sys_memstat(void);
+
+/**
+ * sys_megapages - System call to back the heap with megapages
+ *
+ * Takes 1 to turn megapages on for the caller, 0 to turn them off,
+ * or -1 to only query. While on, a page fault in a 2 MiB-aligned
+ * block of untouched heap maps the whole block with one zeroed
+ * megapage. The setting is inherited by fork() and reset by exec().
+ *
+ * Return: The previous setting, or -1 if the kernel was built
+ *         with NOMEGAPAGE
+ */
+uint64 sys_megapages(void);
@@ -0,0 +1,374 @@
+//
+// mmap() and munmap(): file mappings and shared memory.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
+#include "mmap.h"
+
+// The pages behind one mmap() call, shared by every process
+// that inherited the mapping through fork().
+struct mmapobj {
+  int ref;              // mappings referring to this; mtable.lock
+  struct sleeplock lock; // protects pages[] while loading
+  struct file *f;       // backing file, or 0 for MAP_ANON
+  uint off;             // file offset of page 0
+  int shared;           // MAP_SHARED: write dirty pages back
+  int npages;
+  uint64 *pages;        // physical pages, 0 until first touched
+  uint dirty[MMAP_MAXPAGES / 32]; // pages stored to through a mapping
+};
+
+static struct {
+  struct spinlock lock;
+  struct mmapobj obj[NMMAPOBJ];
+} mtable;
+
+void
+mmapinit(void)
+{
+  initlock(&mtable.lock, "mmap");
+}
+
+static struct mmapobj*
+objalloc(struct file *f, uint off, int npages, int shared)
+{
+  struct mmapobj *o;
+  uint64 *pages;
+
+  if((pages = (uint64*)kalloc()) == 0)
+    return 0;
+  memset(pages, 0, PGSIZE);
+  acquire(&mtable.lock);
+  for(o = mtable.obj; o < &mtable.obj[NMMAPOBJ]; o++){
+    if(o->ref == 0){
+      o->ref = 1;
+      release(&mtable.lock);
+      initsleeplock(&o->lock, "mmapobj");
+      o->f = f ? filedup(f) : 0;
+      o->off = off;
+      o->shared = shared;
+      o->npages = npages;
+      o->pages = pages;
+      memset(o->dirty, 0, sizeof(o->dirty));
+      return o;
+    }
+  }
+  release(&mtable.lock);
+  kfree(pages);
+  return 0;
+}
+
+static void
+objdup(struct mmapobj *o)
+{
+  acquire(&mtable.lock);
+  o->ref++;
+  release(&mtable.lock);
+}
+
+// Write the page at physical address pa back to file offset
+// off, stopping at end of file, in pieces small enough for one
+// log transaction each, like filewrite().
+static void
+writeback(struct file *f, uint off, uint64 pa)
+{
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  uint n, m;
+
+  for(n = 0; n < PGSIZE; n += m){
+    begin_op();
+    ilock(f->ip);
+    m = 0;
+    if(off + n < f->ip->size){
+      m = PGSIZE - n;
+      if(m > f->ip->size - (off + n))
+        m = f->ip->size - (off + n);
+      if(m > max)
+        m = max;
+      if(writei(f->ip, 0, pa + n, off + n, m) != m)
+        m = 0;
+    }
+    iunlock(f->ip);
+    end_op();
+    if(m == 0)
+      break;
+  }
+}
+
+static int
+isdirty(struct mmapobj *o, int i)
+{
+  return o->dirty[i / 32] & (1 << (i % 32));
+}
+
+// Write back the dirty pages [first, first+n) of o, after a
+// process unmapped them. Every store goes through some mapping
+// that is unmapped later, so this is all the write-back needed;
+// dirty bits stay set since other processes may still map the
+// pages.
+static void
+objsync(struct mmapobj *o, int first, int n)
+{
+  int i;
+
+  if(o->f == 0 || !o->shared)
+    return;
+  for(i = first; i < first + n; i++){
+    if(o->pages[i] == 0 || !isdirty(o, i))
+      continue;
+    writeback(o->f, o->off + i * PGSIZE, o->pages[i]);
+  }
+}
+
+static void
+objput(struct mmapobj *o)
+{
+  int i;
+
+  acquire(&mtable.lock);
+  if(o->ref < 1)
+    panic("objput");
+  if(o->ref > 1){
+    o->ref--;
+    release(&mtable.lock);
+    return;
+  }
+  release(&mtable.lock);
+
+  // last reference: nobody else can reach o until ref drops.
+  for(i = 0; i < o->npages; i++)
+    if(o->pages[i])
+      kfree((void*)o->pages[i]);
+  kfree(o->pages);
+  if(o->f)
+    fileclose(o->f);
+  o->pages = 0;
+  o->f = 0;
+
+  acquire(&mtable.lock);
+  o->ref = 0;
+  release(&mtable.lock);
+}
+
+static struct vma*
+findvma(struct proc *p, uint64 va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->addr && va >= v->addr && va < v->addr + v->len)
+      return v;
+  return 0;
+}
+
+int
+mmapfault(struct proc *p, uint64 va, int write)
+{
+  struct vma *v;
+  struct mmapobj *o;
+  pte_t *pte;
+  char *mem;
+  uint64 pa;
+  int i, perm;
+
+  va = PGROUNDDOWN(va);
+  if((v = findvma(p, va)) == 0)
+    return 0;
+  if(write && (v->prot & PROT_WRITE) == 0)
+    return -1;
+  o = v->obj;
+  i = v->pgoff + (va - v->addr) / PGSIZE;
+
+  if((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V)){
+    // a store to a clean page of a writable file mapping.
+    if(!write || (*pte & PTE_W))
+      return -1;
+    __sync_fetch_and_or(&o->dirty[i / 32], 1 << (i % 32));
+    *pte |= PTE_W;
+    return 1;
+  }
+
+  // filling the page may sleep on the file; see uvmprefault().
+  if(holdingany())
+    return -1;
+  // a read() of the file into a page of its own mapping that
+  // uvmprefault() could not load holds the inode lock already.
+  if(o->f && holdingsleep(&o->f->ip->lock))
+    return -1;
+  acquiresleep(&o->lock);
+  if(o->pages[i] == 0){
+    if((mem = kalloc()) == 0){
+      releasesleep(&o->lock);
+      return -1;
+    }
+    memset(mem, 0, PGSIZE);
+    // the part of the page past end of file stays zero.
+    if(o->f){
+      ilock(o->f->ip);
+      readi(o->f->ip, 0, (uint64)mem, o->off + i * PGSIZE, PGSIZE);
+      iunlock(o->f->ip);
+    }
+    o->pages[i] = (uint64)mem;
+  }
+  pa = o->pages[i];
+  releasesleep(&o->lock);
+
+  // file pages start read-only so the first store marks them dirty.
+  perm = PTE_R | PTE_U | PTE_SHARED;
+  if((v->prot & PROT_WRITE) && (o->f == 0 || write)){
+    perm |= PTE_W;
+    if(o->f)
+      __sync_fetch_and_or(&o->dirty[i / 32], 1 << (i % 32));
+  }
+  if(mappages(p->pagetable, va, PGSIZE, pa, perm) != 0)
+    return -1;
+  return 1;
+}
+
+void
+mmapfork(struct proc *p, struct proc *np)
+{
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    np->vma[i] = p->vma[i];
+    if(p->vma[i].addr)
+      objdup(p->vma[i].obj);
+  }
+}
+
+uint64
+mmapbase(struct proc *p)
+{
+  struct vma *v;
+  uint64 base = TRAPFRAME;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->addr && v->addr < base)
+      base = v->addr;
+  return base;
+}
+
+// Remove [addr, addr+len) from the start or the end of v, or
+// all of it. The pages belong to the object, not the process.
+static void
+unmap(struct proc *p, struct vma *v, uint64 addr, uint64 len)
+{
+  int first = v->pgoff + (addr - v->addr) / PGSIZE;
+
+  uvmunmap(p->pagetable, addr, len / PGSIZE, 0);
+  objsync(v->obj, first, len / PGSIZE);
+  if(len == v->len){
+    objput(v->obj);
+    memset(v, 0, sizeof(*v));
+    return;
+  }
+  if(addr == v->addr){
+    v->addr += len;
+    v->pgoff += len / PGSIZE;
+  }
+  v->len -= len;
+}
+
+void
+munmapall(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->addr)
+      unmap(p, v, v->addr, v->len);
+}
+
+uint64
+sys_mmap(void)
+{
+  uint64 addr, len;
+  int prot, flags, fd, off;
+  struct proc *p = myproc();
+  struct file *f = 0;
+  struct vma *v, *free = 0;
+  struct mmapobj *o;
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argint(4, &fd);
+  argint(5, &off);
+
+  len = PGROUNDUP(len);
+  if(len == 0 || len > MMAP_MAXPAGES * PGSIZE)
+    return -1;
+  if((prot & PROT_READ) == 0 || off < 0 || off % PGSIZE != 0)
+    return -1;
+  if((flags & (MAP_SHARED|MAP_PRIVATE)) == 0 ||
+     (flags & (MAP_SHARED|MAP_PRIVATE)) == (MAP_SHARED|MAP_PRIVATE))
+    return -1;
+  if(flags & MAP_ANON){
+    // private anonymous memory is what sbrk() is for.
+    if((flags & MAP_SHARED) == 0)
+      return -1;
+  } else {
+    if(fd < 0 || fd >= NOFILE || (f = p->ofile[fd]) == 0)
+      return -1;
+    if(f->type != FD_INODE || !f->readable)
+      return -1;
+    if(prot & PROT_WRITE){
+      if(flags & MAP_PRIVATE)
+        return -1;
+      if(!f->writable)
+        return -1;
+    }
+  }
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->addr == 0){
+      free = v;
+      break;
+    }
+  addr = mmapbase(p) - len;
+  if(free == 0 || addr < PGROUNDUP(p->sz) || addr > mmapbase(p))
+    return -1;
+  if((o = objalloc(f, off, len / PGSIZE, (flags & MAP_SHARED) != 0)) == 0)
+    return -1;
+  free->addr = addr;
+  free->len = len;
+  free->prot = prot;
+  free->flags = flags;
+  free->pgoff = 0;
+  free->obj = o;
+  return addr;
+}
+
+uint64
+sys_munmap(void)
+{
+  uint64 addr, len;
+  struct vma *v;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  len = PGROUNDUP(len);
+  if(addr % PGSIZE != 0 || len == 0)
+    return -1;
+  if((v = findvma(p, addr)) == 0)
+    return -1;
+  if(addr + len < addr || addr + len > v->addr + v->len)
+    return -1;
+  if(addr != v->addr && addr + len != v->addr + v->len)
+    return -1;
+  unmap(p, v, addr, len);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Memory-mapped files and shared memory.
+ *
+ * Each mmap() call creates a struct mmapobj holding the physical
+ * pages of the mapping, filled in on first touch: zeroed for
+ * MAP_ANON, read through the buffer cache for files. fork() shares
+ * the object, so parent and child see the same pages. Dirty pages
+ * of a MAP_SHARED file mapping are written back through the log
+ * on munmap() and when the last mapping goes away.
+ */
+
+#define NMMAPOBJ       64  // mmap() objects in the system
+#define MMAP_MAXPAGES  512 // pages per mapping (one page of pointers)
+
+struct proc;
+
+/**
+ * mmapinit - Set up the lock of the mmap() object table
+ */
+void mmapinit(void);
+
+/**
+ * mmapfault - Make a page of an mmap() region resident
+ * @p: Current process
+ * @va: Faulting user address
+ * @write: Non-zero for a store
+ *
+ * Maps the object's page, loading it first if needed, or makes a
+ * clean page of a writable file mapping writable and dirty.
+ *
+ * Return: 1 if the page is now accessible, 0 if @va is not in a
+ *         mapping, -1 if the access is not allowed or failed
+ */
+int mmapfault(struct proc *p, uint64 va, int write);
+
+/**
+ * mmapfork - Share the parent's mappings with a child
+ * @p: Parent
+ * @np: Child, whose pages are faulted in on demand
+ */
+void mmapfork(struct proc *p, struct proc *np);
+
+/**
+ * munmapall - Remove every mapping of a process
+ * @p: Current process
+ *
+ * Called by exit() and exec(); may write back dirty file pages.
+ */
+void munmapall(struct proc *p);
+
+/**
+ * mmapbase - Lowest address used by mappings
+ * @p: Process
+ *
+ * Mappings are placed top down from TRAPFRAME and the heap may
+ * not grow past them.
+ *
+ * Return: Start of the lowest mapping, or TRAPFRAME if none
+ */
+uint64 mmapbase(struct proc *p);
+
+/**
+ * sys_mmap - System call to map a file or shared memory
+ *
+ * Takes addr (ignored), length, prot, flags, fd and a page-aligned
+ * file offset. Anonymous memory must be MAP_SHARED; MAP_PRIVATE
+ * file mappings must be read-only.
+ *
+ * Return: The start of the mapping, or -1 on error
+ */
+uint64 sys_mmap(void);
+
+/**
+ * sys_munmap - System call to remove part of a mapping
+ *
+ * Takes a page-aligned address and a length. The range must be a
+ * whole mapping or cut one at its start or its end.
+ *
+ * Return: 0 on success, or -1 on error
+ */
+uint64 sys_munmap(void);
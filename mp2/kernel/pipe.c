@@ -7,29 +7,60 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "fcntl.h"
 
-#define PIPESIZE 512
+// The pipe buffer is a ring of whole pages. Its size is a
+// power-of-two number of pages so that the free-running
+// nread/nwrite counters stay consistent when they wrap.
+#define PIPE_DEFPAGES 4   // pages in a pipe made by pipe()
+#define PIPE_MAXPAGES 16  // most pages pipe2() will give a pipe
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *pages[PIPE_MAXPAGES];
+  uint size;      // bytes in the ring, npages * PGSIZE
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int flags;      // PIPE_ZEROCOPY
 };
 
+static void
+pipefree(struct pipe *pi)
+{
+  for(int i = 0; i < PIPE_MAXPAGES; i++)
+    if(pi->pages[i])
+      kfree(pi->pages[i]);
+  kfree((char*)pi);
+}
+
+// Allocate a pipe whose ring holds npages pages (rounded down
+// to a power of two, 0 for the default).
 int
-pipealloc(struct file **f0, struct file **f1)
+pipealloc(struct file **f0, struct file **f1, int npages, int flags)
 {
   struct pipe *pi;
 
+  if(npages <= 0)
+    npages = PIPE_DEFPAGES;
+  if(npages > PIPE_MAXPAGES)
+    npages = PIPE_MAXPAGES;
+  while(npages & (npages - 1))
+    npages &= npages - 1;
+
   pi = 0;
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
   if((pi = (struct pipe*)kalloc()) == 0)
     goto bad;
+  memset(pi, 0, sizeof(*pi));
+  for(int i = 0; i < npages; i++)
+    if((pi->pages[i] = kalloc()) == 0)
+      goto bad;
+  pi->size = npages * PGSIZE;
+  pi->flags = flags;
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
@@ -47,7 +78,7 @@ pipealloc(struct file **f0, struct file **f1)
 
  bad:
   if(pi)
-    kfree((char*)pi);
+    pipefree(pi);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -68,15 +99,89 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
-    kfree((char*)pi);
+    pipefree(pi);
   } else
     release(&pi->lock);
 }
 
+// Return the PTE of the user page at va if its physical page
+// can be exchanged with a pipe page: va is page-aligned and
+// mapped as ordinary writable user memory.
+static pte_t*
+flippable(struct proc *pr, uint64 va)
+{
+  pte_t *pte;
+
+  if(va % PGSIZE != 0 || va >= MAXVA)
+    return 0;
+  if((pte = walk(pr->pagetable, va, 0)) == 0)
+    return 0;
+  if((*pte & (PTE_V|PTE_U|PTE_W)) != (PTE_V|PTE_U|PTE_W))
+    return 0;
+  // mmap() pages belong to their object, not to this process,
+  // and a megapage cannot give up one of its pages.
+  if(*pte & (PTE_SHARED|PTE_MEGA))
+    return 0;
+  return pte;
+}
+
+// Zero-copy write of the page at user va: the writer's
+// physical page becomes the next ring page, and the writer
+// gets the old ring page, zeroed, in its place.
+// No TLB flush is needed since userret flushes on the way
+// back to user space.
+// Returns 1 if the page was handed over, 0 to fall back to copying.
+static int
+flipin(struct pipe *pi, struct proc *pr, uint64 va, int n)
+{
+  pte_t *pte;
+  char *old;
+  int slot;
+
+  if(n < PGSIZE || pi->nwrite % PGSIZE != 0 ||
+     pi->nwrite - pi->nread > pi->size - PGSIZE)
+    return 0;
+  if((pte = flippable(pr, va)) == 0)
+    return 0;
+  slot = (pi->nwrite % pi->size) / PGSIZE;
+  old = pi->pages[slot];
+  // the old page may hold another process's data.
+  memset(old, 0, PGSIZE);
+  pi->pages[slot] = (char*)PTE2PA(*pte);
+  *pte = PA2PTE(old) | PTE_FLAGS(*pte);
+  pi->nwrite += PGSIZE;
+  return 1;
+}
+
+// Zero-copy read into the page at user va: the reader's
+// physical page is exchanged for the ring page holding the
+// next PGSIZE bytes.
+// Returns 1 if the page was handed over, 0 to fall back to copying.
+static int
+flipout(struct pipe *pi, struct proc *pr, uint64 va, int n)
+{
+  pte_t *pte;
+  char *data;
+  int slot;
+
+  if(n < PGSIZE || pi->nread % PGSIZE != 0 ||
+     pi->nwrite - pi->nread < PGSIZE)
+    return 0;
+  if((pte = flippable(pr, va)) == 0)
+    return 0;
+  slot = (pi->nread % pi->size) / PGSIZE;
+  data = pi->pages[slot];
+  pi->pages[slot] = (char*)PTE2PA(*pte);
+  *pte = PA2PTE(data) | PTE_FLAGS(*pte);
+  pi->nread += PGSIZE;
+  return 1;
+}
+
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
   int i = 0;
+  uint off, m;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
@@ -85,16 +190,26 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       release(&pi->lock);
       return -1;
     }
-    if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
+    if(pi->nwrite == pi->nread + pi->size){ //DOC: pipewrite-full
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
-    } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
-        break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      continue;
+    }
+    if((pi->flags & PIPE_ZEROCOPY) && flipin(pi, pr, addr + i, n - i)){
+      i += PGSIZE;
+      continue;
     }
+    // copy as much as fits, up to the end of the current ring page.
+    off = pi->nwrite % pi->size;
+    m = n - i;
+    if(m > pi->size - (pi->nwrite - pi->nread))
+      m = pi->size - (pi->nwrite - pi->nread);
+    if(m > PGSIZE - off % PGSIZE)
+      m = PGSIZE - off % PGSIZE;
+    if(copyin(pr->pagetable, pi->pages[off / PGSIZE] + off % PGSIZE, addr + i, m) == -1)
+      break;
+    pi->nwrite += m;
+    i += m;
   }
   wakeup(&pi->nread);
   release(&pi->lock);
@@ -106,8 +221,8 @@ int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
   int i;
+  uint off, m;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
@@ -117,12 +232,22 @@ piperead(struct pipe *pi, uint64 addr, int n)
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  i = 0;
+  while(i < n && pi->nread != pi->nwrite){  //DOC: piperead-copy
+    if((pi->flags & PIPE_ZEROCOPY) && flipout(pi, pr, addr + i, n - i)){
+      i += PGSIZE;
+      continue;
+    }
+    off = pi->nread % pi->size;
+    m = n - i;
+    if(m > pi->nwrite - pi->nread)
+      m = pi->nwrite - pi->nread;
+    if(m > PGSIZE - off % PGSIZE)
+      m = PGSIZE - off % PGSIZE;
+    if(copyout(pr->pagetable, addr + i, pi->pages[off / PGSIZE] + off % PGSIZE, m) == -1)
       break;
+    pi->nread += m;
+    i += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
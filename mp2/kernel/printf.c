@@ -17,10 +17,24 @@
 
 volatile int panicked = 0;
 
-// lock to avoid interleaving concurrent printf's.
+// Kernel output goes into a per-CPU log that the UART driver
+// drains, so printf() neither waits for the UART nor takes a
+// lock. Each CPU is the only writer of its log, with interrupts
+// off; uartstart() under uart_tx_lock is the only reader.
+// A printf() is published all at once when it returns, so
+// output from different CPUs interleaves only between calls.
+#define PRLOG_SIZE 16384
+
+struct prlog {
+  uint64 w;     // published up to buf[w % PRLOG_SIZE]
+  uint64 tail;  // written up to, by the printf() in progress
+  char buf[PRLOG_SIZE];
+  uint64 r;     // read next from buf[r % PRLOG_SIZE]
+};
+
 static struct {
-  struct spinlock lock;
-  int locking;
+  int buffered;  // 0 before printfinit() and after panic()
+  struct prlog log[NCPU];
 } pr;
 
 static char digits[] = "0123456789abcdef";
@@ -46,17 +60,80 @@ printint(long long xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    prputc(buf[i]);
 }
 
 static void
 printptr(uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  prputc('0');
+  prputc('x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    prputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+}
+
+// Append c to this CPU's log, to be sent by prflush().
+// Caller must have interrupts off. Before printfinit() and
+// after a panic, c goes straight to the UART instead.
+void
+prputc(int c)
+{
+  struct prlog *l = &pr.log[cpuid()];
+
+  if(!pr.buffered){
+    uartputc_sync(c);
+    return;
+  }
+  while(l->tail == *(volatile uint64 *)&l->r + PRLOG_SIZE){
+    // the log is full: publish what this printf() has
+    // written so far and wait for the UART to take it.
+    prflush();
+  }
+  l->buf[l->tail % PRLOG_SIZE] = c;
+  l->tail++;
+}
+
+// Publish what this CPU has put in its log, and send it
+// unless another CPU is already sending.
+// Caller must have interrupts off.
+void
+prflush(void)
+{
+  struct prlog *l = &pr.log[cpuid()];
+
+  if(!pr.buffered)
+    return;
+  // the bytes must be visible before w says they are there.
+  __sync_synchronize();
+  l->w = l->tail;
+  uartkick();
+}
+
+// Return the next published byte of kernel output, or -1 if
+// every log is empty. Stays with one CPU's log until that is
+// drained, so lines from different CPUs don't get mixed.
+// Caller must hold uart_tx_lock.
+int
+prgetc(void)
+{
+  static int cur;
+  struct prlog *l;
+  int i, c;
+
+  for(i = 0; i < NCPU; i++, cur = (cur + 1) % NCPU){
+    l = &pr.log[cur];
+    if(l->r != *(volatile uint64 *)&l->w){
+      // read the byte only after seeing it published,
+      __sync_synchronize();
+      c = l->buf[l->r % PRLOG_SIZE] & 0xff;
+      // and free its slot only after reading it.
+      __sync_synchronize();
+      l->r++;
+      return c;
+    }
+  }
+  return -1;
 }
 
 // Print to the console.
@@ -64,17 +141,16 @@ int
 printf(char *fmt, ...)
 {
   va_list ap;
-  int i, cx, c0, c1, c2, locking;
+  int i, cx, c0, c1, c2;
   char *s;
 
-  locking = pr.locking;
-  if(locking)
-    acquire(&pr.lock);
+  // stay on this CPU, the only writer of its log.
+  push_off();
 
   va_start(ap, fmt);
   for(i = 0; (cx = fmt[i] & 0xff) != 0; i++){
     if(cx != '%'){
-      consputc(cx);
+      prputc(cx);
       continue;
     }
     i++;
@@ -112,15 +188,15 @@ printf(char *fmt, ...)
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        prputc(*s);
     } else if(c0 == '%'){
-      consputc('%');
+      prputc('%');
     } else if(c0 == 0){
       break;
     } else {
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c0);
+      prputc('%');
+      prputc(c0);
     }
 
 #if 0
@@ -138,23 +214,23 @@ printf(char *fmt, ...)
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        prputc(*s);
       break;
     case '%':
-      consputc('%');
+      prputc('%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      prputc('%');
+      prputc(c);
       break;
     }
 #endif
   }
   va_end(ap);
 
-  if(locking)
-    release(&pr.lock);
+  prflush();
+  pop_off();
 
   return 0;
 }
@@ -162,7 +238,18 @@ printf(char *fmt, ...)
 void
 panic(char *s)
 {
-  pr.locking = 0;
+  int c;
+
+  // print synchronously from here on, after what the logs
+  // still hold. other CPUs may be draining them too, so this
+  // is best effort.
+  push_off();
+  pr.log[cpuid()].w = pr.log[cpuid()].tail;
+  pr.buffered = 0;
+  while((c = prgetc()) >= 0)
+    uartputc_sync(c);
+  pop_off();
+
   printf("panic: ");
   printf("%s\n", s);
   panicked = 1; // freeze uart output from other CPUs
@@ -173,6 +260,5 @@ panic(char *s)
 void
 printfinit(void)
 {
-  initlock(&pr.lock, "pr");
-  pr.locking = 1;
+  pr.buffered = 1;
 }
@@ -5,6 +5,10 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "trace.h"
+#include "memstat.h"
+#include "mmap.h"
+#include "timer.h"
 
 struct cpu cpus[NCPU];
 
@@ -12,6 +16,41 @@ struct proc proc[NPROC];
 
 struct proc *initproc;
 
+// Per-CPU run queues. A process sits on exactly one queue
+// from the moment it becomes RUNNABLE until a scheduler
+// takes it off to run it, so picking the next process is
+// a list pop rather than a scan of proc[].
+// Lock order: p->lock, then runq.lock.
+struct runq {
+  struct spinlock lock;
+  struct list_head procs;     // RUNNABLE processes, oldest first.
+} __attribute__((aligned(64)));
+
+struct runq runqs[NCPU];
+
+// Wait channels, hashed. A sleeping process is linked on the
+// queue its chan hashes to, so wakeup() only looks at processes
+// that might be sleeping on that chan instead of all of proc[].
+// Lock order: the sleep()/wakeup() condition lock, then
+// waitq.lock, then p->lock.
+#define WAITQ_SHIFT 6
+#define NWAITQ (1 << WAITQ_SHIFT)
+
+struct waitq {
+  struct spinlock lock;
+  struct list_head procs;     // processes sleeping on chans in this bucket.
+} __attribute__((aligned(64)));
+
+struct waitq waitqs[NWAITQ];
+
+static struct waitq*
+waitq_of(void *chan)
+{
+  // Fibonacci hashing; chans are mostly addresses of fields in
+  // structs, so the low bits alone would cluster.
+  return &waitqs[((uint64)chan * 0x9E3779B97F4A7C15UL) >> (64 - WAITQ_SHIFT)];
+}
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
@@ -51,8 +90,17 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  for(int i = 0; i < NCPU; i++){
+    initlock(&runqs[i].lock, "runq");
+    INIT_LIST_HEAD(&runqs[i].procs);
+  }
+  for(int i = 0; i < NWAITQ; i++){
+    initlock(&waitqs[i].lock, "waitq");
+    INIT_LIST_HEAD(&waitqs[i].procs);
+  }
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
+      INIT_LIST_HEAD(&p->wq);
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
   }
@@ -102,6 +150,76 @@ allocpid()
   return pid;
 }
 
+// Put p, which the caller just made RUNNABLE, on the run
+// queue of the cpu it last ran on.
+// Idle cpus take no timer ticks, so nobody would notice p
+// there: interrupt that cpu if it is idle, or, if p has to
+// wait behind other queued processes, some idle cpu that can
+// steal it.
+// Caller must hold p->lock.
+static void
+runq_add(struct proc *p)
+{
+  struct runq *rq = &runqs[p->rqcpu];
+  int waiting, i;
+
+  p->readytime = r_time();
+  acquire(&rq->lock);
+  waiting = !list_empty(&rq->procs);
+  list_add_tail(&p->rq, &rq->procs);
+  release(&rq->lock);
+
+  // pairs with the fence in scheduler() between setting
+  // c->idle and looking at the queues once more.
+  __sync_synchronize();
+  if(cpus[p->rqcpu].idle){
+    sendipi(p->rqcpu);
+  } else if(waiting){
+    for(i = 0; i < NCPU; i++){
+      if(cpus[i].idle){
+        sendipi(i);
+        break;
+      }
+    }
+  }
+}
+
+// Is any process waiting on any run queue?
+static int
+runq_any(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    if(!list_empty(&runqs[i].procs))
+      return 1;
+  return 0;
+}
+
+// Take the oldest process off cpu id's queue, or the newest
+// if stealing, since that one is least likely to still be
+// warm in the victim's cache. Returns 0 if the queue is empty.
+static struct proc*
+runq_take(int id, int steal)
+{
+  struct runq *rq = &runqs[id];
+  struct proc *p = 0;
+
+  // peek without the lock so idle cpus don't bounce the
+  // lock of every empty queue.
+  if(list_empty(&rq->procs))
+    return 0;
+
+  acquire(&rq->lock);
+  if(!list_empty(&rq->procs)){
+    if(steal)
+      p = list_last_entry(&rq->procs, struct proc, rq);
+    else
+      p = list_first_entry(&rq->procs, struct proc, rq);
+    list_del_init(&p->rq);
+  }
+  release(&rq->lock);
+  return p;
+}
+
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
@@ -162,6 +280,10 @@ freeproc(struct proc *p)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  p->nseg = 0;
+  p->nfault = 0;
+  p->nload = 0;
+  p->megapages = 0;
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -250,11 +372,14 @@ userinit(void)
   p->cwd = namei("/");
 
   p->state = RUNNABLE;
+  runq_add(p);
 
   release(&p->lock);
 }
 
 // Grow or shrink user memory by n bytes.
+// Growing only moves the break; uvmfault() allocates
+// each page when it is first touched.
 // Return 0 on success, -1 on failure.
 int
 growproc(int n)
@@ -264,9 +389,9 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    if(sz + n > mmapbase(p))
       return -1;
-    }
+    sz += n;
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
@@ -307,6 +432,12 @@ fork(void)
     if(p->ofile[i])
       np->ofile[i] = filedup(p->ofile[i]);
   np->cwd = idup(p->cwd);
+  if(p->execip)
+    np->execip = idup(p->execip);
+  memmove(np->seg, p->seg, sizeof(p->seg));
+  np->nseg = p->nseg;
+  mmapfork(p, np);
+  np->megapages = p->megapages;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
@@ -320,6 +451,10 @@ fork(void)
 
   acquire(&np->lock);
   np->state = RUNNABLE;
+  push_off();
+  np->rqcpu = cpuid();
+  pop_off();
+  runq_add(np);
   release(&np->lock);
 
   return pid;
@@ -351,6 +486,8 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  munmapall(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -362,6 +499,9 @@ exit(int status)
 
   begin_op();
   iput(p->cwd);
+  if(p->execip)
+    iput(p->execip);
+  p->execip = 0;
   end_op();
   p->cwd = 0;
 
@@ -446,37 +586,78 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
+  int steal;
+  uint64 t0;
 
   c->proc = 0;
+  c->started = 1;
   for(;;){
     // The most recent process to run may have had interrupts
     // turned off; enable them to avoid a deadlock if all
     // processes are waiting.
     intr_on();
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
-      }
-      release(&p->lock);
+    // Run our own queue first; if it is empty, take work
+    // from the other cpus' queues.
+    steal = 0;
+    p = runq_take(id, 0);
+    for(int i = 1; p == 0 && i < NCPU; i++){
+      p = runq_take((id + i) % NCPU, 1);
+      steal = 1;
     }
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
-      intr_on();
+
+    if(p == 0) {
+      // nothing to run; stop running on this core until an
+      // interrupt. there is no time slice to end, so the timer
+      // is set only for this cpu's next timer, if any; a cpu
+      // queuing work for us sends an ipi (see runq_add()).
+      // wfi returns for a pending interrupt even with
+      // interrupts off, and the loop turns them back on.
+      intr_off();
+      c->idle = 1;
+      __sync_synchronize();
+      if(runq_any()){
+        c->idle = 0;
+        continue;
+      }
+      timer_arm();
+      t0 = r_time();
       asm volatile("wfi");
+      c->idle = 0;
+      c->nidle++;
+      c->idletime += r_time() - t0;
+      continue;
     }
+
+    // Nobody else can take p now that it is off the queues,
+    // but it may still be switching out on the cpu that queued
+    // it; p->lock makes us wait for that.
+    acquire(&p->lock);
+    if(p->state != RUNNABLE)
+      panic("scheduler: queued process not runnable");
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    uint64 wait = r_time() - p->readytime;
+    c->nswitch++;
+    c->nsteal += steal;
+    c->latency += wait;
+    if(wait > c->maxlatency)
+      c->maxlatency = wait;
+    p->rqcpu = id;
+    p->state = RUNNING;
+    c->proc = p;
+    c->quantum = r_time() + TICKCYCLES;
+    timer_arm();
+    trace(TRACE_SCHED_SWITCH, p->pid, 0);
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
@@ -514,6 +695,7 @@ yield(void)
   struct proc *p = myproc();
   acquire(&p->lock);
   p->state = RUNNABLE;
+  runq_add(p);
   sched();
   release(&p->lock);
 }
@@ -548,15 +730,19 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *q = waitq_of(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // Once we are on chan's wait queue and hold p->lock,
+  // we can be guaranteed that we won't miss any wakeup
+  // (wakeup locks the queue and then p->lock),
   // so it's okay to release lk.
 
+  acquire(&q->lock);
   acquire(&p->lock);  //DOC: sleeplock1
+  list_add_tail(&p->wq, &q->procs);
+  release(&q->lock);
   release(lk);
 
   // Go to sleep.
@@ -567,9 +753,16 @@ sleep(void *chan, struct spinlock *lk)
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // wakeup() unlinks the processes it wakes, but kill() does
+  // not, since it can't take the queue lock under p->lock.
+  acquire(&q->lock);
+  if(!list_empty(&p->wq))
+    list_del_init(&p->wq);
+  release(&q->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
@@ -578,17 +771,27 @@ sleep(void *chan, struct spinlock *lk)
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  struct proc *p, *tmp;
+  struct waitq *q = waitq_of(chan);
+  uint64 t0 = r_time();
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  acquire(&q->lock);
+  list_for_each_entry_safe(p, tmp, &q->procs, wq) {
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         p->state = RUNNABLE;
+        list_del_init(&p->wq);
+        runq_add(p);
       }
       release(&p->lock);
     }
   }
+  // still holding q->lock, so interrupts are off and this
+  // is our cpu.
+  mycpu()->nwakeup++;
+  mycpu()->wakeuptime += r_time() - t0;
+  release(&q->lock);
 }
 
 // Kill the process with the given pid.
@@ -606,6 +809,7 @@ kill(int pid)
       if(p->state == SLEEPING){
         // Wake process from sleep().
         p->state = RUNNABLE;
+        runq_add(p);
       }
       release(&p->lock);
       return 0;
@@ -693,3 +897,54 @@ procdump(void)
     printf("\n");
   }
 }
+
+static void
+fillmemstat(struct proc *pp, struct memstat *st)
+{
+  uint64 va;
+  pte_t *pte;
+
+  st->exited = pp->state == ZOMBIE;
+  st->sz = pp->sz;
+  st->resident = 0;
+  for(va = 0; va < pp->sz; va += PGSIZE){
+    if((pte = walk(pp->pagetable, va, 0)) == 0)
+      va |= MEGAPGSIZE - PGSIZE;
+    else if(*pte & PTE_V)
+      st->resident++;
+  }
+  st->nfault = pp->nfault;
+  st->nload = pp->nload;
+  st->ptpages = ptpages(pp->pagetable);
+  st->kptpages = kvmptpages();
+}
+
+int
+procmemstat(int pid, struct memstat *st)
+{
+  struct proc *p = myproc();
+  struct proc *pp;
+
+  if(pid == 0 || pid == p->pid){
+    fillmemstat(p, st);
+    return 0;
+  }
+
+  // a zombie keeps its page table until wait() frees it, which
+  // holding pp->lock prevents.
+  acquire(&wait_lock);
+  for(pp = proc; pp < &proc[NPROC]; pp++){
+    if(pp->parent != p)
+      continue;
+    acquire(&pp->lock);
+    if(pp->pid == pid && pp->state == ZOMBIE){
+      fillmemstat(pp, st);
+      release(&pp->lock);
+      release(&wait_lock);
+      return 0;
+    }
+    release(&pp->lock);
+  }
+  release(&wait_lock);
+  return -1;
+}
@@ -1,3 +1,5 @@
+#include "list.h"
+
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -24,6 +26,24 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+
+  // scheduler statistics, written only by this cpu (see schedstat.h).
+  int started;                // Has this cpu entered scheduler()?
+  uint64 nswitch;             // Processes switched to.
+  uint64 nsteal;              // Processes taken from another cpu's queue.
+  uint64 latency;             // Sum of RUNNABLE-to-RUNNING r_time() ticks.
+  uint64 maxlatency;          // Longest RUNNABLE-to-RUNNING wait.
+  uint64 nwakeup;             // wakeup() calls.
+  uint64 wakeuptime;          // r_time() ticks spent in wakeup().
+  uint64 nidle;               // Times woken up while idle.
+  uint64 idletime;            // r_time() ticks spent idle.
+  uint64 nipi;                // Inter-processor interrupts taken.
+  uint64 ntimer;              // Timers fired.
+  uint64 timerlate;           // Sum of r_time() ticks timers fired late.
+  uint64 maxtimerlate;        // Latest a timer fired.
+
+  uint64 quantum;             // r_time() at which c->proc's time slice ends.
+  volatile int idle;          // Waiting for an interrupt with nothing to run?
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +101,31 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+#define NEXECSEG 4  // loadable ELF segments kept for demand paging
+
+// A loadable segment of the executable, paged in on first touch
+// by loadpage() instead of being read in by exec().
+struct execseg {
+  uint64 va;      // page-aligned start address
+  uint64 memsz;   // bytes of memory
+  uint64 filesz;  // bytes from the file; the rest is zero-filled
+  uint off;       // file offset of va
+  int perm;       // PTE_X and PTE_W bits
+};
+
+#define NVMA 8  // mmap() regions per process
+
+// A region of the address space mapped by mmap(), backed by
+// the pages of a shared struct mmapobj (see mmap.c).
+struct vma {
+  uint64 addr;    // page-aligned start, 0 if the slot is free
+  uint64 len;     // bytes, a multiple of PGSIZE
+  int prot;       // PROT_READ, PROT_WRITE
+  int flags;      // MAP_SHARED, MAP_PRIVATE, MAP_ANON
+  int pgoff;      // index in obj of the page at addr
+  struct mmapobj *obj;
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -91,6 +136,10 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  struct list_head rq;         // Run queue link, while RUNNABLE
+  struct list_head wq;         // Wait queue link, while SLEEPING
+  int rqcpu;                   // Run queue the process was last put on
+  uint64 readytime;            // r_time() when it became RUNNABLE
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -103,5 +152,12 @@ struct proc {
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct inode *execip;        // Executable, for demand paging
+  struct execseg seg[NEXECSEG]; // Its loadable segments
+  int nseg;
+  uint64 nfault;               // Pages made resident on demand
+  uint64 nload;                // ... of which read from execip
+  struct vma vma[NVMA];        // mmap() regions
+  int megapages;               // Back the heap with megapages
   char name[16];               // Process name (debugging)
 };
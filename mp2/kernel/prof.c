@@ -0,0 +1,152 @@
+//
+// Timer-driven sampling profiler.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "timer.h"
+#include "prof.h"
+
+// One ring and sampling timer per CPU. head is only written by
+// the owning CPU, tail only by profread(), as in trace.c.
+struct prof_ring {
+  struct prof_sample s[PROF_RING_SIZE];
+  uint64 head;     // next slot the owning CPU fills
+  uint64 tail;     // next slot profread() consumes
+  uint64 dropped;  // samples lost because the ring was full
+  struct timer t;  // fires PROF_HZ times a second
+  int armed;       // is t pending or firing?
+} __attribute__((aligned(64)));
+
+static struct prof_ring rings[NCPU];
+
+volatile int prof_enabled = 0;
+
+// serializes readers; producers never take it.
+static struct spinlock prof_lock;
+
+void
+profinit(void)
+{
+  initlock(&prof_lock, "prof");
+}
+
+// Record the pc this CPU's timer interrupt interrupted. Runs
+// from timer_run() inside clockintr(), so sepc and sstatus
+// still describe the interrupted code.
+static void
+sample(void *arg)
+{
+  struct prof_ring *r = arg;
+  struct prof_sample *s;
+  struct proc *p = myproc();
+
+  if(!prof_enabled){
+    r->armed = 0;
+    return;
+  }
+
+  if(r->head - r->tail >= PROF_RING_SIZE){
+    __sync_fetch_and_add(&r->dropped, 1);
+  } else {
+    s = &r->s[r->head & (PROF_RING_SIZE - 1)];
+    s->pc = r_sepc();
+    s->pid = p ? p->pid : 0;
+    s->cpu = cpuid();
+    s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+    if(p)
+      safestrcpy(s->name, p->name, sizeof(s->name));
+    else
+      safestrcpy(s->name, "-", sizeof(s->name));
+    // publish the sample before the new head.
+    __sync_synchronize();
+    r->head++;
+  }
+
+  timer_add(&r->t, r_time() + TIMEHZ / PROF_HZ);
+}
+
+void
+prof_sync(void)
+{
+  struct prof_ring *r = &rings[cpuid()];
+
+  if(!prof_enabled || r->armed)
+    return;
+  r->armed = 1;
+  r->t.fn = sample;
+  r->t.arg = r;
+  timer_add(&r->t, r_time() + TIMEHZ / PROF_HZ);
+}
+
+uint64
+sys_profctl(void)
+{
+  int on, old, i;
+
+  argint(0, &on);
+  old = prof_enabled;
+  if(on < 0)
+    return old;
+  prof_enabled = (on != 0);
+  if(prof_enabled && !old){
+    // idle cpus take no timer interrupts; wake them to start.
+    push_off();
+    prof_sync();
+    for(i = 0; i < NCPU; i++)
+      if(i != cpuid() && cpus[i].started)
+        sendipi(i);
+    pop_off();
+  }
+  return old;
+}
+
+uint64
+sys_profread(void)
+{
+  uint64 addr;
+  int max, n, i;
+  struct prof_sample s;
+  struct prof_ring *r;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argint(1, &max);
+  if(max > 0)
+    uvmprefault(addr, (uint64)max * sizeof(s), 1);
+
+  acquire(&prof_lock);
+  n = 0;
+  for(i = 0; i < NCPU && n < max; i++){
+    r = &rings[i];
+    while(n < max){
+      if(r->dropped){
+        memset(&s, 0, sizeof(s));
+        s.pc = __sync_lock_test_and_set(&r->dropped, 0);
+        s.cpu = i;
+        s.user = PROF_LOST;
+      } else if(r->tail != *(volatile uint64 *)&r->head){
+        // see the sample the head says is there.
+        __sync_synchronize();
+        s = r->s[r->tail & (PROF_RING_SIZE - 1)];
+        // finish reading the slot before handing it back.
+        __sync_synchronize();
+        r->tail++;
+      } else {
+        break;
+      }
+      if(copyout(p->pagetable, addr + n * sizeof(s), (char *)&s, sizeof(s)) < 0){
+        release(&prof_lock);
+        return -1;
+      }
+      n++;
+    }
+  }
+  release(&prof_lock);
+  return n;
+}
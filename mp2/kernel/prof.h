@@ -0,0 +1,76 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Sampling profiler.
+ *
+ * While profiling is on, every CPU takes a timer interrupt
+ * PROF_HZ times a second and records the pc it interrupted in a
+ * ring of its own, the same way trace.h records events. This
+ * header is shared with user space so that tools can decode the
+ * samples returned by profread().
+ */
+
+#define PROF_RING_SIZE 1024 // samples per CPU ring, must be a power of 2
+#define PROF_HZ        1000 // samples per second on each CPU
+
+#define PROF_LOST 2 // @user value of a sample that counts dropped samples
+
+/**
+ * struct prof_sample - One profiler sample (40 bytes)
+ * @pc: Interrupted sepc
+ * @pid: Process running on the CPU, or 0 in the scheduler or idle
+ * @cpu: Sampled hart
+ * @user: 1 if @pc is a user address of @pid, 0 if a kernel address;
+ *        %PROF_LOST if @pc is instead the number of samples a full
+ *        ring dropped
+ * @name: Name of process @pid
+ */
+struct prof_sample
+{
+  uint64 pc;
+  uint32 pid;
+  uint16 cpu;
+  uint16 user;
+  char name[16];
+};
+
+/**
+ * prof_enabled - Non-zero while the profiler is sampling
+ */
+extern volatile int prof_enabled;
+
+/**
+ * profinit - Set up the lock that serializes sample readers
+ */
+void profinit(void);
+
+/**
+ * prof_sync - Start this CPU's sampling timer if profiling is on
+ *
+ * Called with interrupts off from clockintr() and when an ipi
+ * arrives, which is how sys_profctl() reaches idle CPUs. The timer
+ * stops itself once profiling is turned off.
+ */
+void prof_sync(void);
+
+/**
+ * sys_profctl - System call to start or stop profiling
+ *
+ * Takes one int argument: 1 to start, 0 to stop, negative to only
+ * query.
+ *
+ * Return: The previous state (0 or 1)
+ */
+uint64 sys_profctl(void);
+
+/**
+ * sys_profread - System call to drain the sample rings
+ *
+ * Takes a user buffer of &struct prof_sample and its capacity in
+ * samples.
+ *
+ * Return: Number of samples copied, or -1 on a bad buffer
+ */
+uint64 sys_profread(void);
@@ -97,6 +97,7 @@ w_sie(uint64 x)
 
 // Machine-mode Interrupt Enable
 #define MIE_STIE (1L << 5)  // supervisor timer
+#define MIE_MSIE (1L << 3)  // machine software
 static inline uint64
 r_mie()
 {
@@ -174,6 +175,19 @@ r_stvec()
   return x;
 }
 
+// Machine-mode interrupt vector
+static inline void 
+w_mtvec(uint64 x)
+{
+  asm volatile("csrw mtvec, %0" : : "r" (x));
+}
+
+static inline void 
+w_mscratch(uint64 x)
+{
+  asm volatile("csrw mscratch, %0" : : "r" (x));
+}
+
 // Supervisor Timer Comparison Register
 static inline uint64
 r_stimecmp()
@@ -357,11 +371,19 @@ typedef uint64 *pagetable_t; // 512 PTEs
 #define PGROUNDUP(sz)  (((sz)+PGSIZE-1) & ~(PGSIZE-1))
 #define PGROUNDDOWN(a) (((a)) & ~(PGSIZE-1))
 
+#define MEGAPGSIZE (PGSIZE << 9) // 2 MiB, mapped by one level-1 PTE
+#define MEGAPGROUNDDOWN(a) (((a)) & ~(MEGAPGSIZE-1))
+
 #define PTE_V (1L << 0) // valid
 #define PTE_R (1L << 1)
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // user can access
+#define PTE_SHARED (1L << 8) // RSW: page belongs to an mmap() object
+#define PTE_MEGA (1L << 9)   // RSW: leaf is a level-1 megapage
+
+// a valid PTE is a leaf if it grants any access.
+#define PTE_LEAF(pte) ((pte) & (PTE_R|PTE_W|PTE_X))
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
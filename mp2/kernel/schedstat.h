@@ -0,0 +1,51 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Scheduler statistics, one record per CPU, shared with user
+ * space for the schedstat() system call. Times are in r_time()
+ * ticks (10 MHz on qemu virt).
+ */
+
+/**
+ * struct schedstat - Scheduler counters of one CPU
+ * @started: Non-zero once the CPU has entered scheduler()
+ * @nswitch: Number of processes switched to
+ * @nsteal: How many of those were taken from another CPU's run queue
+ * @latency: Sum of RUNNABLE-to-RUNNING waits
+ * @maxlatency: Longest RUNNABLE-to-RUNNING wait
+ * @nwakeup: Number of wakeup() calls
+ * @wakeuptime: Total time spent in wakeup()
+ * @nidle: Number of times the idle CPU was woken by an interrupt
+ * @idletime: Total time spent idle
+ * @nipi: Number of inter-processor interrupts taken
+ * @ntimer: Number of timers fired (see timer.h)
+ * @timerlate: Sum of how late timers fired after their deadlines
+ * @maxtimerlate: Latest a timer fired after its deadline
+ */
+struct schedstat
+{
+  int started;
+  uint64 nswitch;
+  uint64 nsteal;
+  uint64 latency;
+  uint64 maxlatency;
+  uint64 nwakeup;
+  uint64 wakeuptime;
+  uint64 nidle;
+  uint64 idletime;
+  uint64 nipi;
+  uint64 ntimer;
+  uint64 timerlate;
+  uint64 maxtimerlate;
+};
+
+/**
+ * sys_schedstat - System call to read per-CPU scheduler counters
+ *
+ * Takes a user buffer of &struct schedstat and its capacity.
+ *
+ * Return: Number of CPUs copied (at most NCPU), or -1 on error
+ */
+uint64 sys_schedstat(void);
@@ -10,6 +10,7 @@
 #include "defs.h"
 #include "slab.h"
 #include "debug.h"
+#include "trace.h"
 
 void print_kmem_cache(struct kmem_cache *cache, void (*slab_obj_printer)(void *))
 {
@@ -125,6 +126,7 @@ struct kmem_cache *kmem_cache_create(char *name, uint object_size)
 
   debug("[SLAB] New kmem_cache (name: %s, object size: %d bytes, at: %p, max objects per slab: %d, support in cache obj: %d) is created\n", 
          cache->name, cache->object_size, cache, max_objs, max_cache_objs);
+  trace(TRACE_SLAB_CREATE, cache, cache->object_size);
   release(&cache->lock);
   return cache;
 }
@@ -156,6 +158,7 @@ void *kmem_cache_alloc(struct kmem_cache *cache)
         void *obj = cache->freelist;
         cache->freelist = cache->freelist->next;
         debug("[SLAB] Object %p in slab %p (%s) is allocated and initialized\n", obj, cache, cache->name);
+        trace(TRACE_SLAB_ALLOC, cache, obj);
         release(&cache->lock);
         return obj;
     }
@@ -194,6 +197,7 @@ void *kmem_cache_alloc(struct kmem_cache *cache)
         list_add_tail(&s->list, &cache->partial);
 
         debug("[SLAB] A new slab %p (%s) is allocated\n", s, cache->name);
+        trace(TRACE_SLAB_GROW, cache, s);
     }
 
     // Allocate object
@@ -202,6 +206,7 @@ void *kmem_cache_alloc(struct kmem_cache *cache)
     s->in_use++;
 
     debug("[SLAB] Object %p in slab %p (%s) is allocated and initialized\n", obj, s, cache->name);
+    trace(TRACE_SLAB_ALLOC, cache, obj);
 
     // Move to full if needed
     if (s->in_use == (PGSIZE - sizeof(struct slab)) / cache->object_size) {
@@ -234,6 +239,7 @@ void kmem_cache_free(struct kmem_cache *cache, void *obj)
         ((struct run *)obj)->next = cache->freelist;
         cache->freelist = (struct run *)obj;
         debug("[SLAB] Free %p in slab %p (%s)\n", obj, cache, cache->name);
+        trace(TRACE_SLAB_FREE, cache, obj);
         debug("[SLAB] End of free\n");
         release(&cache->lock);
         return;
@@ -243,6 +249,7 @@ void kmem_cache_free(struct kmem_cache *cache, void *obj)
   	//struct slab *s = *(struct slab **)((char *)obj - sizeof(struct slab *));
   	struct slab *s = (struct slab *)((uint64)obj & ~(PGSIZE-1));
   	debug("[SLAB] Free %p in slab %p (%s)\n", obj, s, cache->name);
+  	trace(TRACE_SLAB_FREE, cache, obj);
 
     // Add object back to freelist
     ((struct run *)obj)->next = s->freelist;  // Link freed object to current freelist head
@@ -266,6 +273,7 @@ void kmem_cache_free(struct kmem_cache *cache, void *obj)
 
         if (total_slabs >= MP2_MIN_AVAIL_SLAB) {
             debug("[SLAB] slab %p (%s) is freed due to save memory\n", s, cache->name);
+            trace(TRACE_SLAB_SHRINK, cache, s);
             kfree((void *)s);
         } else {
             list_add_tail(&s->list, &cache->free);
@@ -7,13 +7,19 @@
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
+#include "lockstat.h"
 
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
   lk->locked = 0;
+#ifdef LOCK_TICKET
+  lk->next = 0;
+  lk->owner = 0;
+#endif
   lk->cpu = 0;
+  lk->stat = lockstat_class(name);
 }
 
 // Acquire the lock.
@@ -21,16 +27,42 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  int contended = 0;
+  uint64 t0 = 0;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
+#ifdef LOCK_TICKET
+  // Take the next ticket and wait until it is served. Tickets
+  // are served in order, so waiters get the lock first-come
+  // first-served, and waiting is a plain load of lk->owner.
+  //   amoadd.w a5, a4, (s1)
+  uint ticket = __sync_fetch_and_add(&lk->next, 1);
+  if(*(volatile uint *)&lk->owner != ticket){
+    contended = 1;
+    t0 = r_time();
+    while(*(volatile uint *)&lk->owner != ticket)
+      ;
+  }
+  lk->locked = 1;
+#else
   // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  if(__sync_lock_test_and_set(&lk->locked, 1) != 0){
+    contended = 1;
+    t0 = r_time();
+    // Wait with plain loads, which keep the cache line shared,
+    // and only retry the swap once the lock looks free.
+    do {
+      while(*(volatile uint *)&lk->locked)
+        ;
+    } while(__sync_lock_test_and_set(&lk->locked, 1) != 0);
+  }
+#endif
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +72,45 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+
+  if(lk->stat)
+    lockstat_record(lk->stat, contended, contended ? r_time() - t0 : 0);
+}
+
+// Acquire the lock only if that needs no waiting.
+// Returns 1 if the lock is now held, 0 if not; also 0
+// if this CPU already holds it.
+int
+tryacquire(struct spinlock *lk)
+{
+  push_off();
+  if(holding(lk)){
+    pop_off();
+    return 0;
+  }
+
+#ifdef LOCK_TICKET
+  // take a ticket only if it would be served right away.
+  uint ticket = *(volatile uint *)&lk->owner;
+  if(*(volatile uint *)&lk->next != ticket ||
+     !__sync_bool_compare_and_swap(&lk->next, ticket, ticket + 1)){
+    pop_off();
+    return 0;
+  }
+  lk->locked = 1;
+#else
+  if(__sync_lock_test_and_set(&lk->locked, 1) != 0){
+    pop_off();
+    return 0;
+  }
+#endif
+
+  __sync_synchronize();
+  lk->cpu = mycpu();
+
+  if(lk->stat)
+    lockstat_record(lk->stat, 0, 0);
+  return 1;
 }
 
 // Release the lock.
@@ -59,6 +130,13 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
+#ifdef LOCK_TICKET
+  // Serve the next ticket. Only the holder writes lk->owner,
+  // but use an atomic add so the store is a single instruction.
+  lk->locked = 0;
+  __sync_synchronize();
+  __sync_fetch_and_add(&lk->owner, 1);
+#else
   // Release the lock, equivalent to lk->locked = 0.
   // This code doesn't use a C assignment, since the C standard
   // implies that an assignment might be implemented with
@@ -67,6 +145,7 @@ release(struct spinlock *lk)
   //   s1 = &lk->locked
   //   amoswap.w zero, zero, (s1)
   __sync_lock_release(&lk->locked);
+#endif
 
   pop_off();
 }
@@ -81,6 +160,19 @@ holding(struct spinlock *lk)
   return r;
 }
 
+// Check whether this cpu holds any spinlock, in which case
+// the caller must not sleep.
+int
+holdingany(void)
+{
+  int r;
+
+  push_off();
+  r = mycpu()->noff > 1;
+  pop_off();
+  return r;
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
@@ -1,10 +1,18 @@
 #pragma once
 
 // Mutual exclusion lock.
+//
+// Built as a test-and-set lock by default, or as a FIFO ticket
+// lock with -D LOCK_TICKET (make LOCKTYPE=LOCK_TICKET).
 struct spinlock {
   uint locked;       // Is the lock held?
+#ifdef LOCK_TICKET
+  uint next;         // Next ticket to hand out.
+  uint owner;        // Ticket allowed to hold the lock.
+#endif
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+  struct lockclass *stat; // Contention counters (see lockstat.h).
 };
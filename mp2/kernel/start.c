@@ -10,6 +10,12 @@ void timerinit();
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
+// a scratch area per CPU for ipivec in kernelvec.S.
+uint64 ipi_scratch[NCPU][3];
+
+// in kernelvec.S, relays inter-processor interrupts.
+extern void ipivec();
+
 // entry.S jumps here in machine mode on stack0.
 void
 start()
@@ -40,6 +46,14 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+  // take inter-processor interrupts in ipivec, which hands
+  // them on to supervisor mode.
+  uint64 *scratch = &ipi_scratch[r_mhartid()][0];
+  scratch[2] = CLINT_MSIP(r_mhartid());
+  w_mscratch((uint64)scratch);
+  w_mtvec((uint64)ipivec);
+  w_mie(r_mie() | MIE_MSIE);
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -61,6 +75,7 @@ timerinit()
   // allow supervisor to use stimecmp and time.
   w_mcounteren(r_mcounteren() | 2);
   
-  // ask for the very first timer interrupt.
+  // ask for the very first timer interrupt; clockintr()
+  // programs the ones after that.
   w_stimecmp(r_time() + 1000000);
 }
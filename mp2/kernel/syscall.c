@@ -8,6 +8,14 @@
 #include "defs.h"
 #include "debug.h"
 #include "printfslab.h"
+#include "trace.h"
+#include "lockstat.h"
+#include "schedstat.h"
+#include "memstat.h"
+#include "mmap.h"
+#include "timer.h"
+#include "prof.h"
+#include "batch.h"
 
 // Fetch the uint64 at addr from the current process.
 int
@@ -103,6 +111,7 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_pipe2(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -130,6 +139,20 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_debugswitch]  sys_debugswitch,
 [SYS_printfslab] sys_printfslab,
+[SYS_tracectl] sys_tracectl,
+[SYS_traceread] sys_traceread,
+[SYS_lockstat] sys_lockstat,
+[SYS_schedstat] sys_schedstat,
+[SYS_pipe2] sys_pipe2,
+[SYS_memstat] sys_memstat,
+[SYS_mmap] sys_mmap,
+[SYS_munmap] sys_munmap,
+[SYS_megapages] sys_megapages,
+[SYS_usleep] sys_usleep,
+[SYS_uptimeus] sys_uptimeus,
+[SYS_profctl] sys_profctl,
+[SYS_profread] sys_profread,
+[SYS_batch]   sys_batch,
 };
 
 void
@@ -149,3 +172,74 @@ syscall(void)
     p->trapframe->a0 = -1;
   }
 }
+
+// user addresses of a ring's fields.
+#define RING_FIELD(ring, f) ((ring) + (uint64)&((struct batch_ring *)0)->f)
+#define RING_SQ(ring, i) RING_FIELD(ring, sq[(i) & (BATCH_ENTRIES - 1)])
+#define RING_CQ(ring, i) RING_FIELD(ring, cq[(i) & (BATCH_ENTRIES - 1)])
+
+// Run the submissions queued in a user batch_ring, each through
+// syscalls[] with its arguments loaded into the trapframe as if it
+// had been an ecall of its own, posting results to the ring's
+// completion queue.
+uint64
+sys_batch(void)
+{
+  uint64 ring, res[BATCH_ENTRIES], saved[6];
+  uint head[4];  // sq_head, sq_tail, cq_head, cq_tail
+  struct batch_sqe sqe;
+  struct batch_cqe cqe;
+  struct proc *p = myproc();
+  uint start, ref;
+  int n, k;
+
+  argaddr(0, &ring);
+  if(copyin(p->pagetable, (char *)head, ring, sizeof(head)) < 0)
+    return -1;
+  if(head[1] - head[0] > BATCH_ENTRIES)
+    return -1;
+
+  memmove(saved, &p->trapframe->a0, sizeof(saved));
+  start = head[0];
+  for(n = 0; head[0] != head[1] && head[3] - head[2] < BATCH_ENTRIES; n++){
+    if(killed(p))
+      break;
+    if(copyin(p->pagetable, (char *)&sqe, RING_SQ(ring, head[0]), sizeof(sqe)) < 0)
+      goto bad;
+
+    cqe.user_data = sqe.user_data;
+    cqe.result = -1;
+    if(sqe.num <= 0 || sqe.num >= NELEM(syscalls) || syscalls[sqe.num] == 0 ||
+       sqe.num == SYS_fork || sqe.num == SYS_exit || sqe.num == SYS_exec ||
+       sqe.num == SYS_batch)
+      goto done;
+    for(k = 0; k < 6; k++){
+      if((sqe.flags & BATCH_ARGREF(k)) == 0)
+        continue;
+      ref = sqe.args[k];
+      if(ref - start >= head[0] - start)
+        goto done;  // not run earlier in this call
+      sqe.args[k] = res[ref - start];
+    }
+    memmove(&p->trapframe->a0, sqe.args, sizeof(sqe.args));
+    cqe.result = syscalls[sqe.num]();
+
+  done:
+    res[head[0] - start] = cqe.result;
+    if(copyout(p->pagetable, RING_CQ(ring, head[3]), (char *)&cqe, sizeof(cqe)) < 0)
+      goto bad;
+    head[0]++;
+    head[3]++;
+  }
+  memmove(&p->trapframe->a0, saved, sizeof(saved));
+
+  // publish the new sq_head and cq_tail.
+  if(copyout(p->pagetable, RING_FIELD(ring, sq_head), (char *)&head[0], sizeof(head[0])) < 0 ||
+     copyout(p->pagetable, RING_FIELD(ring, cq_tail), (char *)&head[3], sizeof(head[3])) < 0)
+    return -1;
+  return n;
+
+bad:
+  memmove(&p->trapframe->a0, saved, sizeof(saved));
+  return -1;
+}
@@ -24,4 +24,17 @@
 /* MP2 */
 #define SYS_debugswitch 22 // switch debug mode
 #define SYS_printfslab 23 // print slab
-
+#define SYS_tracectl 24 // enable/disable binary tracing
+#define SYS_traceread 25 // drain the trace rings
+#define SYS_lockstat 26 // read or reset spinlock statistics
+#define SYS_schedstat 27 // read per-cpu scheduler counters
+#define SYS_pipe2 28 // pipe with a sized buffer and flags
+#define SYS_memstat 29 // read a process's memory statistics
+#define SYS_mmap 30 // map a file or shared memory
+#define SYS_munmap 31 // remove a mapping
+#define SYS_megapages 32 // back the heap with 2 MiB pages
+#define SYS_usleep 33 // sleep for microseconds
+#define SYS_uptimeus 34 // microseconds since boot
+#define SYS_profctl 35 // start/stop the sampling profiler
+#define SYS_profread 36 // drain the profiler's sample rings
+#define SYS_batch 37 // run a ring of queued system calls
@@ -76,6 +76,10 @@ sys_read(void)
   argint(2, &n);
   if(argfd(0, 0, &f) < 0)
     return -1;
+  // pipes and the console copy out with a spinlock held; inodes
+  // hold only a sleep lock, so copyout can fault their pages in.
+  if(n > 0 && (f->type == FD_PIPE || f->type == FD_DEVICE))
+    uvmprefault(p, n, 1);
   return fileread(f, p, n);
 }
 
@@ -90,6 +94,8 @@ sys_write(void)
   argint(2, &n);
   if(argfd(0, 0, &f) < 0)
     return -1;
+  if(n > 0 && (f->type == FD_PIPE || f->type == FD_DEVICE))
+    uvmprefault(p, n, 0);
 
   return filewrite(f, p, n);
 }
@@ -474,16 +480,16 @@ sys_exec(void)
   return -1;
 }
 
-uint64
-sys_pipe(void)
+// Allocate a pipe and store its read and write file
+// descriptors at user address fdarray.
+static int
+makepipe(uint64 fdarray, int npages, int flags)
 {
-  uint64 fdarray; // user pointer to array of two integers
   struct file *rf, *wf;
   int fd0, fd1;
   struct proc *p = myproc();
 
-  argaddr(0, &fdarray);
-  if(pipealloc(&rf, &wf) < 0)
+  if(pipealloc(&rf, &wf, npages, flags) < 0)
     return -1;
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
@@ -503,3 +509,28 @@ sys_pipe(void)
   }
   return 0;
 }
+
+uint64
+sys_pipe(void)
+{
+  uint64 fdarray; // user pointer to array of two integers
+
+  argaddr(0, &fdarray);
+  return makepipe(fdarray, 0, 0);
+}
+
+// pipe2(fds, npages, flags): a pipe with an npages-page
+// buffer; flags may include PIPE_ZEROCOPY.
+uint64
+sys_pipe2(void)
+{
+  uint64 fdarray;
+  int npages, flags;
+
+  argaddr(0, &fdarray);
+  argint(1, &npages);
+  argint(2, &flags);
+  if(flags & ~PIPE_ZEROCOPY)
+    return -1;
+  return makepipe(fdarray, npages, flags);
+}
@@ -5,6 +5,9 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "schedstat.h"
+#include "memstat.h"
+#include "timer.h"
 
 uint64
 sys_exit(void)
@@ -32,6 +35,9 @@ sys_wait(void)
 {
   uint64 p;
   argaddr(0, &p);
+  // wait() copies out the status with wait_lock held.
+  if(p != 0)
+    uvmprefault(p, sizeof(int), 1);
   return wait(p);
 }
 
@@ -52,22 +58,22 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
   if(n < 0)
     n = 0;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return timer_sleep(r_time() + (uint64)n * TICKCYCLES);
+}
+
+uint64
+sys_usleep(void)
+{
+  int n;
+
+  argint(0, &n);
+  if(n < 0)
+    n = 0;
+  return timer_sleep(r_time() + (uint64)n * (TIMEHZ / 1000000));
 }
 
 uint64
@@ -79,15 +85,85 @@ sys_kill(void)
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
-// since start.
+// return how many clock ticks have passed since start.
+// idle cpus don't take tick interrupts, so count them
+// from the time register.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  return r_time() / TICKCYCLES;
+}
+
+uint64
+sys_uptimeus(void)
+{
+  return r_time() / (TIMEHZ / 1000000);
+}
+
+uint64
+sys_schedstat(void)
+{
+  uint64 addr;
+  int max, i;
+  struct schedstat st;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argint(1, &max);
+  if(max > NCPU)
+    max = NCPU;
+  for(i = 0; i < max; i++){
+    struct cpu *c = &cpus[i];
+    st.started = c->started;
+    st.nswitch = c->nswitch;
+    st.nsteal = c->nsteal;
+    st.latency = c->latency;
+    st.maxlatency = c->maxlatency;
+    st.nwakeup = c->nwakeup;
+    st.wakeuptime = c->wakeuptime;
+    st.nidle = c->nidle;
+    st.idletime = c->idletime;
+    st.nipi = c->nipi;
+    st.ntimer = c->ntimer;
+    st.timerlate = c->timerlate;
+    st.maxtimerlate = c->maxtimerlate;
+    if(copyout(p->pagetable, addr + i * sizeof(st), (char *)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return max;
+}
+
+uint64
+sys_memstat(void)
+{
+  int pid;
+  uint64 addr;
+  struct memstat st;
+  struct proc *p = myproc();
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if(procmemstat(pid, &st) < 0)
+    return -1;
+  if(copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+uint64
+sys_megapages(void)
+{
+  int on, old;
+  struct proc *p = myproc();
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  argint(0, &on);
+  old = p->megapages;
+#ifdef NOMEGAPAGE
+  // not available: leave it off and say so.
+  on = -1;
+  old = -1;
+#endif
+  if(on >= 0)
+    p->megapages = on != 0;
+  return old;
 }
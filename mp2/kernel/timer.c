@@ -0,0 +1,214 @@
+//
+// Per-CPU timer queues, kept as min-heaps by deadline.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "timer.h"
+
+// A CPU's pending timers. Timers are added only by their own
+// CPU and fire there, but may be cancelled from anywhere.
+struct timerq {
+  struct spinlock lock;
+  int n;
+  struct timer *heap[NTIMER];  // heap[0] has the earliest deadline
+} __attribute__((aligned(64)));
+
+static struct timerq timerqs[NCPU];
+
+void
+timerq_init(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&timerqs[i].lock, "timerq");
+}
+
+static void
+place(struct timerq *q, struct timer *t, int i)
+{
+  q->heap[i] = t;
+  t->slot = i;
+}
+
+static void
+siftup(struct timerq *q, int i)
+{
+  struct timer *t = q->heap[i];
+
+  while(i > 0 && q->heap[(i - 1) / 2]->when > t->when){
+    place(q, q->heap[(i - 1) / 2], i);
+    i = (i - 1) / 2;
+  }
+  place(q, t, i);
+}
+
+static void
+siftdown(struct timerq *q, int i)
+{
+  struct timer *t = q->heap[i];
+  int c;
+
+  while((c = 2 * i + 1) < q->n){
+    if(c + 1 < q->n && q->heap[c + 1]->when < q->heap[c]->when)
+      c++;
+    if(q->heap[c]->when >= t->when)
+      break;
+    place(q, q->heap[c], i);
+    i = c;
+  }
+  place(q, t, i);
+}
+
+// Take heap[i] off q. Caller holds q->lock.
+static void
+removeat(struct timerq *q, int i)
+{
+  struct timer *t = q->heap[i];
+
+  q->n--;
+  if(i < q->n){
+    place(q, q->heap[q->n], i);
+    if(i > 0 && q->heap[(i - 1) / 2]->when > q->heap[i]->when)
+      siftup(q, i);
+    else
+      siftdown(q, i);
+  }
+  t->cpu = -1;
+}
+
+void
+timer_add(struct timer *t, uint64 when)
+{
+  struct timerq *q;
+  int first;
+
+  push_off();
+  q = &timerqs[cpuid()];
+  acquire(&q->lock);
+  if(q->n == NTIMER)
+    panic("timer_add");
+  t->when = when;
+  t->cpu = cpuid();
+  place(q, t, q->n++);
+  siftup(q, t->slot);
+  first = t->slot == 0;
+  release(&q->lock);
+  if(first)
+    timer_arm();
+  pop_off();
+}
+
+int
+timer_cancel(struct timer *t)
+{
+  struct timerq *q;
+  int cpu = t->cpu;
+
+  // t->cpu only ever changes to -1 behind our back.
+  if(cpu < 0)
+    return 0;
+  q = &timerqs[cpu];
+  acquire(&q->lock);
+  if(t->cpu != cpu){
+    release(&q->lock);
+    return 0;
+  }
+  // the cpu may take a timer interrupt for nothing; that's harmless.
+  removeat(q, t->slot);
+  release(&q->lock);
+  return 1;
+}
+
+void
+timer_run(void)
+{
+  struct cpu *c = mycpu();
+  struct timerq *q = &timerqs[cpuid()];
+  struct timer *t;
+  void (*fn)(void *);
+  void *arg;
+  uint64 late;
+
+  for(;;){
+    acquire(&q->lock);
+    if(q->n == 0 || q->heap[0]->when > r_time()){
+      release(&q->lock);
+      return;
+    }
+    t = q->heap[0];
+    removeat(q, 0);
+    fn = t->fn;
+    arg = t->arg;
+    late = r_time() - t->when;
+    release(&q->lock);
+
+    c->ntimer++;
+    c->timerlate += late;
+    if(late > c->maxtimerlate)
+      c->maxtimerlate = late;
+    fn(arg);
+  }
+}
+
+void
+timer_arm(void)
+{
+  struct cpu *c = mycpu();
+  struct timerq *q = &timerqs[cpuid()];
+  uint64 next = ~0ULL;
+
+  acquire(&q->lock);
+  if(q->n > 0)
+    next = q->heap[0]->when;
+  release(&q->lock);
+  if(c->proc && c->quantum < next)
+    next = c->quantum;
+  // this also clears a pending timer interrupt, unless next
+  // has already passed.
+  w_stimecmp(next);
+}
+
+// One sleeping process's timer, on its kernel stack.
+struct sleeper {
+  struct timer t;
+  int done;       // tickslock
+};
+
+static void
+sleepdone(void *arg)
+{
+  struct sleeper *s = arg;
+
+  acquire(&tickslock);
+  s->done = 1;
+  wakeup(s);
+  release(&tickslock);
+}
+
+int
+timer_sleep(uint64 when)
+{
+  struct sleeper s;
+
+  s.t.fn = sleepdone;
+  s.t.arg = &s;
+  s.done = 0;
+  acquire(&tickslock);
+  timer_add(&s.t, when);
+  while(!s.done){
+    // a timer already off its queue is about to fire and
+    // touch s, so wait for it even if killed.
+    if(killed(myproc()) && timer_cancel(&s.t)){
+      release(&tickslock);
+      return -1;
+    }
+    sleep(&s, &tickslock);
+  }
+  release(&tickslock);
+  return 0;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Per-CPU timer queues.
+ *
+ * Each CPU keeps its pending timers in a min-heap ordered by
+ * deadline and programs stimecmp for the earliest one, or for the
+ * end of the running process's time slice if that comes first.
+ * An idle CPU with no timers takes no timer interrupts at all.
+ * Deadlines are in r_time() cycles (10 MHz on qemu virt).
+ */
+
+#define TICKCYCLES 1000000 // r_time() cycles per tick, about 1/10 s
+#define TIMEHZ     10000000 // r_time() cycles per second
+#define NTIMER     (NPROC + 8) // timers per CPU queue
+
+/**
+ * struct timer - A one-shot timer
+ * @when: r_time() deadline
+ * @fn: Called with @arg on the queue's CPU once @when has passed,
+ *      with interrupts off and no timer lock held
+ * @arg: Argument for @fn
+ * @cpu: CPU whose queue holds the timer, or -1 if not pending
+ * @slot: Index in that queue's heap
+ */
+struct timer
+{
+  uint64 when;
+  void (*fn)(void *);
+  void *arg;
+  int cpu;
+  int slot;
+};
+
+/**
+ * timerq_init - Initialize the per-CPU timer queues
+ *
+ * Called once, by trapinit().
+ */
+void timerq_init(void);
+
+/**
+ * timer_add - Start a timer on this CPU
+ * @t: Timer with @fn and @arg set; must not be pending
+ * @when: r_time() deadline
+ *
+ * Reprograms this CPU's timer interrupt if @t is now the earliest.
+ */
+void timer_add(struct timer *t, uint64 when);
+
+/**
+ * timer_cancel - Stop a pending timer
+ * @t: Timer to stop
+ *
+ * Return: 1 if @t was pending and will not fire, 0 if it has already
+ * been taken off its queue to fire (or was never started), in which
+ * case @fn may still be running or about to run on another CPU
+ */
+int timer_cancel(struct timer *t);
+
+/**
+ * timer_run - Fire this CPU's expired timers
+ *
+ * Called from clockintr() with interrupts off.
+ */
+void timer_run(void);
+
+/**
+ * timer_arm - Program this CPU's next timer interrupt
+ *
+ * Sets stimecmp to this CPU's earliest timer deadline, or to the end
+ * of the running process's time slice (mycpu()->quantum) if that is
+ * sooner. With neither, no timer interrupt is requested.
+ * Caller must have interrupts off.
+ */
+void timer_arm(void);
+
+/**
+ * timer_sleep - Sleep until a deadline
+ * @when: r_time() deadline
+ *
+ * Return: 0, or -1 if the process was killed while sleeping
+ */
+int timer_sleep(uint64 when);
+
+/**
+ * sys_usleep - System call to sleep for a number of microseconds
+ *
+ * Return: 0, or -1 if the process was killed while sleeping
+ */
+uint64 sys_usleep(void);
+
+/**
+ * sys_uptimeus - System call to read the time since boot
+ *
+ * Return: Microseconds since boot, at r_time() resolution
+ */
+uint64 sys_uptimeus(void);
@@ -0,0 +1,139 @@
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+
+// One ring per CPU. head is only written by the owning CPU,
+// tail is only written by traceread(), so the two sides never
+// need a lock against each other.
+struct trace_ring {
+  struct trace_event ev[TRACE_RING_SIZE];
+  uint64 head;     // next slot the owning CPU fills
+  uint64 tail;     // next slot traceread() consumes
+  uint64 dropped;  // events lost because the ring was full
+} __attribute__((aligned(64)));
+
+static struct trace_ring rings[NCPU];
+
+volatile int trace_enabled = 0;
+
+// serializes readers; producers never take it.
+static struct spinlock trace_lock;
+
+void
+traceinit(void)
+{
+  initlock(&trace_lock, "trace");
+}
+
+void
+trace_emit(int type, uint64 arg0, uint64 arg1)
+{
+  struct trace_ring *r;
+  struct trace_event *e;
+  struct cpu *c;
+  uint64 head;
+
+  push_off();
+  c = mycpu();
+  r = &rings[cpuid()];
+  head = r->head;
+  if(head - r->tail >= TRACE_RING_SIZE){
+    __sync_fetch_and_add(&r->dropped, 1);
+    pop_off();
+    return;
+  }
+
+  e = &r->ev[head & (TRACE_RING_SIZE - 1)];
+  e->ts = r_time();
+  e->type = type;
+  e->cpu = cpuid();
+  e->pid = c->proc ? c->proc->pid : 0;
+  e->arg0 = arg0;
+  e->arg1 = arg1;
+
+  // publish the record before the new head.
+  __sync_synchronize();
+  r->head = head + 1;
+  pop_off();
+}
+
+uint64
+sys_tracectl(void)
+{
+  int on, old;
+
+  argint(0, &on);
+  old = trace_enabled;
+  if(on >= 0)
+    trace_enabled = (on != 0);
+  return old;
+}
+
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int max, n, i, best, lost;
+  uint64 heads[NCPU];
+  struct trace_event ev;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argint(1, &max);
+  if(max > 0)
+    uvmprefault(addr, (uint64)max * sizeof(ev), 1);
+
+  acquire(&trace_lock);
+  for(i = 0; i < NCPU; i++)
+    heads[i] = rings[i].head;
+  // see the records for every head we just loaded.
+  __sync_synchronize();
+
+  n = 0;
+  while(n < max){
+    // merge the rings by timestamp.
+    best = -1;
+    for(i = 0; i < NCPU; i++){
+      struct trace_ring *r = &rings[i];
+      if(r->tail == heads[i])
+        continue;
+      if(best < 0 ||
+         r->ev[r->tail & (TRACE_RING_SIZE - 1)].ts <
+         rings[best].ev[rings[best].tail & (TRACE_RING_SIZE - 1)].ts)
+        best = i;
+    }
+    if(best < 0)
+      break;
+
+    struct trace_ring *r = &rings[best];
+    ev = r->ev[r->tail & (TRACE_RING_SIZE - 1)];
+    lost = r->dropped != 0;
+    if(lost){
+      ev.type = TRACE_LOST;
+      ev.pid = 0;
+      ev.arg0 = __sync_lock_test_and_set(&r->dropped, 0);
+      ev.arg1 = 0;
+    }
+    // leave the event in its ring if the caller can't take it,
+    // and report only what was copied.
+    if(copyout(p->pagetable, addr + n * sizeof(ev), (char *)&ev, sizeof(ev)) < 0){
+      if(lost)
+        __sync_fetch_and_add(&r->dropped, ev.arg0);
+      release(&trace_lock);
+      return n > 0 ? n : -1;
+    }
+    if(!lost){
+      // finish reading the slot before handing it back.
+      __sync_synchronize();
+      r->tail++;
+    }
+    n++;
+  }
+  release(&trace_lock);
+  return n;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * Binary event tracing.
+ *
+ * Each CPU owns a ring of fixed-size records. Only the owning CPU
+ * produces into its ring (with interrupts off), and traceread()
+ * is the only consumer, so emitting an event needs no lock and no
+ * formatting. This header is shared with user space so that tools
+ * can decode the records returned by traceread().
+ */
+
+#define TRACE_RING_SIZE 512 // events per CPU ring, must be a power of 2
+
+/**
+ * enum trace_type - Kinds of trace events
+ * @TRACE_NONE: Unused record
+ * @TRACE_SLAB_CREATE: kmem_cache created (arg0: cache, arg1: object size)
+ * @TRACE_SLAB_ALLOC: Object allocated (arg0: cache, arg1: object)
+ * @TRACE_SLAB_FREE: Object freed (arg0: cache, arg1: object)
+ * @TRACE_SLAB_GROW: New slab page added (arg0: cache, arg1: slab)
+ * @TRACE_SLAB_SHRINK: Empty slab page released (arg0: cache, arg1: slab)
+ * @TRACE_BIO_HIT: bread() found the block cached (arg0: dev, arg1: blockno)
+ * @TRACE_BIO_MISS: bread() went to disk (arg0: dev, arg1: blockno)
+ * @TRACE_BIO_WRITE: bwrite() (arg0: dev, arg1: blockno)
+ * @TRACE_LOG_BEGIN: begin_op() admitted (arg0: outstanding, arg1: logged blocks)
+ * @TRACE_LOG_COMMIT: commit() (arg0: logged blocks)
+ * @TRACE_SCHED_SWITCH: scheduler() switched to a process (arg0: pid)
+ * @TRACE_LOST: Synthesized by traceread() when a full ring dropped events
+ *              (arg0: number of events lost)
+ * @TRACE_NTYPES: Number of event types
+ */
+enum trace_type
+{
+  TRACE_NONE,
+  TRACE_SLAB_CREATE,
+  TRACE_SLAB_ALLOC,
+  TRACE_SLAB_FREE,
+  TRACE_SLAB_GROW,
+  TRACE_SLAB_SHRINK,
+  TRACE_BIO_HIT,
+  TRACE_BIO_MISS,
+  TRACE_BIO_WRITE,
+  TRACE_LOG_BEGIN,
+  TRACE_LOG_COMMIT,
+  TRACE_SCHED_SWITCH,
+  TRACE_LOST,
+  TRACE_NTYPES
+};
+
+/**
+ * struct trace_event - One fixed-size trace record (32 bytes)
+ * @ts: r_time() when the event was emitted
+ * @type: &enum trace_type
+ * @cpu: Emitting hart
+ * @pid: Pid running on that hart, or 0 in scheduler/interrupt context
+ * @arg0: Event-specific argument
+ * @arg1: Event-specific argument
+ */
+struct trace_event
+{
+  uint64 ts;
+  uint16 type;
+  uint16 cpu;
+  uint32 pid;
+  uint64 arg0;
+  uint64 arg1;
+};
+
+/**
+ * trace_enabled - Non-zero while events are being recorded
+ *
+ * Checked inline by trace() so that a disabled trace point costs a
+ * single load and branch.
+ */
+extern volatile int trace_enabled;
+
+/**
+ * traceinit - Set up the lock that serializes trace readers
+ */
+void traceinit(void);
+
+/**
+ * trace_emit - Append an event to this CPU's ring
+ * @type: &enum trace_type
+ * @arg0: Event-specific argument
+ * @arg1: Event-specific argument
+ *
+ * Safe to call with any spinlock held and from interrupt context.
+ * If the ring is full the event is dropped and counted.
+ */
+void trace_emit(int type, uint64 arg0, uint64 arg1);
+
+/**
+ * sys_tracectl - System call to enable or disable tracing
+ *
+ * Takes one int argument: 1 to enable, 0 to disable, negative to
+ * only query.
+ *
+ * Return: The previous state (0 or 1)
+ */
+uint64 sys_tracectl(void);
+
+/**
+ * sys_traceread - System call to drain the trace rings
+ *
+ * Takes a user buffer of &struct trace_event and its capacity in
+ * events. Events from all CPUs are merged in timestamp order.
+ *
+ * Return: Number of events copied, or -1 on a bad buffer
+ */
+uint64 sys_traceread(void);
+
+/**
+ * trace - Record an event if tracing is enabled
+ * @type: &enum trace_type
+ * @arg0: Event-specific argument
+ * @arg1: Event-specific argument
+ */
+#define trace(type, arg0, arg1) \
+    do { if(trace_enabled) trace_emit((type), (uint64)(arg0), (uint64)(arg1)); } while(0)
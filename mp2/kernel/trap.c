@@ -5,9 +5,10 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "timer.h"
+#include "prof.h"
 
 struct spinlock tickslock;
-uint ticks;
 
 extern char trampoline[], uservec[], userret[];
 
@@ -20,6 +21,7 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  timerq_init();
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -65,6 +67,21 @@ usertrap(void)
     intr_on();
 
     syscall();
+  } else if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15){
+    // page fault: the page may be part of the executable or a
+    // mapping not yet read in, memory not yet allocated, or a
+    // clean page of a shared file mapping being written.
+    uint64 scause = r_scause();
+    uint64 va = r_stval();
+
+    // reading the executable sleeps on the disk.
+    intr_on();
+
+    if(uvmfault(va, scause == 15) < 0){
+      printf("usertrap(): unexpected scause 0x%lx pid=%d\n", scause, p->pid);
+      printf("            sepc=0x%lx stval=0x%lx\n", p->trapframe->epc, va);
+      setkilled(p);
+    }
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
@@ -76,7 +93,7 @@ usertrap(void)
   if(killed(p))
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if its time slice is over.
   if(which_dev == 2)
     yield();
 
@@ -150,7 +167,7 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if its time slice is over.
   if(which_dev == 2 && myproc() != 0)
     yield();
 
@@ -160,26 +177,38 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
+// fire this cpu's expired timers and ask for the next timer
+// interrupt, which also clears the interrupt request.
+// returns 1 if the running process's time slice is over.
+int
 clockintr()
 {
-  if(cpuid() == 0){
-    acquire(&tickslock);
-    ticks++;
-    wakeup(&ticks);
-    release(&tickslock);
+  struct cpu *c = mycpu();
+  int expired = 0;
+
+  prof_sync();
+  timer_run();
+  if(c->proc && r_time() >= c->quantum){
+    expired = 1;
+    c->quantum = r_time() + TICKCYCLES;
   }
+  timer_arm();
+  return expired;
+}
 
-  // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+// interrupt cpu id, e.g. to have it look at its run queue
+// while it is idle. arrives as a supervisor software interrupt
+// by way of ipivec in kernelvec.S.
+void
+sendipi(int id)
+{
+  *(volatile uint32 *)CLINT_MSIP(id) = 1;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if a timer interrupt ended the time slice,
+// 1 if other device or timer,
 // 0 if not recognized.
 int
 devintr()
@@ -209,8 +238,15 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000005L){
     // timer interrupt.
-    clockintr();
-    return 2;
+    return clockintr() ? 2 : 1;
+  } else if(scause == 0x8000000000000001L){
+    // software interrupt: an ipi from sendipi(). the
+    // interrupt itself got this cpu out of wfi; otherwise
+    // it only asks to start profiling.
+    w_sip(r_sip() & ~2);
+    mycpu()->nipi++;
+    prof_sync();
+    return 1;
   } else {
     return 0;
   }
@@ -35,6 +35,8 @@
 #define LSR_RX_READY (1<<0)   // input is waiting to be read from RHR
 #define LSR_TX_IDLE (1<<5)    // THR can accept another character to send
 
+#define UART_FIFO_SIZE 16     // bytes the transmit FIFO holds
+
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
@@ -44,6 +46,7 @@ struct spinlock uart_tx_lock;
 char uart_tx_buf[UART_TX_BUF_SIZE];
 uint64 uart_tx_w; // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
 uint64 uart_tx_r; // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
+volatile int uart_kicked; // printf() output may be waiting; see uartkick()
 
 extern volatile int panicked; // from printf.c
 
@@ -101,13 +104,15 @@ uartputc(int c)
   uart_tx_w += 1;
   uartstart();
   release(&uart_tx_lock);
+  if(uart_kicked)
+    uartkick();
 }
 
 
 // alternate version of uartputc() that doesn't 
-// use interrupts, for use by kernel printf() and
-// to echo characters. it spins waiting for the uart's
-// output register to be empty.
+// use interrupts, for use by kernel printf() before
+// it is buffered and after a panic. it spins waiting
+// for the uart's output register to be empty.
 void
 uartputc_sync(int c)
 {
@@ -126,34 +131,75 @@ uartputc_sync(int c)
   pop_off();
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
+// fill the UART's transmit FIFO, first with kernel printf()
+// output and then, if user is set, from the transmit buffer.
+// the UART only reports it can take a byte once the FIFO is
+// empty, so there is room for a FIFO's worth without asking
+// again. returns the number of bytes sent.
+// caller must hold uart_tx_lock.
+static int
+uartfill(int user)
+{
+  int c, n, taken = 0;
+
+  for(n = 0; n < UART_FIFO_SIZE; n++){
+    if((c = prgetc()) < 0){
+      if(!user || uart_tx_w == uart_tx_r)
+        break;
+      c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
+      uart_tx_r += 1;
+      taken = 1;
+    }
+    WriteReg(THR, c);
+  }
+
+  // maybe uartputc() is waiting for space in the buffer.
+  if(taken)
+    wakeup(&uart_tx_r);
+  return n;
+}
+
+// if the UART is idle, and characters are waiting in
+// the kernel printf() logs or the transmit buffer, send them.
 // caller must hold uart_tx_lock.
 // called from both the top- and bottom-half.
 void
 uartstart()
 {
   while(1){
-    if(uart_tx_w == uart_tx_r){
-      // transmit buffer is empty.
-      ReadReg(ISR);
-      return;
-    }
-    
     if((ReadReg(LSR) & LSR_TX_IDLE) == 0){
       // the UART transmit holding register is full,
       // so we cannot give it another byte.
       // it will interrupt when it's ready for a new byte.
       return;
     }
-    
-    int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
-    uart_tx_r += 1;
-    
-    // maybe uartputc() is waiting for space in the buffer.
-    wakeup(&uart_tx_r);
-    
-    WriteReg(THR, c);
+
+    if(uartfill(1) == 0){
+      // transmit buffer is empty.
+      ReadReg(ISR);
+      return;
+    }
+  }
+}
+
+// send kernel printf() output, if no other CPU holds
+// uart_tx_lock. called by printf() with interrupts off and
+// perhaps other locks held, so it neither waits for the lock
+// nor wakes up writers. uart_kicked is set before trying the
+// lock, and every holder looks at it after releasing, so
+// output published while another CPU held the lock is sent
+// by that CPU.
+void
+uartkick(void)
+{
+  uart_kicked = 1;
+  __sync_synchronize();
+  while(uart_kicked && tryacquire(&uart_tx_lock)){
+    uart_kicked = 0;
+    while((ReadReg(LSR) & LSR_TX_IDLE) && uartfill(0) > 0)
+      ;
+    release(&uart_tx_lock);
+    __sync_synchronize();
   }
 }
 
@@ -188,4 +234,6 @@ uartintr(void)
   acquire(&uart_tx_lock);
   uartstart();
   release(&uart_tx_lock);
+  if(uart_kicked)
+    uartkick();
 }
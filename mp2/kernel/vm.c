@@ -5,6 +5,9 @@
 #include "riscv.h"
 #include "defs.h"
 #include "fs.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "mmap.h"
 
 /*
  * the kernel's page table.
@@ -30,6 +33,9 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT msip words, for inter-processor interrupts
+  kvmmap(kpgtbl, CLINT, CLINT, PGSIZE, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x4000000, PTE_R | PTE_W);
 
@@ -82,15 +88,28 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// If va lies in a megapage, the level-1 leaf PTE mapping the
+// whole megapage (marked PTE_MEGA) is returned instead.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  return walklevel(pagetable, va, 0, alloc);
+}
+
+// Like walk(), but stop at the PTE of the given level,
+// 1 for a megapage.
+pte_t *
+walklevel(pagetable_t pagetable, uint64 va, int to, int alloc)
 {
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
+  for(int level = 2; level > to; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(PTE_LEAF(*pte))
+        return pte;
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
@@ -99,7 +118,17 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
-  return &pagetable[PX(0, va)];
+  return &pagetable[PX(to, va)];
+}
+
+// Physical address of the 4 KiB page holding va,
+// given the leaf PTE that walk() found for it.
+static uint64
+leafpa(pte_t pte, uint64 va)
+{
+  if(pte & PTE_MEGA)
+    return PTE2PA(pte) + PGROUNDDOWN(va - MEGAPGROUNDDOWN(va));
+  return PTE2PA(pte);
 }
 
 // Look up a virtual address, return the physical address,
@@ -121,7 +150,7 @@ walkaddr(pagetable_t pagetable, uint64 va)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
-  pa = PTE2PA(*pte);
+  pa = leafpa(*pte, va);
   return pa;
 }
 
@@ -137,7 +166,9 @@ kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa.
-// va and size MUST be page-aligned.
+// va and size MUST be page-aligned. Wherever va and pa are both
+// 2 MiB-aligned and at least 2 MiB remain, a single megapage PTE
+// is used, unless the kernel is built with NOMEGAPAGE.
 // Returns 0 on success, -1 if walk() couldn't
 // allocate a needed page-table page.
 int
@@ -158,6 +189,20 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = va;
   last = va + size - PGSIZE;
   for(;;){
+#ifndef NOMEGAPAGE
+    if(a % MEGAPGSIZE == 0 && pa % MEGAPGSIZE == 0 && last - a >= MEGAPGSIZE - PGSIZE){
+      if((pte = walklevel(pagetable, a, 1, 1)) == 0)
+        return -1;
+      if(*pte & PTE_V)
+        panic("mappages: remap");
+      *pte = PA2PTE(pa) | perm | PTE_MEGA | PTE_V;
+      if(a == last - (MEGAPGSIZE - PGSIZE))
+        break;
+      a += MEGAPGSIZE;
+      pa += MEGAPGSIZE;
+      continue;
+    }
+#endif
     if((pte = walk(pagetable, a, 1)) == 0)
       return -1;
     if(*pte & PTE_V)
@@ -171,8 +216,29 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   return 0;
 }
 
+// Turn the megapage leaf *pte into a page-table page of 512
+// ordinary PTEs for the same memory, except for the page at va,
+// which is being unmapped and becomes the page-table page itself.
+static void
+splitmega(pte_t *pte, uint64 va)
+{
+  uint64 base = MEGAPGROUNDDOWN(va);
+  uint64 pa = PTE2PA(*pte);
+  int flags = PTE_FLAGS(*pte) & ~PTE_MEGA;
+  pagetable_t tbl = (pagetable_t)leafpa(*pte, va);
+
+  for(int i = 0; i < 512; i++){
+    if(base + i * PGSIZE == va)
+      tbl[i] = 0;
+    else
+      tbl[i] = PA2PTE(pa + i * PGSIZE) | flags;
+  }
+  *pte = PA2PTE(tbl) | PTE_V;
+}
+
 // Remove npages of mappings starting from va. va must be
-// page-aligned. The mappings must exist.
+// page-aligned. Pages that were never faulted in are skipped.
+// A megapage only partly in the range is split into pages.
 // Optionally free the physical memory.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
@@ -184,12 +250,28 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     panic("uvmunmap: not aligned");
 
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0)
-      panic("uvmunmap: walk");
+    if((pte = walk(pagetable, a, 0)) == 0){
+      // no page-table page: skip the 512 pages it would map.
+      a |= MEGAPGSIZE - PGSIZE;
+      continue;
+    }
     if((*pte & PTE_V) == 0)
-      panic("uvmunmap: not mapped");
+      continue;
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
+    if(*pte & PTE_MEGA){
+      // megapages are only used for heap memory the process owns.
+      if(!do_free)
+        panic("uvmunmap: megapage");
+      if(a % MEGAPGSIZE == 0 && a + MEGAPGSIZE <= va + npages*PGSIZE){
+        kfreemega((void*)PTE2PA(*pte));
+        *pte = 0;
+        a += MEGAPGSIZE - PGSIZE;
+      } else {
+        splitmega(pte, a);
+      }
+      continue;
+    }
     if(do_free){
       uint64 pa = PTE2PA(*pte);
       kfree((void*)pa);
@@ -306,7 +388,8 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 // Given a parent process's page table, copy
 // its memory into a child's page table.
 // Copies both the page table and the
-// physical memory.
+// physical memory of the resident pages;
+// the child faults in the rest itself.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
@@ -318,12 +401,24 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   char *mem;
 
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
+    if((pte = walk(old, i, 0)) == 0){
+      i |= MEGAPGSIZE - PGSIZE;
+      continue;
+    }
     if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
-    flags = PTE_FLAGS(*pte);
+      continue;
+    pa = leafpa(*pte, i);
+    flags = PTE_FLAGS(*pte) & ~PTE_MEGA;
+    if((*pte & PTE_MEGA) && i % MEGAPGSIZE == 0 && (mem = kallocmega()) != 0){
+      memmove(mem, (char*)pa, MEGAPGSIZE);
+      if(mappages(new, i, MEGAPGSIZE, (uint64)mem, flags) != 0){
+        kfreemega(mem);
+        goto err;
+      }
+      i += MEGAPGSIZE - PGSIZE;
+      continue;
+    }
+    // without a free megapage the child gets ordinary pages.
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
@@ -352,6 +447,142 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
+// Back the whole 2 MiB block holding va with a zeroed megapage,
+// for a process that asked for them with megapages(). Only done
+// if the block is heap below p->sz that nothing was mapped in
+// yet, which also keeps out the stack, and no ELF segment
+// overlaps it. Returns 0 on success, -1 to use a page instead.
+static int
+uvmmegafault(struct proc *p, uint64 va)
+{
+  uint64 base = MEGAPGROUNDDOWN(va);
+  struct execseg *s;
+  pte_t *pte;
+  char *mem;
+
+  if(base + MEGAPGSIZE > p->sz)
+    return -1;
+  if((pte = walklevel(p->pagetable, base, 1, 0)) != 0 && (*pte & PTE_V))
+    return -1;
+  for(s = p->seg; s < &p->seg[p->nseg]; s++)
+    if(s->va < base + MEGAPGSIZE && base < s->va + s->memsz)
+      return -1;
+  if((mem = kallocmega()) == 0)
+    return -1;
+  memset(mem, 0, MEGAPGSIZE);
+  if(mappages(p->pagetable, base, MEGAPGSIZE, (uint64)mem, PTE_R|PTE_U|PTE_W) != 0){
+    kfreemega(mem);
+    return -1;
+  }
+  p->nfault += MEGAPGSIZE / PGSIZE;
+  return 0;
+}
+
+// Count the page-table pages of pagetable.
+uint64
+ptpages(pagetable_t pagetable)
+{
+  uint64 n = 1;
+
+  for(int i = 0; i < 512; i++){
+    pte_t pte = pagetable[i];
+    if((pte & PTE_V) && !PTE_LEAF(pte))
+      n += ptpages((pagetable_t)PTE2PA(pte));
+  }
+  return n;
+}
+
+// Count the page-table pages of the kernel page table.
+uint64
+kvmptpages(void)
+{
+  return ptpages(kernel_pagetable);
+}
+
+// Make the page holding user address va of the current process
+// accessible, for a store if write is set: mmap() regions are
+// handled by mmapfault(), pages of the executable are read in by
+// loadpage(), anything else below p->sz is zero-filled.
+// Returns 0 on success, or -1 if va is not a user address, is
+// already mapped (a protection fault), or the page could not be
+// allocated or read.
+int
+uvmfault(uint64 va, int write)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  char *mem;
+  int perm = PTE_W, r;
+
+  va = PGROUNDDOWN(va);
+  if(va >= MAXVA)
+    return -1;
+  if((r = mmapfault(p, va, write)) != 0)
+    return r < 0 ? -1 : 0;
+  if(va >= p->sz)
+    return -1;
+  if((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V))
+    return -1;
+  if(p->megapages && uvmmegafault(p, va) == 0)
+    return 0;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(loadpage(p, va, mem, &perm) < 0 ||
+     mappages(p->pagetable, va, PGSIZE, (uint64)mem, PTE_R|PTE_U|perm) != 0){
+    kfree(mem);
+    return -1;
+  }
+  p->nfault++;
+  return 0;
+}
+
+// Fault in the pages of [va, va+len) of the current process,
+// writable if write is set, ahead of a copy that will be made
+// with a spinlock held, when reading a file is not possible.
+// Stops at the first bad page; the copy itself reports it.
+void
+uvmprefault(uint64 va, uint64 len, int write)
+{
+  struct proc *p = myproc();
+  uint64 a;
+  pte_t *pte;
+
+  if(va + len < va)
+    return;
+  for(a = PGROUNDDOWN(va); a < va + len && a < MAXVA; a += PGSIZE){
+    pte = walk(p->pagetable, a, 0);
+    if(pte && (*pte & PTE_V) && (!write || (*pte & PTE_W)))
+      continue;
+    if(uvmfault(a, write) < 0)
+      break;
+  }
+}
+
+// Look up user page va0 for a copy to (write set) or from
+// pagetable, first faulting it in if pagetable is the current
+// process's. Returns the PTE, or 0 if va0 is not accessible
+// from user mode.
+static pte_t *
+uvmpte(pagetable_t pagetable, uint64 va0, int write)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+
+  if(va0 >= MAXVA)
+    return 0;
+  pte = walk(pagetable, va0, 0);
+  if((pte == 0 || (*pte & PTE_V) == 0 || (write && (*pte & PTE_W) == 0)) &&
+     p && p->pagetable == pagetable){
+    if(uvmfault(va0, write) < 0)
+      return 0;
+    pte = walk(pagetable, va0, 0);
+  }
+  if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0)
+    return 0;
+  return pte;
+}
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
@@ -363,13 +594,10 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    if(va0 >= MAXVA)
-      return -1;
-    pte = walk(pagetable, va0, 0);
-    if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 ||
-       (*pte & PTE_W) == 0)
+    pte = uvmpte(pagetable, va0, 1);
+    if(pte == 0 || (*pte & PTE_W) == 0)
       return -1;
-    pa0 = PTE2PA(*pte);
+    pa0 = leafpa(*pte, va0);
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -389,12 +617,13 @@ int
 copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
+  pte_t *pte;
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if((pte = uvmpte(pagetable, va0, 0)) == 0)
       return -1;
+    pa0 = leafpa(*pte, va0);
     n = PGSIZE - (srcva - va0);
     if(n > len)
       n = len;
@@ -415,13 +644,14 @@ int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
   uint64 n, va0, pa0;
+  pte_t *pte;
   int got_null = 0;
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if((pte = uvmpte(pagetable, va0, 0)) == 0)
       return -1;
+    pa0 = leafpa(*pte, va0);
     n = PGSIZE - (srcva - va0);
     if(n > max)
       n = max;
@@ -0,0 +1,94 @@
+// exec() benchmark.
+//
+// Starts each program the given number of times with arguments
+// that make it exit at once, and reports the average time from
+// fork() to wait() and, for one run, how many of its pages were
+// resident when it exited compared to the size of its image.
+//
+//   execbench [runs]
+
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+// usertests exits with a usage message on an unknown flag; sh
+// exits at the end of its (empty) input.
+static char *usertests[] = { "usertests", "-x", 0 };
+static char *sh[] = { "sh", 0 };
+
+// Start argv[0] with stdin at end of file and stdout and stderr
+// going nowhere.
+int
+start(char **argv)
+{
+  int in[2], out[2], pid;
+
+  if(pipe(in) < 0 || pipe(out) < 0){
+    fprintf(2, "execbench: pipe failed\n");
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    fprintf(2, "execbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(0);
+    dup(in[0]);
+    close(1);
+    dup(out[1]);
+    close(2);
+    dup(out[1]);
+    close(in[0]);
+    close(in[1]);
+    close(out[0]);
+    close(out[1]);
+    exec(argv[0], argv);
+    exit(1);
+  }
+  close(in[0]);
+  close(in[1]);
+  close(out[0]);
+  close(out[1]);
+  return pid;
+}
+
+void
+bench(char **argv, int runs)
+{
+  struct memstat st;
+  int i, pid, t0, t;
+
+  t0 = uptime();
+  for(i = 0; i < runs; i++){
+    start(argv);
+    wait(0);
+  }
+  t = uptime() - t0;
+
+  // catch one run between exit() and wait() to count its pages.
+  pid = start(argv);
+  while(memstat(pid, &st) < 0)
+    sleep(1);
+  wait(0);
+
+  printf("execbench: %s: %d runs in %d ticks", argv[0], runs, t);
+  if(runs > 0)
+    printf(" (%d.%d ticks/run)", t / runs, t * 10 / runs % 10);
+  printf("\n  %lu of %lu pages resident, %lu read from the file\n",
+         st.resident, st.sz / PGSIZE, st.nload);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int runs = 20;
+
+  if(argc > 1)
+    runs = atoi(argv[1]);
+
+  bench(usertests, runs);
+  bench(sh, runs);
+  exit(0);
+}
@@ -0,0 +1,111 @@
+// Sparse heap benchmark.
+//
+// Each workload runs in a fresh child, which reports how long it
+// took and how many of its pages were resident at the end:
+//
+//   sparse  sbrk() a large region and touch one byte per stride
+//   dense   sbrk() the same region and touch every page
+//   malloc  malloc() many large blocks and use only their start
+//
+//   heapbench [MiB [stride]]
+
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define NBLOCK 64
+
+void
+report(char *name, int t, uint64 before)
+{
+  struct memstat st;
+
+  if(memstat(0, &st) < 0){
+    fprintf(2, "heapbench: memstat failed\n");
+    exit(1);
+  }
+  printf("%s\t%d ticks\t%lu pages resident of %lu (%lu faulted in)\n",
+         name, t, st.resident - before, st.sz / PGSIZE, st.nfault);
+}
+
+uint64
+resident(void)
+{
+  struct memstat st;
+
+  memstat(0, &st);
+  return st.resident;
+}
+
+void
+touch(char *name, int mib, int stride)
+{
+  uint64 before = resident();
+  int t0 = uptime();
+  char *p;
+  int i;
+
+  if((p = sbrk(mib * 1024 * 1024)) == (char*)-1){
+    fprintf(2, "heapbench: sbrk failed\n");
+    exit(1);
+  }
+  for(i = 0; i < mib * 1024 * 1024; i += stride * PGSIZE)
+    p[i] = 1;
+  report(name, uptime() - t0, before);
+}
+
+void
+blocks(int mib)
+{
+  uint64 before = resident();
+  int t0 = uptime();
+  char *p;
+  int i;
+
+  for(i = 0; i < NBLOCK; i++){
+    if((p = malloc(mib * 1024 * 1024 / NBLOCK)) == 0){
+      fprintf(2, "heapbench: malloc failed\n");
+      exit(1);
+    }
+    p[0] = 1;
+  }
+  report("malloc", uptime() - t0, before);
+}
+
+void
+run(int w, int mib, int stride)
+{
+  int pid;
+
+  if((pid = fork()) < 0){
+    fprintf(2, "heapbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    if(w == 0)
+      touch("sparse", mib, stride);
+    else if(w == 1)
+      touch("dense", mib, 1);
+    else
+      blocks(mib);
+    exit(0);
+  }
+  wait(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mib = 32, stride = 16, w;
+
+  if(argc > 1)
+    mib = atoi(argv[1]);
+  if(argc > 2)
+    stride = atoi(argv[2]);
+
+  printf("heapbench: %d MiB, sparse stride %d pages\n", mib, stride);
+  for(w = 0; w < 3; w++)
+    run(w, mib, stride);
+  exit(0);
+}
@@ -0,0 +1,134 @@
+// Spinlock stress benchmark.
+//
+// Runs nproc processes that hammer one kernel lock each and reports
+// throughput plus the wait-time tail recorded by lockstat().
+// Build the kernel with LOCKTYPE=LOCK_TAS and LOCKTYPE=LOCK_TICKET
+// to compare the two implementations.
+//
+//   lockbench [nproc [iterations]]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+static struct lockstat stats[NLOCKSTAT];
+
+void
+kmem_op(void)
+{
+  // kalloc() and kfree() four pages.
+  if(sbrk(4 * 4096) == (char *)-1){
+    fprintf(2, "lockbench: sbrk failed\n");
+    exit(1);
+  }
+  sbrk(-4 * 4096);
+}
+
+void
+bcache_op(void)
+{
+  char buf[64];
+  int fd;
+
+  if((fd = open("README", O_RDONLY)) < 0){
+    fprintf(2, "lockbench: open README failed\n");
+    exit(1);
+  }
+  read(fd, buf, sizeof(buf));
+  close(fd);
+}
+
+void
+time_op(void)
+{
+  uptime();
+}
+
+struct workload {
+  char *name;
+  char *lock;   // lock class whose wait times are reported
+  void (*op)(void);
+} workloads[] = {
+  { "kmem",   "kmem",   kmem_op },
+  { "bcache", "bcache", bcache_op },
+  { "ticks",  "time",   time_op },
+};
+
+// wait time, in r_time() ticks, below which pct percent of all
+// acquisitions of s completed (bucket upper bound).
+uint64
+percentile(struct lockstat *s, int pct)
+{
+  uint64 target, seen;
+  int b;
+
+  target = s->nacquire * pct / 100;
+  seen = s->nacquire - s->ncontended;
+  if(seen >= target)
+    return 0;
+  for(b = 0; b < LOCKSTAT_NHIST; b++){
+    seen += s->hist[b];
+    if(seen >= target)
+      return 2UL << b;
+  }
+  return s->maxwait;
+}
+
+void
+bench(struct workload *w, int nproc, int iters)
+{
+  int i, j, n, t0, t;
+  struct lockstat *s = 0;
+
+  lockstat(0, 0);
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      for(j = 0; j < iters; j++)
+        w->op();
+      exit(0);
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  t = uptime() - t0;
+
+  n = lockstat(stats, NLOCKSTAT);
+  for(i = 0; i < n; i++)
+    if(strcmp(stats[i].name, w->lock) == 0)
+      s = &stats[i];
+
+  printf("%s: %d ops in %d ticks", w->name, nproc * iters, t);
+  if(t > 0)
+    printf(" (%d ops/tick)", nproc * iters / t);
+  printf("\n");
+  if(s){
+    printf("  lock %s: %lu acquires, %lu contended, p50 %lu p99 %lu max %lu wait ticks\n",
+           s->name, s->nacquire, s->ncontended,
+           percentile(s, 50), percentile(s, 99), s->maxwait);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 4, iters = 1000, i, type;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    iters = atoi(argv[2]);
+
+  type = lockstat(0, 0);
+  printf("lockbench: %s locks, %d processes, %d iterations\n",
+         type == LOCKSTAT_TICKET ? "ticket" : "test-and-set", nproc, iters);
+  for(i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    bench(&workloads[i], nproc, iters);
+  exit(0);
+}
@@ -0,0 +1,70 @@
+// Print spinlock contention statistics.
+//
+//   lockstat          print counters since boot (or the last reset)
+//   lockstat -r       reset the counters
+//   lockstat cmd ...  reset, run cmd, then print
+
+#include "kernel/types.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+static struct lockstat stats[NLOCKSTAT];
+
+void
+print(void)
+{
+  int n, i, j;
+  struct lockstat tmp;
+
+  if((n = lockstat(stats, NLOCKSTAT)) < 0){
+    fprintf(2, "lockstat: failed\n");
+    exit(1);
+  }
+
+  // most contended first.
+  for(i = 1; i < n; i++){
+    tmp = stats[i];
+    for(j = i; j > 0 && stats[j-1].ncontended < tmp.ncontended; j--)
+      stats[j] = stats[j-1];
+    stats[j] = tmp;
+  }
+
+  printf("name            acquire  contended  spin-ticks  max-wait\n");
+  for(i = 0; i < n; i++){
+    struct lockstat *s = &stats[i];
+    if(s->nacquire == 0)
+      continue;
+    printf("%s", s->name);
+    for(j = strlen(s->name); j < LOCKSTAT_NAME; j++)
+      printf(" ");
+    printf("%lu %lu %lu %lu\n", s->nacquire, s->ncontended, s->spins, s->maxwait);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, type;
+
+  if(argc == 2 && strcmp(argv[1], "-r") == 0){
+    lockstat(0, 0);
+    exit(0);
+  }
+  if(argc >= 2){
+    type = lockstat(0, 0);
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+    printf("lock type: %s\n", type == LOCKSTAT_TICKET ? "ticket" : "test-and-set");
+  }
+  print();
+  exit(0);
+}
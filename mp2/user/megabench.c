@@ -0,0 +1,78 @@
+// Megapage benchmark.
+//
+// Reports the size of the kernel page table, then, with
+// megapages() off and on, grows the heap by a 2 MiB-aligned
+// region, faults it in, and walks it touching one word per page
+// so nearly every access needs a different TLB entry. Build the
+// kernel with "make MEGAPAGES=0" to compare the kernel side. The
+// kernel keeps 16 MiB for megapages; beyond that the heap gets
+// ordinary pages.
+//
+//   megabench [MiB [passes]]
+
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define PGSIZE     4096
+#define MEGAPGSIZE (PGSIZE << 9)
+
+void
+run(int on, int mib, int passes)
+{
+  struct memstat st;
+  volatile char *p;
+  uint64 size = (uint64)mib * 1024 * 1024, i;
+  int pass, t0, tfault, twalk;
+  uint sum = 0;
+
+  if(megapages(on) < 0){
+    printf("megapages %s: not available in this kernel\n", on ? "on" : "off");
+    return;
+  }
+  p = sbrk(0);
+  if(sbrk(MEGAPGSIZE - (uint64)p % MEGAPGSIZE) == (char*)-1 ||
+     (p = sbrk(size)) == (char*)-1){
+    fprintf(2, "megabench: sbrk failed\n");
+    exit(1);
+  }
+
+  t0 = uptime();
+  for(i = 0; i < size; i += PGSIZE)
+    p[i] = 1;
+  tfault = uptime() - t0;
+
+  t0 = uptime();
+  for(pass = 0; pass < passes; pass++)
+    for(i = 0; i < size; i += PGSIZE)
+      sum += p[i];
+  twalk = uptime() - t0;
+
+  memstat(0, &st);
+  printf("megapages %s: fault-in %d ticks, %d stride walks %d ticks, "
+         "%lu page-table pages (sum %d)\n",
+         on ? "on" : "off", tfault, passes, twalk, st.ptpages, sum);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct memstat st;
+  int mib = 16, passes = 50, on;
+
+  if(argc > 1)
+    mib = atoi(argv[1]);
+  if(argc > 2)
+    passes = atoi(argv[2]);
+
+  memstat(0, &st);
+  printf("megabench: kernel page table %lu pages; %d MiB heap\n", st.kptpages, mib);
+  for(on = 0; on < 2; on++){
+    if(fork() == 0){
+      run(on, mib, passes);
+      exit(0);
+    }
+    wait(0);
+  }
+  exit(0);
+}
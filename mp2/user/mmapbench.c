@@ -0,0 +1,206 @@
+// mmap() benchmark.
+//
+// file:  sums a file runs times with read() into a buffer and
+//        with mmap(), and checks that stores through a MAP_SHARED
+//        mapping reach the file.
+// ipc:   streams data from a child to its parent through a pipe
+//        and through MAP_SHARED|MAP_ANON memory, double-buffered
+//        with a one-byte pipe message per half as the doorbell.
+//
+//   mmapbench [KiB [runs]]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define CHUNK  (8 * PGSIZE)
+
+static char buf[CHUNK];
+static char *name = "mmapbench.tmp";
+
+void
+fail(char *what)
+{
+  fprintf(2, "mmapbench: %s failed\n", what);
+  unlink(name);
+  exit(1);
+}
+
+void
+mkfile(int size)
+{
+  int fd, i, n;
+
+  if((fd = open(name, O_CREATE|O_TRUNC|O_RDWR)) < 0)
+    fail("create");
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = i;
+  for(i = 0; i < size; i += n){
+    n = size - i < CHUNK ? size - i : CHUNK;
+    if(write(fd, buf, n) != n)
+      fail("write");
+  }
+  close(fd);
+}
+
+uint
+sumread(int size)
+{
+  int fd, i, n;
+  uint sum = 0;
+
+  if((fd = open(name, O_RDONLY)) < 0)
+    fail("open");
+  while((n = read(fd, buf, CHUNK)) > 0)
+    for(i = 0; i < n; i++)
+      sum += (uchar)buf[i];
+  close(fd);
+  return sum;
+}
+
+uint
+summap(int size)
+{
+  int fd, i;
+  uchar *p;
+  uint sum = 0;
+
+  if((fd = open(name, O_RDONLY)) < 0)
+    fail("open");
+  if((p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    fail("mmap");
+  close(fd);
+  for(i = 0; i < size; i++)
+    sum += p[i];
+  munmap(p, size);
+  return sum;
+}
+
+// store through a shared mapping, unmap, and read it back.
+void
+writeback(int size)
+{
+  int fd, off, n;
+  char *p;
+
+  if((fd = open(name, O_RDWR)) < 0)
+    fail("open");
+  if((p = mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    fail("mmap");
+  close(fd);
+  p[size / 2] = 'M';
+  munmap(p, size);
+
+  if((fd = open(name, O_RDONLY)) < 0)
+    fail("open");
+  for(off = 0; (n = read(fd, buf, CHUNK)) > 0; off += n)
+    if(off <= size / 2 && size / 2 < off + n)
+      break;
+  close(fd);
+  if(n <= 0 || buf[size / 2 - off] != 'M')
+    fail("write-back");
+  printf("file: MAP_SHARED store reached the file\n");
+}
+
+void
+filebench(int size, int runs)
+{
+  int i, t0, tr, tm;
+  uint s1 = 0, s2 = 0;
+
+  mkfile(size);
+  t0 = uptime();
+  for(i = 0; i < runs; i++)
+    s1 = sumread(size);
+  tr = uptime() - t0;
+  t0 = uptime();
+  for(i = 0; i < runs; i++)
+    s2 = summap(size);
+  tm = uptime() - t0;
+  if(s1 != s2)
+    fail("checksum");
+  printf("file: %d KiB x %d: read() %d ticks, mmap() %d ticks\n",
+         size / 1024, runs, tr, tm);
+}
+
+int
+viapipe(int total)
+{
+  int fds[2], n, left, t0;
+
+  if(pipe(fds) < 0)
+    fail("pipe");
+  t0 = uptime();
+  if(fork() == 0){
+    close(fds[0]);
+    for(left = total; left > 0; left -= CHUNK)
+      if(write(fds[1], buf, CHUNK) != CHUNK)
+        exit(1);
+    exit(0);
+  }
+  close(fds[1]);
+  for(left = total; left > 0; left -= n)
+    if((n = read(fds[0], buf, CHUNK)) <= 0)
+      fail("read");
+  close(fds[0]);
+  wait(0);
+  return uptime() - t0;
+}
+
+int
+viashm(int total)
+{
+  int full[2], empty[2], left, half, t0;
+  char *shm, tok = 0;
+
+  if((shm = mmap(0, 2 * CHUNK, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0)) == MAP_FAILED)
+    fail("mmap");
+  if(pipe(full) < 0 || pipe(empty) < 0)
+    fail("pipe");
+  // both halves start empty.
+  write(empty[1], &tok, 1);
+  write(empty[1], &tok, 1);
+  t0 = uptime();
+  if(fork() == 0){
+    for(left = total, half = 0; left > 0; left -= CHUNK, half ^= 1){
+      if(read(empty[0], &tok, 1) != 1)
+        exit(1);
+      memmove(shm + half * CHUNK, buf, CHUNK);
+      write(full[1], &tok, 1);
+    }
+    exit(0);
+  }
+  for(left = total, half = 0; left > 0; left -= CHUNK, half ^= 1){
+    if(read(full[0], &tok, 1) != 1)
+      fail("read");
+    memmove(buf, shm + half * CHUNK, CHUNK);
+    write(empty[1], &tok, 1);
+  }
+  wait(0);
+  close(full[0]); close(full[1]);
+  close(empty[0]); close(empty[1]);
+  munmap(shm, 2 * CHUNK);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kib = 256, runs = 10, t;
+
+  if(argc > 1)
+    kib = atoi(argv[1]);
+  if(argc > 2)
+    runs = atoi(argv[2]);
+
+  filebench(kib * 1024, runs);
+  writeback(kib * 1024);
+  unlink(name);
+
+  t = viapipe(runs * kib * 1024);
+  printf("ipc: %d KiB: pipe %d ticks,", runs * kib, t);
+  t = viashm(runs * kib * 1024);
+  printf(" shared memory %d ticks\n", t);
+  exit(0);
+}
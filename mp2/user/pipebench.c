@@ -0,0 +1,95 @@
+// Pipe throughput benchmark.
+//
+// Streams the same amount of data through a pipe with a range of
+// message sizes, through a default pipe(), a 16-page pipe2() and
+// a 16-page PIPE_ZEROCOPY pipe2(), and reports KiB per tick.
+//
+//   pipebench [KiB]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define MAXMSG (16 * PGSIZE)
+
+static int sizes[] = { 1, 64, 512, 4096, 16384, 65536 };
+
+// page-aligned buffer, so zero-copy transfers can exchange pages.
+char*
+pagebuf(int n)
+{
+  char *p = sbrk(0);
+
+  if(sbrk(PGSIZE - (uint64)p % PGSIZE) == (char*)-1 || (p = sbrk(n)) == (char*)-1){
+    fprintf(2, "pipebench: sbrk failed\n");
+    exit(1);
+  }
+  return p;
+}
+
+int
+run(char *buf, int total, int msg, int npages, int flags)
+{
+  int fds[2], pid, n, left, t0;
+
+  if((npages ? pipe2(fds, npages, flags) : pipe(fds)) < 0){
+    fprintf(2, "pipebench: pipe failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  if((pid = fork()) < 0){
+    fprintf(2, "pipebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(left = total; left > 0; left -= n){
+      n = left < msg ? left : msg;
+      if(write(fds[1], buf, n) != n){
+        fprintf(2, "pipebench: write failed\n");
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  close(fds[1]);
+  for(left = total; left > 0; left -= n){
+    if((n = read(fds[0], buf, left < msg ? left : msg)) <= 0){
+      fprintf(2, "pipebench: short read\n");
+      exit(1);
+    }
+  }
+  close(fds[0]);
+  wait(0);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kib = 1024, i, total, msg, t;
+  char *buf;
+
+  if(argc > 1)
+    kib = atoi(argv[1]);
+  total = kib * 1024;
+  buf = pagebuf(MAXMSG);
+  memset(buf, 'x', MAXMSG);
+
+  printf("pipebench: %d KiB per run (KiB/tick)\n", kib);
+  printf("msg     pipe    16-page  zerocopy\n");
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+    msg = sizes[i];
+    // one-byte messages are slow; send less.
+    int n = msg == 1 ? total / 64 : total;
+    printf("%d", msg);
+    t = run(buf, n, msg, 0, 0);
+    printf("\t%d", t > 0 ? n / 1024 / t : n / 1024);
+    t = run(buf, n, msg, 16, 0);
+    printf("\t%d", t > 0 ? n / 1024 / t : n / 1024);
+    t = run(buf, n, msg, 16, PIPE_ZEROCOPY);
+    printf("\t%d\n", t > 0 ? n / 1024 / t : n / 1024);
+  }
+  exit(0);
+}
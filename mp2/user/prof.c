@@ -0,0 +1,305 @@
+// Flat profile of a command from the kernel's sampling profiler.
+//
+// Runs cmd with profiling on and prints where its cpus spent their
+// samples, by function. Kernel pcs are looked up in kernel.sym and
+// user pcs of processes named cmd in cmd.sym (both copied into
+// fs.img by the Makefile); other processes' user samples are
+// counted by process name, and samples taken while a cpu had
+// nothing to run count as idle.
+//
+//   prof cmd [arg ...]
+//
+// e.g. "prof usertests" or "prof stressfs".
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NBATCH 64
+#define NOTHER 16  // other process names counted
+#define NTOP   30  // functions printed
+
+struct sym {
+  uint64 addr;
+  char *name;
+  int count;
+};
+
+struct symtab {
+  char *prefix;   // printed before each name
+  struct sym *syms;
+  int n;
+};
+
+static struct prof_sample buf[NBATCH];
+static struct symtab ktab = { "kernel:" }, utab;
+static struct sym other[NOTHER];
+static int nother;
+static char *cmd;
+static int total, nuser, nkernel, nidle, nlost, nunknown;
+
+// Load a symbol table as written by the Makefile: one
+// "address name" line per symbol, sorted by address here.
+// Leaves tab empty if file can't be read.
+void
+loadsyms(struct symtab *tab, char *file)
+{
+  int fd, n, i, j, gap;
+  struct stat st;
+  char *text, *p, *q;
+  struct sym s;
+
+  tab->n = 0;
+  if((fd = open(file, O_RDONLY)) < 0)
+    return;
+  if(fstat(fd, &st) < 0 || (text = malloc(st.size + 1)) == 0){
+    close(fd);
+    return;
+  }
+  for(n = 0; n < st.size; n += i)
+    if((i = read(fd, text + n, st.size - n)) <= 0)
+      break;
+  close(fd);
+  text[n] = 0;
+
+  for(i = 0, p = text; *p; p++)
+    if(*p == '\n')
+      i++;
+  if((tab->syms = malloc((i + 1) * sizeof(struct sym))) == 0)
+    return;
+
+  for(p = text; *p; p = q){
+    for(q = p; *q && *q != '\n'; q++)
+      ;
+    if(*q)
+      *q++ = 0;
+    s.addr = 0;
+    for(; *p && *p != ' '; p++){
+      if(*p >= '0' && *p <= '9')
+        s.addr = s.addr * 16 + *p - '0';
+      else if(*p >= 'a' && *p <= 'f')
+        s.addr = s.addr * 16 + *p - 'a' + 10;
+    }
+    if(*p++ != ' ' || *p == 0 || *p == '$' || strchr(p, '.'))
+      continue;  // section, file, or local label
+    s.name = p;
+    s.count = 0;
+    tab->syms[tab->n++] = s;
+  }
+
+  // shell sort by address.
+  for(gap = tab->n / 2; gap > 0; gap /= 2){
+    for(i = gap; i < tab->n; i++){
+      s = tab->syms[i];
+      for(j = i; j >= gap && tab->syms[j - gap].addr > s.addr; j -= gap)
+        tab->syms[j] = tab->syms[j - gap];
+      tab->syms[j] = s;
+    }
+  }
+}
+
+// the last symbol at or below pc, or 0.
+struct sym*
+lookup(struct symtab *tab, uint64 pc)
+{
+  int lo = 0, hi = tab->n - 1, mid;
+
+  if(tab->n == 0 || pc < tab->syms[0].addr)
+    return 0;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(tab->syms[mid].addr <= pc)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return &tab->syms[lo];
+}
+
+void
+count(struct prof_sample *s)
+{
+  struct sym *sym;
+  int i;
+
+  if(s->user == PROF_LOST){
+    nlost += s->pc;
+    return;
+  }
+  total++;
+  if(s->pid == 0){
+    nidle++;
+    return;
+  }
+  if(!s->user){
+    nkernel++;
+    sym = lookup(&ktab, s->pc);
+  } else {
+    nuser++;
+    if(strcmp(s->name, cmd) == 0){
+      sym = lookup(&utab, s->pc);
+    } else {
+      for(i = 0; i < nother; i++)
+        if(strcmp(other[i].name, s->name) == 0)
+          break;
+      if(i == nother && nother < NOTHER){
+        other[i].name = malloc(sizeof(s->name));
+        strcpy(other[i].name, s->name);
+        other[nother++].count = 0;
+      }
+      sym = i < nother ? &other[i] : 0;
+    }
+  }
+  if(sym)
+    sym->count++;
+  else
+    nunknown++;
+}
+
+void
+pct(int n)
+{
+  int t = total ? n * 1000 / total : 0;
+
+  printf("%d.%d%%", t / 10, t % 10);
+}
+
+// print the NTOP busiest functions, most samples first.
+void
+report(void)
+{
+  struct sym *best, *s;
+  char *prefix;
+  int i, k;
+
+  printf("prof: %s: %d samples", cmd, total);
+  if(nlost)
+    printf(" (%d lost)", nlost);
+  printf(": user ");
+  pct(nuser);
+  printf(", kernel ");
+  pct(nkernel);
+  printf(", idle ");
+  pct(nidle);
+  printf("\n");
+
+  printf("  %%     samples  function\n");
+  for(k = 0; k < NTOP; k++){
+    best = 0;
+    prefix = "";
+    for(i = 0; i < ktab.n; i++)
+      if(ktab.syms[i].count > 0 && (best == 0 || ktab.syms[i].count > best->count))
+        best = &ktab.syms[i], prefix = ktab.prefix;
+    for(i = 0; i < utab.n; i++)
+      if(utab.syms[i].count > 0 && (best == 0 || utab.syms[i].count > best->count))
+        best = &utab.syms[i], prefix = utab.prefix;
+    for(i = 0; i < nother; i++)
+      if(other[i].count > 0 && (best == 0 || other[i].count > best->count))
+        best = &other[i], prefix = "user:";
+    if(best == 0)
+      break;
+    s = best;
+    printf("  ");
+    pct(s->count);
+    printf("\t%d\t %s%s\n", s->count, prefix, s->name);
+    s->count = -s->count;  // printed
+  }
+  if(nunknown){
+    printf("  ");
+    pct(nunknown);
+    printf("\t%d\t [no symbol]\n", nunknown);
+  }
+}
+
+// Drain the rings until profiling is turned off, then report.
+void
+collect(void)
+{
+  char symfile[32];
+  int n, i;
+
+  loadsyms(&ktab, "kernel.sym");
+  if(ktab.n == 0)
+    fprintf(2, "prof: no kernel.sym, kernel pcs not symbolized\n");
+  if(strlen(cmd) + 5 > sizeof(symfile)){
+    utab.n = 0;
+  } else {
+    strcpy(symfile, cmd);
+    strcpy(symfile + strlen(cmd), ".sym");
+    utab.prefix = malloc(strlen(cmd) + 2);
+    strcpy(utab.prefix, cmd);
+    strcpy(utab.prefix + strlen(cmd), ":");
+    loadsyms(&utab, symfile);
+  }
+
+  for(;;){
+    n = profread(buf, NBATCH);
+    if(n < 0){
+      fprintf(2, "prof: profread failed\n");
+      exit(1);
+    }
+    for(i = 0; i < n; i++)
+      count(&buf[i]);
+    if(n == 0){
+      if(profctl(-1) == 0)
+        break;
+      usleep(10000);
+    }
+  }
+  // what was recorded before profiling stopped.
+  while((n = profread(buf, NBATCH)) > 0)
+    for(i = 0; i < n; i++)
+      count(&buf[i]);
+
+  report();
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, collector, w;
+  char *p;
+
+  if(argc < 2){
+    fprintf(2, "usage: prof cmd [arg ...]\n");
+    exit(1);
+  }
+  // processes are named after the last path element.
+  for(cmd = p = argv[1]; *p; p++)
+    if(*p == '/')
+      cmd = p + 1;
+
+  // start from empty rings.
+  profctl(0);
+  while(profread(buf, NBATCH) > 0)
+    ;
+  profctl(1);
+
+  if((collector = fork()) < 0){
+    fprintf(2, "prof: fork failed\n");
+    profctl(0);
+    exit(1);
+  }
+  if(collector == 0)
+    collect();
+
+  if((pid = fork()) < 0){
+    fprintf(2, "prof: fork failed\n");
+    profctl(0);
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+
+  while((w = wait(0)) >= 0 && w != pid)
+    ;
+  profctl(0);
+  wait(0);
+  exit(0);
+}
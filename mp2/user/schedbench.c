@@ -0,0 +1,95 @@
+// Scheduler benchmark.
+//
+// Runs nspin CPU-bound and nsleep sleeping processes for the given
+// number of ticks and reports context switches per second and
+// RUNNABLE-to-RUNNING latency from the per-cpu schedstat() counters.
+// Run it under "make qemu CPUS=n" for each n to compare.
+//
+//   schedbench [nspin [nsleep [ticks]]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+#define TIMEBASE 10000000 // r_time() ticks per second on qemu virt
+#define HZ       10       // timer interrupts per second
+
+static struct schedstat before[NCPU], after[NCPU];
+
+void
+spinner(int end)
+{
+  volatile int x = 0;
+  int i;
+
+  while(uptime() < end)
+    for(i = 0; i < 100000; i++)
+      x++;
+  exit(0);
+}
+
+void
+sleeper(int end)
+{
+  while(uptime() < end)
+    sleep(1);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nspin = 8, nsleep = 16, ticks = 50;
+  int i, n, ncpu, end, t0, t;
+  uint64 nswitch = 0, nsteal = 0, latency = 0, maxlatency = 0;
+
+  if(argc > 1)
+    nspin = atoi(argv[1]);
+  if(argc > 2)
+    nsleep = atoi(argv[2]);
+  if(argc > 3)
+    ticks = atoi(argv[3]);
+
+  schedstat(before, NCPU);
+  t0 = uptime();
+  end = t0 + ticks;
+  for(i = 0; i < nspin + nsleep; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "schedbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      if(i < nspin)
+        spinner(end);
+      else
+        sleeper(end);
+    }
+  }
+  for(i = 0; i < nspin + nsleep; i++)
+    wait(0);
+  t = uptime() - t0;
+  n = schedstat(after, NCPU);
+
+  ncpu = 0;
+  for(i = 0; i < n; i++){
+    if(!after[i].started)
+      continue;
+    ncpu++;
+    nswitch += after[i].nswitch - before[i].nswitch;
+    nsteal += after[i].nsteal - before[i].nsteal;
+    latency += after[i].latency - before[i].latency;
+    if(after[i].maxlatency > maxlatency)
+      maxlatency = after[i].maxlatency;
+  }
+
+  printf("schedbench: %d cpus, %d spinning, %d sleeping, %d ticks\n",
+         ncpu, nspin, nsleep, t);
+  printf("  %lu switches (%lu/sec), %lu stolen\n",
+         nswitch, t > 0 ? nswitch * HZ / t : 0, nsteal);
+  printf("  latency: mean %lu us, max %lu us\n",
+         nswitch > 0 ? latency / nswitch / (TIMEBASE / 1000000) : 0,
+         maxlatency / (TIMEBASE / 1000000));
+  exit(0);
+}
@@ -0,0 +1,188 @@
+// System call batching benchmark.
+//
+// Creates a directory of small files and stats every one of them,
+// first with stat() (open, fstat and close: three traps per file),
+// then by queueing the same three calls per file in a batch_ring
+// and running a ring's worth at a time with one batch() trap.
+// Reports the mean time per file and per round for each.
+//
+//   statbench [files [rounds]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/batch.h"
+#include "user/user.h"
+
+#define DIR "statbench.d"
+#define PER_FILE 3 // open, fstat, close
+
+static struct batch_ring ring;
+static char (*names)[32];
+static struct stat *sts;
+
+void
+mkname(char *buf, int i)
+{
+  char *p;
+
+  strcpy(buf, DIR "/f");
+  p = buf + strlen(buf);
+  p[0] = '0' + i / 100 % 10;
+  p[1] = '0' + i / 10 % 10;
+  p[2] = '0' + i % 10;
+  p[3] = 0;
+}
+
+void
+setup(int nfiles)
+{
+  int i, fd;
+
+  names = malloc(nfiles * sizeof(*names));
+  sts = malloc(nfiles * sizeof(*sts));
+  if(names == 0 || sts == 0){
+    fprintf(2, "statbench: out of memory\n");
+    exit(1);
+  }
+  mkdir(DIR);
+  for(i = 0; i < nfiles; i++){
+    mkname(names[i], i);
+    if((fd = open(names[i], O_CREATE | O_WRONLY)) < 0){
+      fprintf(2, "statbench: create %s failed\n", names[i]);
+      exit(1);
+    }
+    write(fd, names[i], i % 32);
+    close(fd);
+  }
+}
+
+void
+cleanup(int nfiles)
+{
+  int i;
+
+  for(i = 0; i < nfiles; i++)
+    unlink(names[i]);
+  unlink(DIR);
+}
+
+// queue one system call; returns its queue position.
+uint
+queue(int num, int flags, uint64 a0, uint64 a1, uint64 user_data)
+{
+  struct batch_sqe *e = &ring.sq[ring.sq_tail & (BATCH_ENTRIES - 1)];
+
+  e->num = num;
+  e->flags = flags;
+  e->args[0] = a0;
+  e->args[1] = a1;
+  e->user_data = user_data;
+  return ring.sq_tail++;
+}
+
+// run what is queued and check the results.
+void
+submit(void)
+{
+  struct batch_cqe *c;
+
+  if(batch(&ring) < 0){
+    fprintf(2, "statbench: batch failed\n");
+    exit(1);
+  }
+  for(; ring.cq_head != ring.cq_tail; ring.cq_head++){
+    c = &ring.cq[ring.cq_head & (BATCH_ENTRIES - 1)];
+    if((int)c->result < 0){
+      fprintf(2, "statbench: batched call on %s failed\n", names[c->user_data]);
+      exit(1);
+    }
+  }
+  if(ring.sq_head != ring.sq_tail){
+    fprintf(2, "statbench: batch left calls queued\n");
+    exit(1);
+  }
+}
+
+void
+single(int nfiles)
+{
+  int i;
+
+  for(i = 0; i < nfiles; i++){
+    if(stat(names[i], &sts[i]) < 0){
+      fprintf(2, "statbench: stat %s failed\n", names[i]);
+      exit(1);
+    }
+  }
+}
+
+void
+batched(int nfiles)
+{
+  int i;
+  uint openpos;
+
+  for(i = 0; i < nfiles; i++){
+    if(ring.sq_tail - ring.sq_head + PER_FILE > BATCH_ENTRIES)
+      submit();
+    // fstat and close the descriptor the open returns.
+    openpos = queue(SYS_open, 0, (uint64)names[i], O_RDONLY, i);
+    queue(SYS_fstat, BATCH_ARGREF(0), openpos, (uint64)&sts[i], i);
+    queue(SYS_close, BATCH_ARGREF(0), openpos, 0, i);
+  }
+  submit();
+}
+
+void
+check(int nfiles)
+{
+  int i;
+
+  for(i = 0; i < nfiles; i++){
+    if(sts[i].type != T_FILE || sts[i].size != i % 32){
+      fprintf(2, "statbench: bad stat of %s\n", names[i]);
+      exit(1);
+    }
+    sts[i].type = 0;
+  }
+}
+
+void
+run(char *what, void (*fn)(int), int nfiles, int rounds, int traps)
+{
+  int r;
+  uint64 t0, t;
+
+  t0 = uptimeus();
+  for(r = 0; r < rounds; r++){
+    fn(nfiles);
+    check(nfiles);
+  }
+  t = uptimeus() - t0;
+  printf("%s: %d traps/round, %lu us/round, %lu ns/file\n", what, traps,
+         t / rounds, t * 1000 / ((uint64)rounds * nfiles));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nfiles = 100, rounds = 20, per;
+
+  if(argc > 1)
+    nfiles = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(nfiles < 1 || nfiles > 999)
+    nfiles = 100;
+  if(rounds < 1)
+    rounds = 1;
+
+  setup(nfiles);
+  per = BATCH_ENTRIES / PER_FILE;
+  run("stat  ", single, nfiles, rounds, nfiles * PER_FILE);
+  run("batch ", batched, nfiles, rounds, (nfiles + per - 1) / per);
+  cleanup(nfiles);
+  exit(0);
+}
@@ -0,0 +1,104 @@
+// Timer benchmark.
+//
+// accuracy: sleeps with usleep() for a range of durations, from
+//           well under a tick to several ticks, and reports how
+//           long each sleep really took, measured with uptimeus().
+// idle:     sleeps for the given number of ticks with nothing else
+//           running and reports how often the idle cpus were woken
+//           and how late the kernel fired its timers, from the
+//           schedstat() counters.
+//
+//   timerbench [rounds [ticks]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+#define TIMEBASE 10000000 // r_time() ticks per second on qemu virt
+#define HZ       10       // ticks per second
+
+static int durations[] = { 20, 50, 100, 200, 500, 1000, 2000, 5000,
+                           10000, 50000, 100000, 250000 };
+
+static struct schedstat before[NCPU], after[NCPU];
+
+void
+accuracy(int rounds)
+{
+  int i, j, d;
+  uint64 t0, t, total, maxlate;
+
+  printf("usleep(us)  mean us  mean late  max late\n");
+  for(i = 0; i < sizeof(durations) / sizeof(durations[0]); i++){
+    d = durations[i];
+    total = maxlate = 0;
+    for(j = 0; j < rounds; j++){
+      t0 = uptimeus();
+      if(usleep(d) < 0){
+        fprintf(2, "timerbench: usleep failed\n");
+        exit(1);
+      }
+      t = uptimeus() - t0;
+      if(t < d){
+        fprintf(2, "timerbench: usleep(%d) returned after %lu us\n", d, t);
+        exit(1);
+      }
+      total += t;
+      if(t - d > maxlate)
+        maxlate = t - d;
+    }
+    printf("%d\t    %lu\t     %lu\t%lu\n", d, total / rounds,
+           total / rounds - d, maxlate);
+  }
+}
+
+void
+idle(int ticks)
+{
+  int i, n, ncpu = 0;
+  uint64 nidle = 0, nipi = 0, ntimer = 0, late = 0, maxlate = 0;
+  uint64 t0, t;
+
+  schedstat(before, NCPU);
+  t0 = uptimeus();
+  sleep(ticks);
+  t = uptimeus() - t0;
+  n = schedstat(after, NCPU);
+
+  for(i = 0; i < n; i++){
+    if(!after[i].started)
+      continue;
+    ncpu++;
+    nidle += after[i].nidle - before[i].nidle;
+    nipi += after[i].nipi - before[i].nipi;
+    ntimer += after[i].ntimer - before[i].ntimer;
+    late += after[i].timerlate - before[i].timerlate;
+    if(after[i].maxtimerlate > maxlate)
+      maxlate = after[i].maxtimerlate;
+  }
+  if(t == 0)
+    t = 1;
+  printf("idle: %d cpus, %lu us: %lu idle wakeups (%lu/sec), %lu ipis\n",
+         ncpu, t, nidle, nidle * 1000000 / t, nipi);
+  printf("  %lu timers fired, mean %lu us late, max %lu us late\n",
+         ntimer, ntimer ? late / ntimer / (TIMEBASE / 1000000) : 0,
+         maxlate / (TIMEBASE / 1000000));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 10, ticks = 2 * HZ;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(argc > 2)
+    ticks = atoi(argv[2]);
+  if(rounds < 1)
+    rounds = 1;
+
+  accuracy(rounds);
+  idle(ticks);
+  exit(0);
+}
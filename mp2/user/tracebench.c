@@ -0,0 +1,98 @@
+// Measure slab alloc/free throughput (one open/close pair allocates
+// and frees one struct file) with tracing off, with the binary trace
+// ring on, and with printf debug output on. Reading the ring back,
+// which keeps it from overflowing, is timed apart from recording.
+//
+//   tracebench [iterations]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define NBATCH 64
+
+static struct trace_event buf[NBATCH];
+
+// drop whatever the rings hold so each run starts empty.
+void
+drain(void)
+{
+  while(traceread(buf, NBATCH) > 0)
+    ;
+}
+
+// returns the ticks spent in the open/close pairs; *drained is set
+// to the ticks spent reading the rings back in between.
+int
+run(int iters, int *drained)
+{
+  int i, fd, t0, t1;
+
+  *drained = 0;
+  t0 = uptime();
+  for(i = 0; i < iters; i++){
+    if((fd = open("console", O_RDONLY)) < 0){
+      fprintf(2, "tracebench: open failed\n");
+      exit(1);
+    }
+    close(fd);
+    // keep the ring from overflowing so every event is recorded,
+    // with the clock paused.
+    if((i & 31) == 31){
+      t1 = uptime();
+      drain();
+      *drained += uptime() - t1;
+    }
+  }
+  return uptime() - t0 - *drained;
+}
+
+void
+report(char *mode, int iters, int t)
+{
+  printf("tracebench: %s: %d alloc/free pairs in %d ticks", mode, iters, t);
+  if(t > 0)
+    printf(" (%d pairs/tick)", iters / t);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int iters = 2000;
+  int debug, tracing, t_off, t_ring, t_printf, d_off, d_ring, d_printf;
+
+  if(argc > 1)
+    iters = atoi(argv[1]);
+
+  // debugswitch() reports the mode it switched to; start with
+  // debug output off and remember whether it was on.
+  debug = !debugswitch();
+  if(!debug)
+    debugswitch();
+  tracing = tracectl(0);
+
+  t_off = run(iters, &d_off);
+
+  tracectl(1);
+  drain();
+  t_ring = run(iters, &d_ring);
+  tracectl(0);
+  drain();
+
+  debugswitch();
+  t_printf = run(iters, &d_printf);
+  debugswitch();
+
+  report("tracing off", iters, t_off);
+  report("trace ring", iters, t_ring);
+  report("printf debug", iters, t_printf);
+  printf("tracebench: reading the ring back took %d ticks (%d with tracing off, %d with printf)\n",
+         d_ring, d_off, d_printf);
+
+  if(debug)
+    debugswitch();
+  tracectl(tracing);
+  exit(0);
+}
@@ -0,0 +1,90 @@
+// Drain the kernel trace rings and pretty-print the events.
+//
+//   tracedump on       start recording
+//   tracedump off      stop recording
+//   tracedump          print (and consume) everything recorded so far
+//   tracedump cmd ...  record while running cmd, then print
+
+#include "kernel/types.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define NBATCH 64
+
+static char *names[] = {
+[TRACE_NONE]         "none",
+[TRACE_SLAB_CREATE]  "slab_create",
+[TRACE_SLAB_ALLOC]   "slab_alloc",
+[TRACE_SLAB_FREE]    "slab_free",
+[TRACE_SLAB_GROW]    "slab_grow",
+[TRACE_SLAB_SHRINK]  "slab_shrink",
+[TRACE_BIO_HIT]      "bio_hit",
+[TRACE_BIO_MISS]     "bio_miss",
+[TRACE_BIO_WRITE]    "bio_write",
+[TRACE_LOG_BEGIN]    "log_begin",
+[TRACE_LOG_COMMIT]   "log_commit",
+[TRACE_SCHED_SWITCH] "sched_switch",
+[TRACE_LOST]         "LOST",
+};
+
+static struct trace_event buf[NBATCH];
+
+void
+dump(void)
+{
+  int n, i, total = 0;
+  uint64 t0 = 0;
+  char *name;
+
+  while((n = traceread(buf, NBATCH)) > 0){
+    for(i = 0; i < n; i++){
+      struct trace_event *e = &buf[i];
+      if(total == 0 && i == 0)
+        t0 = e->ts;
+      if(e->type < TRACE_NTYPES && names[e->type])
+        name = names[e->type];
+      else
+        name = "???";
+      printf("%lu cpu%d pid %d %s 0x%lx 0x%lx\n",
+             e->ts - t0, e->cpu, e->pid, name, e->arg0, e->arg1);
+    }
+    total += n;
+  }
+  if(n < 0){
+    fprintf(2, "tracedump: traceread failed\n");
+    exit(1);
+  }
+  printf("%d events\n", total);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc == 2 && strcmp(argv[1], "on") == 0){
+    tracectl(1);
+    exit(0);
+  }
+  if(argc == 2 && strcmp(argv[1], "off") == 0){
+    tracectl(0);
+    exit(0);
+  }
+  if(argc >= 2){
+    tracectl(1);
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "tracedump: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "tracedump: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+    tracectl(0);
+  }
+  dump();
+  exit(0);
+}
@@ -49,6 +49,8 @@ morecore(uint nu)
   char *p;
   Header *hp;
 
+  // the kernel allocates heap pages only when they are touched,
+  // so over-asking costs address space, not memory.
   if(nu < 4096)
     nu = 4096;
   p = sbrk(nu * sizeof(Header));
@@ -24,6 +24,20 @@ int sleep(int);
 int uptime(void);
 int debugswitch(void);
 int printfslab(void);
+int tracectl(int);
+int traceread(void*, int);
+int lockstat(void*, int);
+int schedstat(void*, int);
+int pipe2(int*, int, int);
+int memstat(int, void*);
+void *mmap(void*, uint64, int, int, int, int);
+int munmap(void*, uint64);
+int megapages(int);
+int usleep(int);
+uint64 uptimeus(void);
+int profctl(int);
+int profread(void*, int);
+int batch(void*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -38,3 +38,17 @@ entry("sleep");
 entry("uptime");
 entry("debugswitch");
 entry("printfslab");
+entry("tracectl");
+entry("traceread");
+entry("lockstat");
+entry("schedstat");
+entry("pipe2");
+entry("memstat");
+entry("mmap");
+entry("munmap");
+entry("megapages");
+entry("usleep");
+entry("uptimeus");
+entry("profctl");
+entry("profread");
+entry("batch");
@@ -0,0 +1,101 @@
+// sleep()/wakeup() benchmark.
+//
+// Times a one-byte pipe ping-pong between two processes, first
+// alone and then with nsleep extra processes blocked on their own
+// pipes, and reports round trips per tick and the average cost of
+// a wakeup() call from the schedstat() counters.
+//
+//   wakebench [rounds [nsleep]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+static struct schedstat before[NCPU], after[NCPU];
+
+void
+pingpong(int rounds, int nsleep)
+{
+  int ping[2], pong[2], hold[2];
+  int i, n, pid, t0, t;
+  uint64 nwakeup = 0, wakeuptime = 0;
+  char c = 0;
+
+  // sleepers all block reading one pipe that nobody writes
+  // until the end; each sits on the pipe's read chan.
+  if(pipe(hold) < 0){
+    fprintf(2, "wakebench: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < nsleep; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "wakebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(hold[1]);
+      read(hold[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(hold[0]);
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    fprintf(2, "wakebench: pipe failed\n");
+    exit(1);
+  }
+  if((pid = fork()) < 0){
+    fprintf(2, "wakebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < rounds; i++){
+      read(ping[0], &c, 1);
+      write(pong[1], &c, 1);
+    }
+    exit(0);
+  }
+
+  schedstat(before, NCPU);
+  t0 = uptime();
+  for(i = 0; i < rounds; i++){
+    write(ping[1], &c, 1);
+    read(pong[0], &c, 1);
+  }
+  t = uptime() - t0;
+  n = schedstat(after, NCPU);
+  wait(0);
+
+  close(ping[0]); close(ping[1]);
+  close(pong[0]); close(pong[1]);
+  // closing the last write end wakes every sleeper.
+  close(hold[1]);
+  for(i = 0; i < nsleep; i++)
+    wait(0);
+
+  for(i = 0; i < n; i++){
+    nwakeup += after[i].nwakeup - before[i].nwakeup;
+    wakeuptime += after[i].wakeuptime - before[i].wakeuptime;
+  }
+  printf("wakebench: %d sleepers: %d round trips in %d ticks", nsleep, rounds, t);
+  if(t > 0)
+    printf(" (%d/tick)", rounds / t);
+  printf(", %lu wakeups, %lu r_time ticks/wakeup\n",
+         nwakeup, nwakeup ? wakeuptime / nwakeup : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 2000, nsleep = NPROC - 8;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(argc > 2)
+    nsleep = atoi(argv[2]);
+
+  pingpong(rounds, 0);
+  pingpong(rounds, nsleep);
+  exit(0);
+}
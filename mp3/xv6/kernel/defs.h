@@ -85,10 +85,16 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             clone(uint64, uint64, uint64);
+int             sched_setattr(int, int, int, int);
+int             sched_yield(void);
+void            rt_tick(void);
+int             setshare(int, int);
 int             growproc(int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
+void            proc_putpagetable(struct proc *, pagetable_t, uint64, uint64);
 int             kill(int);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
@@ -172,6 +178,10 @@ int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 
+// thrd.c
+void            upcall_tick(struct proc*);
+int             upcall_deliver(struct proc*);
+
 // plic.c
 void            plicinit(void);
 void            plicinithart(void);
@@ -19,6 +19,7 @@ exec(char *path, char **argv)
   struct inode *ip;
   struct proghdr ph;
   pagetable_t pagetable = 0, oldpagetable;
+  uint64 oldtfva;
   struct proc *p = myproc();
 
   begin_op();
@@ -108,13 +109,19 @@ exec(char *path, char **argv)
       last = s+1;
   safestrcpy(p->name, last, sizeof(p->name));
     
+  // for mp3: the old image's upcall goes with it.
+  p->upcall = 0;
+  p->upcall_pending = 0;
+
   // Commit to the user image.
   oldpagetable = p->pagetable;
+  oldtfva = p->tfva;
   p->pagetable = pagetable;
+  p->tfva = TRAPFRAME;
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
-  proc_freepagetable(oldpagetable, oldsz);
+  proc_putpagetable(p, oldpagetable, oldsz, oldtfva);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
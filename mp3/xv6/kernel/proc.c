@@ -15,6 +15,21 @@ struct proc *initproc;
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// for mp3: processes made by clone() share their creator's page
+// table. vmshare_lock must be held to change which processes share
+// one, or its size; take it after p->lock, never before.
+struct spinlock vmshare_lock;
+
+// for mp3: guards the EDF class reservations, see sched_setattr().
+struct spinlock rtlock;
+
+// for mp3: guards the processes' shares, see setshare().
+struct spinlock sharelock;
+#define STRIDE1 (1 << 20)
+#define MAXSHARE 10000
+#define DEFAULT_SHARE 100
+static uint64 share_vtime; // pass of the process picked last
+
 extern void forkret(void);
 static void wakeup1(struct proc *chan);
 static void freeproc(struct proc *p);
@@ -45,6 +60,9 @@ procinit(void)
   struct proc *p;
   
   initlock(&pid_lock, "nextpid");
+  initlock(&vmshare_lock, "vmshare");
+  initlock(&rtlock, "rt");
+  initlock(&sharelock, "share");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->kstack = KSTACK((int) (p - proc));
@@ -115,16 +133,12 @@ found:
   p->pid = allocpid();
 
   // for mp3
-  p->thrdstop_ticks = 0;
-  p->thrdstop_delay = -1;
-  p->jump_flag = 0;
-  p->resume_flag = -1;
-  p->cancel_save_flag = -1;
-  int i;
-  for (i = 0; i < MAX_THRD_NUM; i++)
-  {
-    p->thrdstop_context_used[i] = 0;
-  }
+  p->upcall = 0;
+  p->upcall_pending = 0;
+  p->tfva = TRAPFRAME;
+  p->rt_period = 0;
+  p->share = DEFAULT_SHARE;
+  p->pass = share_vtime;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -159,7 +173,7 @@ freeproc(struct proc *p)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
   if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+    proc_putpagetable(p, p->pagetable, p->sz, p->tfva);
   p->pagetable = 0;
   p->sz = 0;
   p->pid = 0;
@@ -168,6 +182,7 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->rt_period = 0;
   p->state = UNUSED;
 }
 
@@ -214,6 +229,43 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
   uvmfree(pagetable, sz);
 }
 
+// for mp3
+// how many processes other than p use pagetable.
+// vmshare_lock must be held.
+static int
+pagetable_sharers(struct proc *p, pagetable_t pagetable)
+{
+  struct proc *q;
+  int n = 0;
+
+  for(q = proc; q < &proc[NPROC]; q++)
+    if(q != p && q->pagetable == pagetable)
+      n++;
+  return n;
+}
+
+// Drop p's use of a page table whose trapframe for p is mapped
+// at tfva, freeing it and the memory it refers to once no other
+// process made by clone() still uses it. Clears p->pagetable if it
+// is that page table, before vmshare_lock is released, so sharers
+// freed at the same time on other harts do not count p.
+void
+proc_putpagetable(struct proc *p, pagetable_t pagetable, uint64 sz, uint64 tfva)
+{
+  int sharers;
+
+  acquire(&vmshare_lock);
+  uvmunmap(pagetable, tfva, 1, 0);
+  sharers = pagetable_sharers(p, pagetable);
+  if(p->pagetable == pagetable)
+    p->pagetable = 0;
+  if(sharers == 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, sz);
+  }
+  release(&vmshare_lock);
+}
+
 // a user program that calls exec("/init")
 // od -t xC initcode
 uchar initcode[] = {
@@ -259,16 +311,23 @@ growproc(int n)
 {
   uint sz;
   struct proc *p = myproc();
+  struct proc *q;
 
+  // for mp3: processes sharing the page table share its size.
+  acquire(&vmshare_lock);
   sz = p->sz;
   if(n > 0){
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+      release(&vmshare_lock);
       return -1;
     }
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  for(q = proc; q < &proc[NPROC]; q++)
+    if(q->pagetable == p->pagetable)
+      q->sz = sz;
+  release(&vmshare_lock);
   return 0;
 }
 
@@ -308,6 +367,75 @@ fork(void)
       np->ofile[i] = filedup(p->ofile[i]);
   np->cwd = idup(p->cwd);
 
+  // for mp3
+  np->share = p->share;
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
+
+  np->state = RUNNABLE;
+
+  release(&np->lock);
+
+  return pid;
+}
+
+// for mp3
+// Create a new process sharing the caller's address space, which
+// starts running fn(arg) on the given user stack. Its trapframe is
+// mapped at a free slot below TRAPFRAME; it returns from fn to
+// address 0, so fn must call exit() instead.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int i, pid, slot;
+  uint64 va;
+  struct proc *np, *q;
+  struct proc *p = myproc();
+
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+  // allocproc gave np a page table of its own; use p's instead.
+  proc_freepagetable(np->pagetable, 0);
+  np->pagetable = 0;
+
+  acquire(&vmshare_lock);
+  for(slot = 1; slot < NCLONE; slot++){
+    va = TRAPFRAME - slot * PGSIZE;
+    for(q = proc; q < &proc[NPROC]; q++)
+      if(q->pagetable == p->pagetable && q->tfva == va)
+        break;
+    if(q == &proc[NPROC])
+      break;
+  }
+  if(slot == NCLONE || va < PGROUNDUP(p->sz) ||
+     mappages(p->pagetable, va, PGSIZE,
+              (uint64)(np->trapframe), PTE_R | PTE_W) < 0){
+    release(&vmshare_lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  np->pagetable = p->pagetable;
+  np->tfva = va;
+  np->sz = p->sz;
+  release(&vmshare_lock);
+
+  np->parent = p;
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = 0;
+
+  for(i = 0; i < NOFILE; i++)
+    if(p->ofile[i])
+      np->ofile[i] = filedup(p->ofile[i]);
+  np->cwd = idup(p->cwd);
+
   safestrcpy(np->name, p->name, sizeof(p->name));
 
   pid = np->pid;
@@ -465,6 +593,232 @@ wait(uint64 addr)
   }
 }
 
+// for mp3
+// The EDF class. A process given a reservation by sched_setattr()
+// may run for rt_runtime ticks in every period of rt_period ticks,
+// and its job in each period is due rt_deadline ticks after the
+// period starts. scheduler() runs the runnable one with the earliest
+// deadline ahead of every other process. rt_tick() charges it for
+// each tick it runs and, once its budget is gone, throttles it until
+// the next period.
+
+// densities (runtime / deadline) are summed in units of 1/RT_UNIT;
+// admission keeps the sum at most RT_UNIT, one hart's worth.
+#define RT_UNIT 65536
+
+static uint64
+rt_density(int runtime, int deadline)
+{
+  return ((uint64)runtime * RT_UNIT + deadline - 1) / deadline;
+}
+
+// Give process pid (0 for the caller) the reservation, or put it
+// back in the normal class if runtime is 0. Returns -1 if there is
+// no such process or the reservations would no longer fit.
+int
+sched_setattr(int pid, int runtime, int deadline, int period)
+{
+  struct proc *p, *q;
+  uint64 total = 0;
+
+  if(runtime < 0 || (runtime > 0 && (runtime > deadline || deadline > period)))
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED && p->state != ZOMBIE)
+      break;
+    release(&p->lock);
+  }
+  if(p == &proc[NPROC])
+    return -1;
+
+  acquire(&rtlock);
+  if(runtime > 0){
+    for(q = proc; q < &proc[NPROC]; q++)
+      if(q != p && q->rt_period > 0)
+        total += rt_density(q->rt_runtime, q->rt_deadline);
+    if(total + rt_density(runtime, deadline) > RT_UNIT){
+      release(&rtlock);
+      release(&p->lock);
+      return -1;
+    }
+  }
+  p->rt_runtime = runtime;
+  p->rt_deadline = deadline;
+  p->rt_period = runtime > 0 ? period : 0;
+  p->rt_budget = runtime;
+  p->rt_throttled = 0;
+  p->rt_due = ticks + deadline;
+  p->rt_next = ticks + period;
+  release(&rtlock);
+  release(&p->lock);
+  return 0;
+}
+
+// End the caller's job for this period: give up the rest of its
+// budget and wait for the next period. Returns the deadline of the
+// job that then starts, or 0 in the normal class.
+int
+sched_yield(void)
+{
+  struct proc *p = myproc();
+
+  acquire(&rtlock);
+  if(p->rt_period > 0){
+    p->rt_budget = 0;
+    p->rt_throttled = 1;
+  }
+  release(&rtlock);
+  yield();
+
+  return p->rt_period > 0 ? p->rt_due : 0;
+}
+
+// Called by clockintr() every tick: charge the EDF class processes
+// running on each hart, and start new periods.
+void
+rt_tick(void)
+{
+  struct cpu *c;
+  struct proc *p;
+
+  acquire(&rtlock);
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    p = c->proc;
+    if(p && p->rt_period > 0 && p->rt_budget > 0 && --p->rt_budget == 0)
+      p->rt_throttled = 1;
+  }
+  for(p = proc; p < &proc[NPROC]; p++){
+    if(p->rt_period > 0 && (int)(ticks - p->rt_next) >= 0){
+      p->rt_budget = p->rt_runtime;
+      p->rt_throttled = 0;
+      p->rt_due = p->rt_next + p->rt_deadline;
+      p->rt_next += p->rt_period;
+    }
+  }
+  release(&rtlock);
+}
+
+// The runnable EDF class process with the earliest deadline that
+// has budget left, returned with its lock held, or 0 if none.
+static struct proc*
+rt_pick(void)
+{
+  struct proc *p, *best = 0;
+
+  acquire(&rtlock);
+  for(p = proc; p < &proc[NPROC]; p++){
+    if(p->rt_period > 0 && !p->rt_throttled && p->state == RUNNABLE &&
+       (best == 0 || (int)(p->rt_due - best->rt_due) < 0))
+      best = p;
+  }
+  release(&rtlock);
+
+  if(best == 0)
+    return 0;
+  acquire(&best->lock);
+  if(best->state == RUNNABLE)
+    return best;
+  release(&best->lock);
+  return 0;
+}
+
+// for mp3
+// Proportional share. Processes outside the EDF class get the
+// processor in proportion to their shares (setshare(), 100 by
+// default; fork() passes a process's share on). By default this is
+// stride scheduling: each process has a pass that advances by
+// STRIDE1 / share every time it is picked, and the lowest pass goes
+// next. Built with KSCHED=LOTTERY, each pick is instead a lottery
+// with share tickets per process.
+
+#ifdef KSCHED_LOTTERY
+static uint64 share_seed = 1;
+#endif
+
+// Set the share of process pid (0 for the caller). Returns -1 if
+// there is no such process or share is out of range.
+int
+setshare(int pid, int share)
+{
+  struct proc *p;
+
+  if(share < 1 || share > MAXSHARE)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED && p->state != ZOMBIE){
+      acquire(&sharelock);
+      p->share = share;
+      release(&sharelock);
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// The runnable process outside the EDF class that should run next
+// by share, returned with its lock held, or 0 if none.
+static struct proc*
+share_pick(void)
+{
+  struct proc *p, *best = 0;
+#ifdef KSCHED_LOTTERY
+  uint64 total = 0, draw;
+#endif
+
+  acquire(&sharelock);
+#ifdef KSCHED_LOTTERY
+  for(p = proc; p < &proc[NPROC]; p++)
+    if(p->state == RUNNABLE && p->rt_period == 0)
+      total += p->share;
+  if(total > 0){
+    share_seed = share_seed * 6364136223846793005UL + 1442695040888963407UL;
+    draw = (share_seed >> 33) % total;
+    for(p = proc; p < &proc[NPROC]; p++){
+      if(p->state != RUNNABLE || p->rt_period != 0)
+        continue;
+      if(draw < p->share){
+        best = p;
+        break;
+      }
+      draw -= p->share;
+    }
+  }
+#else
+  for(p = proc; p < &proc[NPROC]; p++)
+    if(p->state == RUNNABLE && p->rt_period == 0 &&
+       (best == 0 || p->pass < best->pass))
+      best = p;
+#endif
+  release(&sharelock);
+
+  if(best == 0)
+    return 0;
+  acquire(&best->lock);
+  if(best->state != RUNNABLE || best->rt_period != 0){
+    release(&best->lock);
+    return 0;
+  }
+  // a process back from sleeping does not get to spend the
+  // passes it missed.
+  acquire(&sharelock);
+  if(best->pass < share_vtime)
+    best->pass = share_vtime;
+  share_vtime = best->pass;
+  best->pass += STRIDE1 / best->share;
+  release(&sharelock);
+  return best;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -483,22 +837,22 @@ scheduler(void)
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
-    }
+    // for mp3: the EDF class goes ahead of every other process,
+    // which run in proportion to their shares.
+    if((p = rt_pick()) == 0 && (p = share_pick()) == 0)
+      continue;
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    p->state = RUNNING;
+    c->proc = p;
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
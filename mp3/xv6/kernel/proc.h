@@ -1,9 +1,3 @@
-
-
-// for mp3
-#define MAX_THRD_NUM 16
-
-
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -101,16 +95,24 @@ struct proc {
   int pid;                     // Process ID
 
   // for mp3
-  int thrdstop_ticks;
-  int thrdstop_delay;
-  int thrdstop_context_id;
-  uint64 thrdstop_handler_arg;
-  uint64 thrdstop_handler_pointer;
-  struct trapframe thrdstop_context[MAX_THRD_NUM];
-  int thrdstop_context_used[MAX_THRD_NUM];
-  int jump_flag;
-  int resume_flag;
-  int cancel_save_flag;
+  uint64 upcall;               // User address of struct upcall, or 0
+  int upcall_pending;          // Enter the upcall handler on return to user space
+  uint64 tfva;                 // User virtual address of the trapframe (see clone())
+
+  // for mp3: EDF class reservation (see sched_setattr());
+  // rtlock must be held when using these.
+  int rt_runtime;              // Ticks to run per period
+  int rt_deadline;             // Ticks from the start of a period to its deadline
+  int rt_period;               // Ticks per period, 0 in the normal class
+  int rt_budget;               // Ticks left to run this period
+  int rt_throttled;            // Out of budget until the next period
+  uint rt_due;                 // Deadline of this period's job
+  uint rt_next;                // Start of the next period
+
+  // for mp3: proportional share (see setshare());
+  // sharelock must be held when using these.
+  int share;                   // Share of the processor outside the EDF class
+  uint64 pass;                 // Stride scheduling's virtual time
 
 
   // these are private to the process, so p->lock need not be held.
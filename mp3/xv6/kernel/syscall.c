@@ -106,9 +106,11 @@ extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
 
 // for mp3
-extern uint64 sys_thrdstop(void);
-extern uint64 sys_thrdresume(void);
-extern uint64 sys_cancelthrdstop(void);
+extern uint64 sys_thrdupcall(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_sched_setattr(void);
+extern uint64 sys_sched_yield(void);
+extern uint64 sys_setshare(void);
 
 
 
@@ -136,9 +138,11 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 
 // for mp3
-[SYS_thrdstop]   sys_thrdstop,
-[SYS_thrdresume]   sys_thrdresume,
-[SYS_cancelthrdstop]   sys_cancelthrdstop,
+[SYS_thrdupcall]   sys_thrdupcall,
+[SYS_clone]   sys_clone,
+[SYS_sched_setattr]   sys_sched_setattr,
+[SYS_sched_yield]   sys_sched_yield,
+[SYS_setshare]   sys_setshare,
 };
 
 void
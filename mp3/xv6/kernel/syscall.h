@@ -21,6 +21,8 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 // for mp3
-#define SYS_thrdstop  22
-#define SYS_thrdresume 23
-#define SYS_cancelthrdstop 24
+#define SYS_thrdupcall 22
+#define SYS_clone  23
+#define SYS_sched_setattr 24
+#define SYS_sched_yield 25
+#define SYS_setshare 26
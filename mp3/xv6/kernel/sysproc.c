@@ -95,3 +95,37 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// for mp3
+// give a process an EDF class reservation of runtime ticks due
+// deadline ticks into each period, or 0 to take it away.
+uint64
+sys_sched_setattr(void)
+{
+  int pid, runtime, deadline, period;
+
+  if(argint(0, &pid) < 0 || argint(1, &runtime) < 0 ||
+     argint(2, &deadline) < 0 || argint(3, &period) < 0)
+    return -1;
+  return sched_setattr(pid, runtime, deadline, period);
+}
+
+// for mp3
+// end this period's job and wait for the next period.
+uint64
+sys_sched_yield(void)
+{
+  return sched_yield();
+}
+
+// for mp3
+// set a process's share of the processor.
+uint64
+sys_setshare(void)
+{
+  int pid, share;
+
+  if(argint(0, &pid) < 0 || argint(1, &share) < 0)
+    return -1;
+  return setshare(pid, share);
+}
@@ -6,98 +6,81 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "upcall.h"
 
 // for mp3
+// register the process's struct upcall, or unregister it with 0.
 uint64
-sys_thrdstop(void)
+sys_thrdupcall(void)
 {
-  int delay, context_id;
-  uint64 context_id_ptr;
-  uint64 handler, handler_arg;
-  if (argint(0, &delay) < 0)
-    return -1;
-  if (argaddr(1, &context_id_ptr) < 0)
-    return -1;
-  if (argaddr(2, &handler) < 0)
-    return -1;
-  if (argaddr(3, &handler_arg) < 0)
-    return -1;
+  uint64 addr;
+  struct upcall u;
+  struct proc *p = myproc();
 
-  struct proc *proc = myproc();
-  if (copyin(proc->pagetable, (char *)&context_id, context_id_ptr, sizeof(int)) == -1) {
+  if (argaddr(0, &addr) < 0)
     return -1;
-  }
-
-  if (context_id < 0) {
-    for (int i = 0; i < MAX_THRD_NUM; i++) {
-      if (proc->thrdstop_context_used[i] == 0) {
-        proc->thrdstop_context_used[i] = 1;
-        context_id = i;
-        break;
-      }
-    }
-
-    if (context_id < 0) {
-      return -1;
-    }
-  }
-
-  if (copyout(proc->pagetable, context_id_ptr, (char *)&context_id, sizeof(int)) == -1) {
+  if (addr != 0 && copyin(p->pagetable, (char *)&u, addr, sizeof(u)) < 0)
     return -1;
-  }
-
-  proc->thrdstop_context_id = context_id;
-  proc->thrdstop_delay = delay;
-  proc->thrdstop_handler_pointer = handler;
-  proc->thrdstop_ticks = 0;
-  proc->thrdstop_handler_arg = handler_arg;
 
+  p->upcall = addr;
+  p->upcall_pending = 0;
   return 0;
 }
 
 // for mp3
+// start a process sharing this one's memory at fn(arg) on stack.
 uint64
-sys_cancelthrdstop(void)
+sys_clone(void)
 {
-  int context_id, is_exit;
-  if (argint(0, &context_id) < 0)
-    return -1;
-  if (argint(1, &is_exit) < 0)
-    return -1;
+  uint64 fn, arg, stack;
 
-  if (context_id < 0 || context_id >= MAX_THRD_NUM) {
+  if (argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
     return -1;
-  }
+  if (stack % 16 != 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
 
-  struct proc *proc = myproc();
+// for mp3
+// count a timer tick the process ran for against its upcall.
+// called from usertrap() and kerneltrap() with interrupts off.
+void
+upcall_tick(struct proc *p)
+{
+  int t[2]; // delay, elapsed
 
-  // cancel previous thrdstop
-  int consume_tick = proc->thrdstop_ticks;
-  proc->thrdstop_delay = -1;
+  if (p->upcall == 0 || p->upcall_pending)
+    return;
+  if (copyin(p->pagetable, (char *)t, p->upcall, sizeof(t)) < 0 || t[0] <= 0)
+    return;
 
-  if (is_exit == 0) {
-    proc->cancel_save_flag = context_id;
-  } else if (context_id >= 0 && context_id < MAX_THRD_NUM) {
-    proc->thrdstop_context_used[context_id] = 0;
+  t[1]++;
+  if (t[1] >= t[0]) {
+    t[0] = 0;
+    p->upcall_pending = 1;
   }
-
-  return consume_tick;
+  copyout(p->pagetable, p->upcall, (char *)t, sizeof(t));
 }
 
 // for mp3
-uint64
-sys_thrdresume(void)
+// save the interrupted registers in the upcall's context area
+// and return to user space in its handler instead.
+int
+upcall_deliver(struct proc *p)
 {
-  int context_id;
-  if (argint(0, &context_id) < 0)
-    return -1;
+  struct upcall u;
+  struct uctx ctx;
 
-  struct proc *proc = myproc();
-
-  if (context_id < 0 || context_id >= MAX_THRD_NUM)
+  p->upcall_pending = 0;
+  if (copyin(p->pagetable, (char *)&u, p->upcall, sizeof(u)) < 0)
     return -1;
 
-  proc->resume_flag = context_id;
+  memmove(&ctx, &p->trapframe->ra, sizeof(ctx) - sizeof(ctx.pc));
+  ctx.pc = p->trapframe->epc;
+  if (copyout(p->pagetable, u.ctx, (char *)&ctx, sizeof(ctx)) < 0)
+    return -1;
 
+  p->trapframe->epc = u.handler;
+  p->trapframe->a0 = u.arg;
   return 0;
 }
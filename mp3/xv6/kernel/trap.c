@@ -79,15 +79,15 @@ usertrap(void)
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2){
     // for mp3
-    if(p->thrdstop_delay > 0){
-      p->thrdstop_ticks++;
-      if(p->thrdstop_ticks >= p->thrdstop_delay){
-        p->thrdstop_delay = -1;
-        p->jump_flag = 1;
-      }
-    }
+    upcall_tick(p);
     yield();
   }
+
+  // for mp3
+  if(p->upcall_pending && upcall_deliver(p) < 0){
+    printf("usertrap(): bad upcall pid=%d\n", p->pid);
+    exit(-1);
+  }
   usertrapret();
 }
 
@@ -107,29 +107,6 @@ usertrapret(void)
   // send syscalls, interrupts, and exceptions to trampoline.S
   w_stvec(TRAMPOLINE + (uservec - trampoline));
 
-  if(p->resume_flag != -1){ // handle thrdresume
-    // restore user context
-    struct trapframe *now_thrd_context = &(p->thrdstop_context[p->resume_flag]);
-    memmove(p->trapframe, now_thrd_context, sizeof(struct trapframe));
-    // clear falg
-    p->resume_flag = -1;
-  }else if(p->jump_flag == 1){ // handle thrdstop
-    // save user context
-    struct trapframe *now_thrd_context = &(p->thrdstop_context[p->thrdstop_context_id]);
-    memmove(now_thrd_context, p->trapframe, sizeof(struct trapframe));
-    // clear flag
-    p->jump_flag = 0;
-    // set pc to handler function
-    p->trapframe->epc = p->thrdstop_handler_pointer;
-    p->trapframe->a0 = p->thrdstop_handler_arg;
-  }else if(p->cancel_save_flag != -1){ // handle cancelthrdstop
-    // save user context
-    struct trapframe *now_thrd_context = &(p->thrdstop_context[p->cancel_save_flag]);
-    memmove(now_thrd_context, p->trapframe, sizeof(struct trapframe));
-    // clear flag
-    p->cancel_save_flag = -1;
-  }
-
   // set up trapframe values that uservec will need when
   // the process next re-enters the kernel.
   p->trapframe->kernel_satp = r_satp();         // kernel page table
@@ -158,7 +135,7 @@ usertrapret(void)
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
   
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  ((void (*)(uint64,uint64))fn)(p->tfva, satp);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -185,15 +162,7 @@ kerneltrap()
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING){
     // for mp3
-    struct proc *p = myproc();
-
-    if(p->thrdstop_delay > 0){
-      p->thrdstop_ticks++;
-      if(p->thrdstop_ticks >= p->thrdstop_delay){
-        p->jump_flag = 1;
-        p->thrdstop_delay = -1;
-      }
-    }
+    upcall_tick(myproc());
     yield();
   }
 
@@ -211,6 +180,9 @@ clockintr()
   ticks++;
   wakeup(&ticks);
   release(&tickslock);
+
+  // for mp3
+  rt_tick();
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -0,0 +1,53 @@
+// Timer upcalls for user-level threads (for mp3).
+//
+// A process registers one struct upcall with thrdupcall(). Writing
+// a positive delay arms it: once the process has run for that many
+// timer ticks, the kernel saves the interrupted registers in *ctx,
+// clears delay, and enters handler(arg) on the interrupted stack.
+// Writing 0 to delay disarms it; elapsed counts the ticks since it
+// was last armed. Arming, disarming and switching between saved
+// contexts need no system call.
+
+// User registers, in trapframe order, and the pc to resume at.
+struct uctx {
+  uint64 ra;
+  uint64 sp;
+  uint64 gp;
+  uint64 tp;
+  uint64 t0;
+  uint64 t1;
+  uint64 t2;
+  uint64 s0;
+  uint64 s1;
+  uint64 a0;
+  uint64 a1;
+  uint64 a2;
+  uint64 a3;
+  uint64 a4;
+  uint64 a5;
+  uint64 a6;
+  uint64 a7;
+  uint64 s2;
+  uint64 s3;
+  uint64 s4;
+  uint64 s5;
+  uint64 s6;
+  uint64 s7;
+  uint64 s8;
+  uint64 s9;
+  uint64 s10;
+  uint64 s11;
+  uint64 t3;
+  uint64 t4;
+  uint64 t5;
+  uint64 t6;
+  uint64 pc;
+};
+
+struct upcall {
+  int delay;       // ticks until the upcall, 0 if disarmed
+  int elapsed;     // ticks run since armed; set to 0 before arming
+  uint64 ctx;      // struct uctx * the interrupted registers go to
+  uint64 handler;  // void (*)(void *), must not return
+  uint64 arg;      // passed to handler
+};
@@ -0,0 +1,568 @@
+// Host-side simulator of the mp3 thread library's scheduling.
+//
+// user/threads_sched.c and user/heap.c are compiled in unchanged;
+// this file stands in for user/threads.c, making the same calls into
+// the policy in the same order, but letting each thread run for its
+// allocated time in virtual ticks instead of real ones.
+//
+//   simsched [-a] [-g | -c] policy < tasks
+//
+// replays one task set and prints what threads.c would (dispatch,
+// finish, miss and sleep lines), a Gantt chart (-g) or one CSV row
+// per dispatch (-c). Each line of tasks is one thread:
+//
+//   rt burst period n arrival [priority [budget hard [weight]]]
+//
+// as passed to thread_create(), thread_add_at(), thread_set_priority(),
+// init_thread_cbs() and thread_set_weight(); a period of -1 makes a
+// one-shot thread. With -a threads are added by thread_admit()
+// instead of thread_add_at().
+//
+//   simsched -w workloads [-n threads] [-s seed]
+//
+// runs every policy on the same generated workloads and compares
+// them: jobs, mean turnaround and response time, misses, and
+// decisions per second.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernel/types.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+
+#define TIME_QUANTUM 2
+#define MAX_TIME 100000000 // give up on a run after this many ticks
+#define GANTT_WIDTH 100
+
+static int __release_less(struct heap_node *a, struct heap_node *b);
+
+static LIST_HEAD(run_queue);
+static LIST_HEAD(admitted);
+static struct heap release_queue = { .less = __release_less };
+static int release_seq;
+static int next_id;
+static struct list_head *current;
+static int now;
+static int allocated_time;
+static struct threads_sched_policy *policy;
+static struct thread_stats stats;
+
+// output
+enum { LOG, GANTT, CSV, QUIET } mode = LOG;
+static int miss_exit;
+
+// dispatches, for the Gantt chart
+struct segment {
+    int id, start, end;
+};
+static struct segment *segments;
+static int nsegments, capsegments;
+
+static int __release_less(struct heap_node *a, struct heap_node *b)
+{
+    struct release_queue_entry *x = heap_entry(a, struct release_queue_entry, node);
+    struct release_queue_entry *y = heap_entry(b, struct release_queue_entry, node);
+
+    if (x->release_time != y->release_time)
+        return x->release_time < y->release_time;
+    return x->seq < y->seq;
+}
+
+static void *xmalloc(size_t n)
+{
+    void *p = malloc(n);
+
+    if (p == NULL) {
+        fprintf(stderr, "simsched: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void __run_queue_add(struct thread *t)
+{
+    list_add_tail(&t->thread_list, &run_queue);
+    if (policy->enqueue)
+        policy->enqueue(t);
+}
+
+static void __run_queue_del(struct thread *t)
+{
+    if (policy->dequeue)
+        policy->dequeue(t);
+    list_del(&t->thread_list);
+}
+
+void __run_queue_move_tail(struct thread *t)
+{
+    if (policy->dequeue)
+        policy->dequeue(t);
+    list_del(&t->thread_list);
+    list_add_tail(&t->thread_list, &run_queue);
+    if (policy->enqueue)
+        policy->enqueue(t);
+}
+
+// thread_create() and init_thread_cbs(), without a stack.
+static struct thread *sim_create(int is_real_time, int processing_time, int period, int n)
+{
+    struct thread *t = xmalloc(sizeof(*t));
+
+    memset(t, 0, sizeof(*t));
+    t->ID = next_id++;
+    INIT_LIST_HEAD(&t->admit_list);
+    t->processing_time = processing_time;
+    t->period = period;
+    t->deadline = period;
+    t->n = n;
+    t->is_real_time = is_real_time;
+    t->remaining_time = processing_time;
+    t->priority = 100;
+    t->weight = 1;
+    t->arrival_time = 30000;
+    t->cbs.budget = processing_time;
+    t->cbs.remaining_budget = processing_time;
+    t->cbs.is_hard_rt = 1;
+    return t;
+}
+
+static void sim_add_at(struct thread *t, int arrival_time)
+{
+    struct release_queue_entry *e = xmalloc(sizeof(*e));
+
+    e->thrd = t;
+    e->release_time = arrival_time;
+    t->arrival_time = arrival_time;
+    if (t->is_real_time)
+        t->current_deadline = arrival_time + t->deadline;
+    e->seq = release_seq++;
+    if (heap_push(&release_queue, &e->node) < 0) {
+        fprintf(stderr, "simsched: out of memory\n");
+        exit(1);
+    }
+}
+
+// thread_admit(); returns -1 if t was not added.
+static int sim_admit(struct thread *t, int arrival_time)
+{
+    int r = 0;
+
+    if (t->is_real_time && policy->admit) {
+        if (t->period <= 0 || (r = policy->admit(&admitted, t)) < 0)
+            return -1;
+        list_add_tail(&t->admit_list, &admitted);
+    }
+    sim_add_at(t, arrival_time);
+    return r;
+}
+
+static void __release(void)
+{
+    struct release_queue_entry *cur, *nxt, *pos;
+    struct heap_node *n;
+    LIST_HEAD(due);
+
+    while ((n = heap_top(&release_queue)) != NULL) {
+        cur = heap_entry(n, struct release_queue_entry, node);
+        if (now < cur->release_time)
+            break;
+        heap_pop(&release_queue);
+        list_for_each_entry_reverse(pos, &due, thread_list) {
+            if (pos->seq < cur->seq)
+                break;
+        }
+        list_add(&cur->thread_list, &pos->thread_list);
+    }
+
+    list_for_each_entry_safe(cur, nxt, &due, thread_list) {
+        cur->thrd->remaining_time = cur->thrd->processing_time;
+        cur->thrd->current_deadline = cur->release_time + cur->thrd->deadline;
+        if (policy->on_release)
+            policy->on_release(cur->thrd);
+        __run_queue_add(cur->thrd);
+        list_del(&cur->thread_list);
+        free(cur);
+    }
+}
+
+static void __schedule(void)
+{
+    struct threads_sched_args args = {
+        .time_quantum = TIME_QUANTUM,
+        .current_time = now,
+        .run_queue = &run_queue,
+        .release_queue = &release_queue,
+    };
+    struct threads_sched_result r = policy->pick_next(args);
+
+    stats.decisions++;
+    current = r.scheduled_thread_list_member;
+    allocated_time = r.allocated_time;
+}
+
+// __thread_exit() up to where it schedules.
+static void __thread_exit(struct thread *t)
+{
+    current = t->thread_list.prev;
+    __run_queue_del(t);
+    list_del(&t->admit_list);
+    free(t->sched);
+    free(t);
+}
+
+static void __job_done(struct thread *t)
+{
+    stats.jobs++;
+    stats.turnaround += now - t->arrival_time;
+    if (!t->is_real_time && t->period > 0 && now > t->current_deadline)
+        stats.misses++;
+}
+
+// returns 0 to stop the run.
+static int __deadline_missed(struct thread *t, int at, char *where)
+{
+    if (mode == LOG)
+        printf("thread#%d misses a deadline at %d in %s\n", t->ID, at, where);
+    stats.misses++;
+    return !miss_exit;
+}
+
+// __finish_current() and __rt_finish_current(); returns 1 if the
+// thread exited.
+static int __finish(struct thread *t, int completed)
+{
+    --t->n;
+    if (completed) {
+        if (mode == LOG && t->is_real_time)
+            printf("thread#%d finish one cycle at %d: %d cycles left\n", t->ID, now, t->n);
+        else if (mode == LOG)
+            printf("thread#%d finish at %d\n", t->ID, now);
+        __job_done(t);
+    }
+
+    if (t->n <= 0) {
+        __thread_exit(t);
+        return 1;
+    }
+    current = current->prev;
+    __run_queue_del(t);
+    sim_add_at(t, t->current_deadline);
+    if (t->is_real_time && !t->cbs.is_hard_rt) {
+        t->cbs.remaining_budget = t->cbs.budget;
+        t->cbs.is_throttled = 0;
+    }
+    return 0;
+}
+
+static void __segment(struct thread *t)
+{
+    if (mode == CSV)
+        printf("%d,%d,%d\n", t->ID, now, now + allocated_time);
+    if (mode != GANTT)
+        return;
+    if (nsegments == capsegments) {
+        capsegments = capsegments ? capsegments * 2 : 64;
+        segments = realloc(segments, capsegments * sizeof(*segments));
+        if (segments == NULL) {
+            fprintf(stderr, "simsched: out of memory\n");
+            exit(1);
+        }
+    }
+    segments[nsegments++] = (struct segment){ t->ID, now, now + allocated_time };
+}
+
+// thread_start_threading(), with every thread running for the whole
+// of its allocated time; returns 0 if it stopped at a missed deadline.
+static int run(void)
+{
+    struct thread *t;
+
+    now = 0;
+    memset(&stats, 0, sizeof(stats));
+    if (policy->init)
+        policy->init();
+
+    while (!list_empty(&run_queue) || !heap_empty(&release_queue)) {
+        __release();
+        __schedule();
+
+        // __dispatch() and switch_handler()
+        while (current != &run_queue) {
+            t = list_entry(current, struct thread, thread_list);
+            if (allocated_time < 0) {
+                fprintf(stderr, "simsched: allocated_time is negative\n");
+                exit(1);
+            }
+            if (t->is_real_time && allocated_time == 0) {
+                if (!__deadline_missed(t, t->current_deadline, "dispatch"))
+                    return 0;
+                if (__finish(t, 0)) {
+                    __schedule();
+                    continue;
+                }
+                __release();
+                __schedule();
+                continue;
+            }
+            if (mode == LOG)
+                printf("dispatch thread#%d at %d: allocated_time=%d\n", t->ID, now, allocated_time);
+            if (t->remaining_time == t->processing_time) {
+                stats.started++;
+                stats.response += now - t->arrival_time;
+            }
+            __segment(t);
+
+            now += allocated_time;
+            __release();
+            t->remaining_time -= allocated_time;
+            if (!t->cbs.is_hard_rt)
+                t->cbs.remaining_budget -= allocated_time;
+            if (policy->on_tick)
+                policy->on_tick(t, allocated_time);
+
+            if (t->is_real_time && !t->cbs.is_throttled &&
+                (now > t->current_deadline || (now == t->current_deadline && t->remaining_time > 0))) {
+                if (!__deadline_missed(t, now, "swicth"))
+                    return 0;
+                if (__finish(t, 0)) {
+                    __schedule();
+                    continue;
+                }
+            } else if (t->remaining_time <= 0) {
+                if (__finish(t, 1)) {
+                    __schedule();
+                    continue;
+                }
+            } else {
+                current = current->prev;
+                __run_queue_move_tail(t);
+            }
+            __release();
+            __schedule();
+        }
+
+        if (list_empty(&run_queue) && heap_empty(&release_queue))
+            break;
+        if (allocated_time <= 0 || now > MAX_TIME) {
+            fprintf(stderr, "simsched: %s makes no progress at %d\n", policy->name, now);
+            exit(1);
+        }
+        if (mode == LOG)
+            printf("run_queue is empty, sleep for %d ticks\n", allocated_time);
+        now += allocated_time;
+    }
+    stats.time = now;
+    return 1;
+}
+
+static void gantt(void)
+{
+    int i, c, ticks = 1, cols, maxid = 0;
+    char *row;
+
+    for (i = 0; i < nsegments; i++)
+        if (segments[i].id > maxid)
+            maxid = segments[i].id;
+    while ((now + ticks - 1) / ticks > GANTT_WIDTH)
+        ticks++;
+    cols = (now + ticks - 1) / ticks;
+    row = xmalloc(cols + 1);
+
+    printf("%d tick%s per column\n", ticks, ticks > 1 ? "s" : "");
+    for (int id = 1; id <= maxid; id++) {
+        memset(row, '.', cols);
+        row[cols] = 0;
+        for (i = 0; i < nsegments; i++) {
+            if (segments[i].id != id)
+                continue;
+            for (c = segments[i].start / ticks; c * ticks < segments[i].end && c < cols; c++)
+                row[c] = '#';
+        }
+        printf("thread#%-3d |%s|\n", id, row);
+    }
+    free(row);
+}
+
+static int replay(int admit)
+{
+    char line[256];
+    int rt, burst, period, n, arrival, priority, budget, hard, weight, k, r;
+    struct thread *t;
+
+    next_id = 1;
+    while (fgets(line, sizeof(line), stdin)) {
+        if (line[0] == '#')
+            continue;
+        priority = 100;
+        budget = -1;
+        hard = 1;
+        weight = 1;
+        k = sscanf(line, "%d %d %d %d %d %d %d %d %d", &rt, &burst, &period, &n, &arrival,
+                   &priority, &budget, &hard, &weight);
+        if (k < 5)
+            continue;
+        t = sim_create(rt, burst, period, n);
+        t->priority = priority;
+        t->weight = weight > 0 ? weight : 1;
+        if (budget >= 0) {
+            t->cbs.budget = t->cbs.remaining_budget = budget;
+            t->cbs.is_hard_rt = hard;
+        }
+        if (!admit) {
+            sim_add_at(t, arrival);
+            continue;
+        }
+        if ((r = sim_admit(t, arrival)) < 0) {
+            if (mode == LOG)
+                printf("thread#%d not admitted\n", t->ID);
+            free(t);
+        } else if (r > 0 && mode == LOG) {
+            printf("thread#%d admitted with budget %d\n", t->ID, t->cbs.budget);
+        }
+    }
+
+    if (mode == CSV)
+        printf("thread,start,end\n");
+    miss_exit = 1;
+    r = run();
+    if (mode == GANTT)
+        gantt();
+    return r ? 0 : 2;
+}
+
+static unsigned long long seed = 1;
+
+static int rnd(int lo, int hi)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return lo + (int)((seed >> 33) % (hi - lo + 1));
+}
+
+struct task {
+    int processing_time, period, n, arrival, priority, budget, is_hard_rt;
+};
+
+// a random periodic task set of about utilization 0.5 to 1.2.
+static void generate(struct task *ts, int m)
+{
+    int target = rnd(50, 120), i;
+
+    for (i = 0; i < m; i++) {
+        struct task *t = &ts[i];
+        t->period = rnd(5, 100);
+        t->processing_time = t->period * target / (100 * m);
+        if (t->processing_time < 1)
+            t->processing_time = 1;
+        t->n = rnd(1, 10);
+        t->arrival = rnd(0, 50);
+        t->priority = rnd(0, 5);
+        t->is_hard_rt = rnd(0, 3) != 0;
+        t->budget = t->is_hard_rt ? t->processing_time : rnd(1, t->processing_time);
+    }
+}
+
+static void sweep(int workloads, int m)
+{
+    struct task *ts = xmalloc(m * sizeof(*ts));
+    struct thread_stats *total;
+    double *secs;
+    int npolicies, p, w, i;
+    clock_t c0;
+
+    for (npolicies = 0; threads_sched_policies[npolicies]; npolicies++)
+        ;
+    total = calloc(npolicies, sizeof(*total));
+    secs = calloc(npolicies, sizeof(*secs));
+    if (total == NULL || secs == NULL) {
+        fprintf(stderr, "simsched: out of memory\n");
+        exit(1);
+    }
+
+    mode = QUIET;
+    miss_exit = 0;
+    for (w = 0; w < workloads; w++) {
+        generate(ts, m);
+        for (p = 0; p < npolicies; p++) {
+            policy = threads_sched_policies[p];
+            next_id = 1;
+            for (i = 0; i < m; i++) {
+                struct thread *t = sim_create(policy->real_time, ts[i].processing_time,
+                                              ts[i].period, ts[i].n);
+                t->priority = ts[i].priority;
+                t->cbs.budget = t->cbs.remaining_budget = ts[i].budget;
+                t->cbs.is_hard_rt = ts[i].is_hard_rt;
+                sim_add_at(t, ts[i].arrival);
+            }
+            c0 = clock();
+            run();
+            secs[p] += (double)(clock() - c0) / CLOCKS_PER_SEC;
+            total[p].jobs += stats.jobs;
+            total[p].turnaround += stats.turnaround;
+            total[p].started += stats.started;
+            total[p].response += stats.response;
+            total[p].misses += stats.misses;
+            total[p].time += stats.time;
+            total[p].decisions += stats.decisions;
+        }
+    }
+
+    printf("%d workloads of %d threads\n", workloads, m);
+    printf("%-8s %10s %10s %10s %10s %12s %10s\n", "policy", "jobs", "turnaround", "response",
+           "misses", "decisions", "M dec/s");
+    for (p = 0; p < npolicies; p++) {
+        struct thread_stats *s = &total[p];
+        printf("%-8s %10d %10.2f %10.2f %10d %12d %10.2f\n", threads_sched_policies[p]->name,
+               s->jobs, s->jobs ? (double)s->turnaround / s->jobs : 0.0,
+               s->started ? (double)s->response / s->started : 0.0, s->misses,
+               s->decisions, secs[p] > 0 ? s->decisions / secs[p] / 1e6 : 0.0);
+    }
+    free(ts);
+    free(total);
+    free(secs);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: simsched [-a] [-g | -c] policy < tasks\n"
+               "       simsched -w workloads [-n threads] [-s seed]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int i, admit = 0, workloads = 0, m = 8;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-a") == 0)
+            admit = 1;
+        else if (strcmp(argv[i], "-g") == 0)
+            mode = GANTT;
+        else if (strcmp(argv[i], "-c") == 0)
+            mode = CSV;
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            workloads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            m = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 0);
+        else
+            usage();
+    }
+
+    if (workloads > 0) {
+        if (m < 1)
+            usage();
+        sweep(workloads, m);
+        return 0;
+    }
+    if (i + 1 != argc)
+        usage();
+    if ((policy = threads_sched_find(argv[i])) == NULL) {
+        fprintf(stderr, "simsched: no policy %s\n", argv[i]);
+        return 1;
+    }
+    return replay(admit);
+}
@@ -0,0 +1,11 @@
+// Stands in for xv6's user/user.h when the thread library's
+// scheduling policies are compiled for the host by sim/simsched.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// user/list.h defines its own
+#undef NULL
+
+#define fprintf(fd, ...) dprintf(fd, __VA_ARGS__)
@@ -0,0 +1,80 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+
+// Admission test cost benchmark.
+//
+// For each set size n, builds n admitted periodic threads using
+// about 60% of the processor and times the DM and EDF_CBS
+// schedulability tests for one more thread that comes before all of
+// them, the worst case for DM's response-time analysis, which must
+// then check every thread in the set again.
+//
+//   admitbench [n ...]
+
+#define HZ 10 // timer ticks per second
+#define WORK 20000000 // about how many thread visits to time per size
+
+static uint64 seed = 1;
+
+int rnd(int lo, int hi)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return lo + (int)((seed >> 33) % (hi - lo + 1));
+}
+
+void f(void *arg)
+{
+}
+
+void bench(char *name, int n)
+{
+    struct threads_sched_policy *p = threads_sched_find(name);
+    struct thread *t;
+    int i, rounds, t0, ticks, r = 0;
+    LIST_HEAD(admitted);
+
+    if (p == NULL || p->admit == NULL) {
+        fprintf(2, "admitbench: no admission test for %s\n", name);
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        int period = rnd(100, 10000);
+        int processing_time = period * 6 / (10 * n);
+        t = thread_create(f, 0, 1, processing_time > 0 ? processing_time : 1, period, 1);
+        list_add_tail(&t->admit_list, &admitted);
+    }
+    t = thread_create(f, 0, 1, 1, 50, 1);
+
+    rounds = WORK / n / n + 1;
+    t0 = uptime();
+    for (i = 0; i < rounds; i++)
+        r |= p->admit(&admitted, t);
+    ticks = uptime() - t0;
+    if (ticks == 0)
+        ticks = 1;
+    printf("%s: %d threads, %s, %d tests in %d ticks, %d us/test\n", name, n,
+           r ? "not admitted" : "admitted", rounds, ticks,
+           (int)((uint64)ticks * (1000000 / HZ) / rounds));
+}
+
+int main(int argc, char **argv)
+{
+    int sizes[] = { 10, 50, 100, 200, 500 };
+    int i;
+
+    for (i = 0; i < (argc > 1 ? argc - 1 : 5); i++) {
+        int n = argc > 1 ? atoi(argv[i + 1]) : sizes[i];
+        if (n < 1)
+            continue;
+        // each size in its own process, so the threads are freed
+        if (fork() == 0) {
+            bench("DM", n);
+            bench("EDF_CBS", n);
+            exit(0);
+        }
+        wait(0);
+    }
+    exit(0);
+}
@@ -0,0 +1,109 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// Admission control check.
+//
+// Offers random periodic threads, whose total utilization may well
+// exceed 1, to thread_admit() under DM and under EDF_CBS, then runs
+// what was admitted in a child process. Admitted sets must meet
+// every deadline; any miss is reported with the set that caused it.
+//
+//   admitcheck [sets [seed]]
+
+#define MAX_THREADS 6
+#define MIN_PERIOD 3
+#define MAX_PERIOD 12
+
+static uint64 seed;
+
+int rnd(int lo, int hi)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return lo + (int)((seed >> 33) % (hi - lo + 1));
+}
+
+void f(void *arg)
+{
+    while (1) {}
+}
+
+// returns 1 if the set offered under policy missed a deadline.
+int check(char *policy, int *offered, int *admitted, int *degraded)
+{
+    struct thread_stats s;
+    int fds[2], i, m, r, counts[3], status;
+
+    if (pipe(fds) < 0) {
+        fprintf(2, "admitcheck: pipe failed\n");
+        exit(1);
+    }
+    if (fork() == 0) {
+        close(fds[0]);
+        if (thread_set_policy(policy) < 0) {
+            fprintf(2, "admitcheck: no policy %s\n", policy);
+            exit(2);
+        }
+        counts[0] = counts[1] = counts[2] = 0;
+        m = rnd(1, MAX_THREADS);
+        for (i = 0; i < m; i++) {
+            int period = rnd(MIN_PERIOD, MAX_PERIOD);
+            int processing_time = rnd(1, period);
+            int soft = strcmp(policy, "EDF_CBS") == 0 && rnd(0, 3) == 0;
+            struct thread *t = thread_create(f, 0, 1, processing_time, period, rnd(1, 3));
+
+            init_thread_cbs(t, soft ? rnd(1, processing_time) : processing_time, !soft);
+            counts[0]++;
+            if ((r = thread_admit(t, rnd(0, 5))) >= 0) {
+                counts[1]++;
+                counts[2] += r;
+            } else {
+                free(t->stack);
+                free(t);
+            }
+        }
+        write(fds[1], counts, sizeof(counts));
+        close(fds[1]);
+        thread_set_verbose(0);
+        thread_set_miss_exit(0);
+        thread_start_threading();
+        thread_get_stats(&s);
+        exit(s.misses != 0);
+    }
+    close(fds[1]);
+    if (read(fds[0], counts, sizeof(counts)) != sizeof(counts))
+        counts[0] = counts[1] = counts[2] = 0;
+    close(fds[0]);
+    wait(&status);
+    *offered += counts[0];
+    *admitted += counts[1];
+    *degraded += counts[2];
+    return status != 0;
+}
+
+int main(int argc, char **argv)
+{
+    char *policies[] = { "DM", "EDF_CBS" };
+    int sets = 10, base = 1, p, i, offered, admitted, degraded, missed, failed = 0;
+
+    if (argc > 1)
+        sets = atoi(argv[1]);
+    if (argc > 2)
+        base = atoi(argv[2]);
+
+    for (p = 0; p < 2; p++) {
+        offered = admitted = degraded = missed = 0;
+        for (i = 0; i < sets; i++) {
+            // "admitcheck 1 seed" offers the same set again
+            seed = base + i;
+            if (check(policies[p], &offered, &admitted, &degraded)) {
+                printf("admitcheck: %s set with seed %d missed a deadline\n", policies[p], base + i);
+                missed++;
+            }
+        }
+        printf("%s: %d of %d threads admitted, %d with less budget, %d of %d sets missed deadlines\n",
+               policies[p], admitted, offered, degraded, missed, sets);
+        failed += missed;
+    }
+    exit(failed != 0);
+}
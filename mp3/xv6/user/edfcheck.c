@@ -0,0 +1,124 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// EDF_CBS schedulability check.
+//
+// Generates random periodic task sets of hard real-time threads and
+// soft ones served by a CBS, keeping the total utilization (C/T for
+// hard threads, Q/T for soft ones) at or below 1, and runs each
+// under EDF_CBS in a child process. EDF must then meet every
+// deadline, so any miss is reported with the task set that caused it.
+//
+//   edfcheck [sets [seed]]
+
+#define MAX_THREADS 6
+#define MIN_PERIOD 3
+#define MAX_PERIOD 12
+
+static uint64 seed = 1;
+
+int rnd(int lo, int hi)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return lo + (int)((seed >> 33) % (hi - lo + 1));
+}
+
+uint64 gcd(uint64 a, uint64 b)
+{
+    while (b) {
+        uint64 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+struct task {
+    int processing_time;
+    int period;
+    int n;
+    int arrival;
+    int budget;
+    int is_hard_rt;
+};
+
+void f(void *arg)
+{
+    while (1) {}
+}
+
+// fill ts with a random task set of utilization <= 1; returns its size.
+int gen(struct task *ts)
+{
+    // utilization so far is num/den
+    uint64 num = 0, den = 1, g;
+    int i, m = 0, tries = rnd(1, MAX_THREADS);
+
+    for (i = 0; i < tries; i++) {
+        struct task *t = &ts[m];
+        t->period = rnd(MIN_PERIOD, MAX_PERIOD);
+        t->processing_time = rnd(1, t->period);
+        t->is_hard_rt = rnd(0, 3) != 0;
+        t->budget = t->is_hard_rt ? t->processing_time : rnd(1, t->processing_time);
+        t->n = rnd(1, 3);
+        t->arrival = rnd(0, 5);
+        if (num * t->period + t->budget * den > den * t->period)
+            continue;
+        num = num * t->period + t->budget * den;
+        den = den * t->period;
+        g = gcd(num, den);
+        num /= g;
+        den /= g;
+        m++;
+    }
+    return m;
+}
+
+void print_set(struct task *ts, int m)
+{
+    for (int i = 0; i < m; i++)
+        printf("  thread#%d: C=%d T=%d n=%d at %d, %s budget %d\n", i + 1,
+               ts[i].processing_time, ts[i].period, ts[i].n, ts[i].arrival,
+               ts[i].is_hard_rt ? "hard" : "soft", ts[i].budget);
+}
+
+int main(int argc, char **argv)
+{
+    struct task ts[MAX_THREADS];
+    struct thread_stats s;
+    int sets = 10, i, j, m, status, failed = 0;
+
+    if (argc > 1)
+        sets = atoi(argv[1]);
+    if (argc > 2)
+        seed = atoi(argv[2]);
+
+    for (i = 0; i < sets; i++) {
+        m = gen(ts);
+        if (fork() == 0) {
+            for (j = 0; j < m; j++) {
+                struct thread *t = thread_create(f, 0, 1, ts[j].processing_time, ts[j].period, ts[j].n);
+                init_thread_cbs(t, ts[j].budget, ts[j].is_hard_rt);
+                thread_add_at(t, ts[j].arrival);
+            }
+            if (thread_set_policy("EDF_CBS") < 0) {
+                fprintf(2, "edfcheck: no EDF_CBS policy\n");
+                exit(2);
+            }
+            thread_set_verbose(0);
+            thread_set_miss_exit(0);
+            thread_start_threading();
+            thread_get_stats(&s);
+            exit(s.misses != 0);
+        }
+        wait(&status);
+        if (status != 0) {
+            printf("edfcheck: set %d missed a deadline:\n", i);
+            print_set(ts, m);
+            failed++;
+        }
+    }
+    printf("edfcheck: %d of %d sets missed deadlines\n", failed, sets);
+    exit(failed != 0);
+}
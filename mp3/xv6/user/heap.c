@@ -0,0 +1,99 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/heap.h"
+
+#define HEAP_MIN_CAP 16
+
+void heap_init(struct heap *h, heap_less_t less)
+{
+    h->nodes = NULL;
+    h->size = 0;
+    h->cap = 0;
+    h->less = less;
+}
+
+static void __heap_set(struct heap *h, int i, struct heap_node *n)
+{
+    h->nodes[i] = n;
+    n->index = i;
+}
+
+static void __heap_up(struct heap *h, int i)
+{
+    struct heap_node *n = h->nodes[i];
+
+    while (i > 0 && h->less(n, h->nodes[(i - 1) / 2])) {
+        __heap_set(h, i, h->nodes[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    __heap_set(h, i, n);
+}
+
+static void __heap_down(struct heap *h, int i)
+{
+    struct heap_node *n = h->nodes[i];
+    int c;
+
+    while ((c = 2 * i + 1) < h->size) {
+        if (c + 1 < h->size && h->less(h->nodes[c + 1], h->nodes[c]))
+            c++;
+        if (!h->less(h->nodes[c], n))
+            break;
+        __heap_set(h, i, h->nodes[c]);
+        i = c;
+    }
+    __heap_set(h, i, n);
+}
+
+// returns -1 if the heap could not grow.
+int heap_push(struct heap *h, struct heap_node *n)
+{
+    struct heap_node **nodes;
+    int cap;
+
+    if (h->size == h->cap) {
+        cap = h->cap ? 2 * h->cap : HEAP_MIN_CAP;
+        if ((nodes = malloc(cap * sizeof(*nodes))) == NULL)
+            return -1;
+        if (h->nodes) {
+            memmove(nodes, h->nodes, h->size * sizeof(*nodes));
+            free(h->nodes);
+        }
+        h->nodes = nodes;
+        h->cap = cap;
+    }
+    __heap_set(h, h->size++, n);
+    __heap_up(h, n->index);
+    return 0;
+}
+
+struct heap_node *heap_pop(struct heap *h)
+{
+    struct heap_node *n = heap_top(h);
+
+    if (n)
+        heap_remove(h, n);
+    return n;
+}
+
+void heap_remove(struct heap *h, struct heap_node *n)
+{
+    int i = n->index;
+
+    n->index = -1;
+    if (--h->size == i)
+        return;
+    __heap_set(h, i, h->nodes[h->size]);
+    heap_fix(h, h->nodes[i]);
+}
+
+// restore heap order after n's key changed.
+void heap_fix(struct heap *h, struct heap_node *n)
+{
+    int i = n->index;
+
+    if (i > 0 && h->less(n, h->nodes[(i - 1) / 2]))
+        __heap_up(h, i);
+    else
+        __heap_down(h, i);
+}
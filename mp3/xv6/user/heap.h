@@ -0,0 +1,51 @@
+#ifndef HEAP_H_
+#define HEAP_H_
+
+#include "user/list.h"
+
+// Binary min-heap of nodes embedded in the caller's structures,
+// the way struct list_head is. Each node remembers its slot, so
+// any node can be removed or re-keyed in O(log n).
+
+struct heap_node {
+    // index in the heap's array, -1 if not in a heap
+    int index;
+};
+
+// returns non-zero if a must come out of the heap before b.
+typedef int (*heap_less_t)(struct heap_node *a, struct heap_node *b);
+
+struct heap {
+    struct heap_node **nodes;
+    int size;
+    int cap;
+    heap_less_t less;
+};
+
+#define heap_entry(ptr, type, member) container_of(ptr, type, member)
+
+void heap_init(struct heap *h, heap_less_t less);
+int heap_push(struct heap *h, struct heap_node *n);
+struct heap_node *heap_pop(struct heap *h);
+void heap_remove(struct heap *h, struct heap_node *n);
+void heap_fix(struct heap *h, struct heap_node *n);
+
+static inline int heap_empty(struct heap *h)
+{
+    return h->size == 0;
+}
+
+// the first node out, or NULL if empty.
+static inline struct heap_node *heap_top(struct heap *h)
+{
+    return h->size ? h->nodes[0] : NULL;
+}
+
+// the node at index i of the array, or NULL; the children of
+// index i are at 2i+1 and 2i+2.
+static inline struct heap_node *heap_at(struct heap *h, int i)
+{
+    return i < h->size ? h->nodes[i] : NULL;
+}
+
+#endif // HEAP_H_
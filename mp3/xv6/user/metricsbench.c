@@ -0,0 +1,87 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// Metrics overhead benchmark.
+//
+// nthreads threads each call thread_yield() nyields times, so the
+// run is nothing but scheduling decisions, once without and once
+// with thread_set_metrics(1), each in its own child process. Reports
+// the time per decision of each and the difference, which is what
+// collecting the metrics costs. The time is taken when the last
+// thread finishes, before the metrics are printed.
+//
+//   metricsbench [nthreads [nyields]]
+
+#define HZ 10 // timer ticks per second
+
+static int nyields;
+static volatile int t_end;
+
+void yield_thread(void *arg)
+{
+    for (int i = 0; i < nyields; i++)
+        thread_yield();
+    t_end = uptime();
+}
+
+// returns the ns per decision.
+int run(int nthreads, int on)
+{
+    struct thread_stats s;
+    int fds[2], i, t0, r[2];
+
+    if (pipe(fds) < 0) {
+        fprintf(2, "metricsbench: pipe failed\n");
+        exit(1);
+    }
+    if (fork() == 0) {
+        close(fds[0]);
+        for (i = 0; i < nthreads; i++)
+            thread_add_at(thread_create(yield_thread, 0, 0, 1000000, -1, 1), 0);
+        thread_set_verbose(0);
+        thread_set_metrics(on);
+        t0 = uptime();
+        thread_start_threading();
+        thread_get_stats(&s);
+        r[0] = t_end - t0;
+        r[1] = s.decisions;
+        write(fds[1], r, sizeof(r));
+        exit(0);
+    }
+    close(fds[1]);
+    if (read(fds[0], r, sizeof(r)) != sizeof(r)) {
+        fprintf(2, "metricsbench: run failed\n");
+        exit(1);
+    }
+    close(fds[0]);
+    wait(0);
+
+    if (r[0] == 0)
+        r[0] = 1;
+    if (r[1] == 0)
+        r[1] = 1;
+    printf("metrics %s: %d decisions in %d ticks, %d ns/decision\n", on ? "on " : "off",
+           r[1], r[0], (int)((uint64)r[0] * (1000000000 / HZ) / r[1]));
+    return (int)((uint64)r[0] * (1000000000 / HZ) / r[1]);
+}
+
+int main(int argc, char **argv)
+{
+    int nthreads = 100, off, on;
+
+    nyields = 50;
+    if (argc > 1)
+        nthreads = atoi(argv[1]);
+    if (argc > 2)
+        nyields = atoi(argv[2]);
+    if (nthreads < 1 || nyields < 1) {
+        fprintf(2, "Usage: metricsbench [nthreads [nyields]]\n");
+        exit(1);
+    }
+
+    off = run(nthreads, 0);
+    on = run(nthreads, 1);
+    printf("metrics cost %d ns/decision\n", on - off);
+    exit(0);
+}
@@ -0,0 +1,78 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// M:N scaling benchmark.
+//
+// nthreads CPU-bound threads each spin through the same amount of
+// work and exit, run by 1, 2, 3 and then 4 workers. Reports the
+// ticks each run took, its speedup over one worker and how many
+// threads workers stole from each other. Needs as many harts as
+// workers to scale: make qemu CPUS=4.
+//
+//   mtbench [nthreads [work]]
+
+#define MAX_WORKERS 4
+
+static int work = 50000000;
+
+void f(void *arg)
+{
+    volatile int x = 0;
+
+    for (int i = 0; i < work; i++)
+        x += i;
+    thread_exit();
+}
+
+// returns the ticks the run took.
+int run(int nthreads, int nworkers)
+{
+    struct thread_stats s;
+    int fds[2], i, r[2];
+
+    if (pipe(fds) < 0) {
+        fprintf(2, "mtbench: pipe failed\n");
+        exit(1);
+    }
+    if (fork() == 0) {
+        close(fds[0]);
+        for (i = 0; i < nthreads; i++)
+            thread_add_at(thread_create(f, 0, 0, 1 << 30, 0, 1), 0);
+        thread_start_workers(nworkers);
+        thread_get_stats(&s);
+        r[0] = s.time;
+        r[1] = s.steals;
+        write(fds[1], r, sizeof(r));
+        exit(0);
+    }
+    close(fds[1]);
+    if (read(fds[0], r, sizeof(r)) != sizeof(r))
+        r[0] = r[1] = -1;
+    close(fds[0]);
+    wait(0);
+    if (r[0] < 0) {
+        fprintf(2, "mtbench: run with %d workers failed\n", nworkers);
+        exit(1);
+    }
+    printf("%d workers: %d ticks, %d steals", nworkers, r[0], r[1]);
+    return r[0] > 0 ? r[0] : 1;
+}
+
+int main(int argc, char **argv)
+{
+    int nthreads = 8, n, t, t1 = 0;
+
+    if (argc > 1)
+        nthreads = atoi(argv[1]);
+    if (argc > 2)
+        work = atoi(argv[2]);
+
+    for (n = 1; n <= MAX_WORKERS; n++) {
+        t = run(nthreads, n);
+        if (n == 1)
+            t1 = t;
+        printf(", speedup %d.%d%d\n", t1 / t, t1 * 10 / t % 10, t1 * 100 / t % 10);
+    }
+    exit(0);
+}
@@ -0,0 +1,111 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// Response time benchmark.
+//
+// Runs task sets mixing interactive threads (short bursts released
+// often) with batch threads (one long burst) under HRRN, PRR and
+// MLFQ, each in its own child process, and reports the mean response
+// time (first dispatch minus release) and turnaround of their jobs.
+// Every thread gets the same priority: none of the policies is told
+// which threads are interactive.
+//
+//   respbench [policy ...]
+
+struct task {
+    int processing_time;
+    int period;
+    int n;
+    int arrival;
+};
+
+struct taskset {
+    char *name;
+    int ntasks;
+    struct task tasks[8];
+};
+
+static struct taskset sets[] = {
+    { "2 batch, 4 interactive", 6, {
+        {40, 1000, 1, 0},
+        {30, 1000, 1, 0},
+        {1, 6, 12, 0},
+        {1, 6, 12, 1},
+        {1, 8, 10, 2},
+        {2, 10, 8, 3},
+    } },
+    { "4 batch, 2 interactive", 6, {
+        {25, 1000, 1, 0},
+        {25, 1000, 1, 5},
+        {25, 1000, 1, 10},
+        {25, 1000, 1, 15},
+        {1, 5, 20, 0},
+        {2, 10, 10, 4},
+    } },
+    { "batch only", 4, {
+        {10, 1000, 1, 0},
+        {20, 1000, 1, 0},
+        {30, 1000, 1, 0},
+        {40, 1000, 1, 0},
+    } },
+};
+
+static char *policies[] = { "HRRN", "PRR", "MLFQ" };
+
+void f(void *arg)
+{
+    while (1) {}
+}
+
+void run(struct taskset *ts, char *policy)
+{
+    struct thread_stats s;
+    int i;
+
+    if (thread_set_policy(policy) < 0) {
+        fprintf(2, "respbench: no policy %s\n", policy);
+        exit(1);
+    }
+    for (i = 0; i < ts->ntasks; i++) {
+        struct task *k = &ts->tasks[i];
+        struct thread *t = thread_create(f, 0, 0, k->processing_time, k->period, k->n);
+        thread_set_priority(t, 1);
+        thread_add_at(t, k->arrival);
+    }
+
+    thread_set_verbose(0);
+    thread_set_miss_exit(0);
+    thread_start_threading();
+    thread_get_stats(&s);
+
+    if (s.started == 0)
+        s.started = 1;
+    if (s.jobs == 0)
+        s.jobs = 1;
+    printf("  %s: mean response %d.%d ticks, mean turnaround %d.%d ticks, %d decisions\n", policy,
+           s.response / s.started, s.response * 10 / s.started % 10,
+           s.turnaround / s.jobs, s.turnaround * 10 / s.jobs % 10, s.decisions);
+}
+
+int main(int argc, char **argv)
+{
+    int i, p, j;
+
+    for (i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+        printf("%s:\n", sets[i].name);
+        for (p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+            for (j = 1; j < argc; j++)
+                if (strcmp(argv[j], policies[p]) == 0)
+                    break;
+            if (argc > 1 && j == argc)
+                continue;
+            if (fork() == 0) {
+                run(&sets[i], policies[p]);
+                exit(0);
+            }
+            wait(0);
+        }
+    }
+    exit(0);
+}
@@ -0,0 +1,141 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// EDF class test.
+//
+// Runs three periodic processes against nspin processes that spin
+// forever, first all in the normal class and then with the periodic
+// ones given EDF class reservations by sched_setattr(), and reports
+// how many of their jobs missed a deadline each time. Each job does
+// about runtime - 1 ticks of work, leaving a tick for the kernel's
+// per-tick accounting to be off by. With reservations no job may
+// miss.
+//
+//   rttest [nspin [jobs]]
+
+#define MAX_SPIN 16
+
+struct task {
+    int runtime;
+    int deadline;
+    int period;
+};
+
+// utilization 0.6
+static struct task tasks[] = {
+    {2, 10, 10},
+    {3, 15, 15},
+    {4, 20, 20},
+};
+
+#define NTASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+static int chunks_per_tick;
+
+void work(int chunks)
+{
+    volatile int x = 0;
+
+    for (int i = 0; i < chunks; i++)
+        for (int j = 0; j < 1000; j++)
+            x++;
+}
+
+void calibrate(void)
+{
+    int t0, n = 0;
+
+    t0 = uptime();
+    while (uptime() == t0) {}
+    t0 = uptime();
+    while (uptime() < t0 + 5) {
+        work(1);
+        n++;
+    }
+    chunks_per_tick = n / 5 > 0 ? n / 5 : 1;
+}
+
+// run jobs jobs of k; returns how many missed their deadline.
+int periodic(struct task *k, int rt, int jobs)
+{
+    int j, release = 0, due, misses = 0;
+
+    if (rt) {
+        if (sched_setattr(0, k->runtime, k->deadline, k->period) < 0) {
+            fprintf(2, "rttest: sched_setattr(%d, %d, %d) failed\n", k->runtime, k->deadline, k->period);
+            exit(-1);
+        }
+        // start on a period boundary
+        due = sched_yield();
+    } else {
+        release = uptime();
+        due = release + k->deadline;
+    }
+
+    for (j = 0; j < jobs; j++) {
+        work((k->runtime - 1) * chunks_per_tick);
+        if (uptime() > due)
+            misses++;
+        if (rt) {
+            due = sched_yield();
+        } else {
+            release += k->period;
+            if (uptime() < release)
+                sleep(release - uptime());
+            due = release + k->deadline;
+        }
+    }
+    return misses;
+}
+
+// returns the number of jobs that missed.
+int run(int rt, int nspin, int jobs)
+{
+    int spinners[MAX_SPIN], periodics[NTASKS];
+    int i, pid, status, left = NTASKS, misses = 0;
+
+    for (i = 0; i < nspin; i++) {
+        if ((spinners[i] = fork()) == 0)
+            for (;;) {}
+    }
+    for (i = 0; i < NTASKS; i++) {
+        if ((periodics[i] = fork()) == 0)
+            exit(periodic(&tasks[i], rt, jobs));
+    }
+
+    while (left > 0 && (pid = wait(&status)) > 0) {
+        for (i = 0; i < NTASKS; i++) {
+            if (pid != periodics[i])
+                continue;
+            if (status < 0)
+                fprintf(2, "rttest: periodic process %d failed\n", i);
+            else
+                misses += status;
+            left--;
+        }
+    }
+    for (i = 0; i < nspin; i++)
+        kill(spinners[i]);
+    for (i = 0; i < nspin; i++)
+        wait(0);
+
+    printf("%s: %d of %d jobs missed their deadline, against %d spinners\n",
+           rt ? "EDF class" : "normal class", misses, NTASKS * jobs, nspin);
+    return misses;
+}
+
+int main(int argc, char **argv)
+{
+    int nspin = 4, jobs = 10;
+
+    if (argc > 1)
+        nspin = atoi(argv[1]);
+    if (argc > 2)
+        jobs = atoi(argv[2]);
+    if (nspin < 0 || nspin > MAX_SPIN)
+        nspin = MAX_SPIN;
+
+    calibrate();
+    run(0, nspin, jobs);
+    exit(run(1, nspin, jobs) != 0);
+}
@@ -0,0 +1,73 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// Scheduler scaling benchmark.
+//
+// For each thread count, runs that many threads that each call
+// thread_yield() nyields times under the policy the library was
+// built with, and reports the time per scheduling decision. Each
+// yield and each exit is one decision over the whole run queue.
+// Pass "rt" to make the threads real-time, for DM and EDF_CBS.
+//
+//   schedbench [nyields [rt [nthreads ...]]]
+
+#define HZ 10 // timer ticks per second
+
+static int nyields = 5;
+
+void yield_thread(void *arg)
+{
+    for (int i = 0; i < nyields; i++)
+        thread_yield();
+}
+
+void run(int nthreads, int rt)
+{
+    int i, t0, ticks, decisions;
+
+    for (i = 0; i < nthreads; i++) {
+        // long enough that no thread finishes or misses a deadline
+        // before it has yielded nyields times
+        struct thread *t = thread_create(yield_thread, 0, rt, 100000, rt ? 1000000 : -1, 1);
+        thread_set_priority(t, i % 5);
+        if (rt)
+            init_thread_cbs(t, 100000, 1);
+        thread_add_at(t, 0);
+    }
+
+    t0 = uptime();
+    thread_start_threading();
+    ticks = uptime() - t0;
+    if (ticks == 0)
+        ticks = 1;
+    decisions = nthreads * (nyields + 1);
+    printf("%d threads: %d decisions in %d ticks, %d ns/decision\n",
+           nthreads, decisions, ticks,
+           (int)((uint64)ticks * (1000000000 / HZ) / decisions));
+}
+
+int main(int argc, char **argv)
+{
+    static int sizes[] = { 10, 100, 1000, 2000 };
+    int i, rt = 0;
+
+    if (argc > 1)
+        nyields = atoi(argv[1]);
+    if (argc > 2)
+        rt = strcmp(argv[2], "rt") == 0;
+    if (nyields < 1) {
+        fprintf(2, "Usage: schedbench [nyields [rt [nthreads ...]]]\n");
+        exit(1);
+    }
+
+    thread_set_verbose(0);
+    if (argc > 3) {
+        for (i = 3; i < argc; i++)
+            run(atoi(argv[i]), rt);
+    } else {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            run(sizes[i], rt);
+    }
+    exit(0);
+}
@@ -0,0 +1,90 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+#include "user/threads_sched.h"
+
+// Scheduling policy comparison.
+//
+// Runs the same periodic task set under every policy the library
+// has, each in its own child process, and reports per policy the
+// jobs completed per 100 ticks, the mean turnaround (completion
+// minus release) and the deadline misses. Real-time policies run
+// the tasks as real-time threads, the others as ordinary ones.
+// Misses are counted instead of ending the run.
+//
+//   schedcmp [policy ...]
+
+struct task {
+    int processing_time;
+    int period;
+    int n;
+    int priority;
+};
+
+// utilization 0.85
+static struct task tasks[] = {
+    {1, 5, 4, 1},
+    {2, 10, 2, 0},
+    {3, 15, 2, 2},
+    {1, 4, 5, 1},
+};
+
+void f(void *arg)
+{
+    while (1) {}
+}
+
+void run(struct threads_sched_policy *p)
+{
+    struct thread_stats s;
+    int i, n = sizeof(tasks) / sizeof(tasks[0]);
+
+    if (thread_set_policy(p->name) < 0) {
+        fprintf(2, "schedcmp: no policy %s\n", p->name);
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        struct thread *t = thread_create(f, 0, p->real_time, tasks[i].processing_time,
+                                         tasks[i].period, tasks[i].n);
+        thread_set_priority(t, tasks[i].priority);
+        init_thread_cbs(t, tasks[i].processing_time, 1);
+        thread_add_at(t, 0);
+    }
+
+    thread_set_verbose(0);
+    thread_set_miss_exit(0);
+    thread_start_threading();
+    thread_get_stats(&s);
+
+    if (s.time == 0)
+        s.time = 1;
+    if (s.jobs == 0)
+        s.jobs = 1;
+    printf("%s: %d jobs in %d ticks, %d jobs/100 ticks, mean turnaround %d.%d ticks, %d misses, %d decisions\n",
+           p->name, s.jobs, s.time, s.jobs * 100 / s.time,
+           s.turnaround / s.jobs, s.turnaround * 10 / s.jobs % 10, s.misses, s.decisions);
+}
+
+int main(int argc, char **argv)
+{
+    struct threads_sched_policy *p;
+    int i;
+
+    for (i = 0; threads_sched_policies[i]; i++) {
+        p = threads_sched_policies[i];
+        if (argc > 1) {
+            int j;
+            for (j = 1; j < argc; j++)
+                if (strcmp(argv[j], p->name) == 0)
+                    break;
+            if (j == argc)
+                continue;
+        }
+        if (fork() == 0) {
+            run(p);
+            exit(0);
+        }
+        wait(0);
+    }
+    exit(0);
+}
@@ -0,0 +1,168 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// Proportional share benchmark.
+//
+// Three CPU-bound threads with weights 1:2:4 run under the STRIDE
+// and LOTTERY policies of the threads library, then three processes
+// with kernel shares 100:200:400 (setshare()) run under the kernel's
+// scheduler, stride or, if built with KSCHED=LOTTERY, lottery. For
+// each, the share of the work each one got by 10, 50 and 200 ticks
+// is reported against the ideal 14.3%, 28.6% and 57.1%, along with
+// the overhead: how much less work all three did than one loop
+// running alone for as long. Run with CPUS=1 for the kernel shares
+// to be contended.
+//
+//   sharebench
+
+#define N 3
+#define NWINDOWS 3
+
+static int weights[N] = { 1, 2, 4 };
+static int windows[NWINDOWS] = { 10, 50, 200 };
+
+static volatile uint64 work[N];
+static uint64 snap[NWINDOWS][N];
+static volatile int nsnap;
+static int t0;
+static uint64 alone; // chunks of work per tick with nothing else running
+
+void chunk(volatile uint64 *w)
+{
+    for (int i = 0; i < 1000; i++)
+        (*w)++;
+}
+
+void calibrate(void)
+{
+    volatile uint64 w = 0;
+    int t;
+
+    t = uptime();
+    while (uptime() == t) {}
+    t = uptime();
+    while (uptime() < t + 20)
+        chunk(&w);
+    alone = w / 1000 / 20;
+    if (alone == 0)
+        alone = 1;
+}
+
+void report(char *name, int decisions)
+{
+    uint64 total;
+    int i, k;
+
+    printf("%s:", name);
+    if (decisions >= 0)
+        printf(" %d decisions", decisions);
+    printf("\n");
+    for (k = 0; k < NWINDOWS; k++) {
+        total = 0;
+        for (i = 0; i < N; i++)
+            total += snap[k][i];
+        if (total == 0)
+            total = 1;
+        printf("  by %d ticks:", windows[k]);
+        for (i = 0; i < N; i++)
+            printf(" %d.%d%%", (int)(snap[k][i] * 100 / total), (int)(snap[k][i] * 1000 / total % 10));
+        printf(", overhead %d%%\n",
+               (int)(100 - total / 1000 * 100 / (alone * windows[k])));
+    }
+}
+
+void f(void *arg)
+{
+    int i = (int)(uint64)arg, now;
+
+    for (;;) {
+        chunk(&work[i]);
+        now = uptime() - t0;
+        while (nsnap < NWINDOWS && now >= windows[nsnap]) {
+            for (int j = 0; j < N; j++)
+                snap[nsnap][j] = work[j];
+            nsnap++;
+        }
+        if (nsnap == NWINDOWS)
+            thread_exit();
+    }
+}
+
+void threads(char *policy)
+{
+    struct thread_stats s;
+    int i;
+
+    if (thread_set_policy(policy) < 0) {
+        fprintf(2, "sharebench: no policy %s\n", policy);
+        exit(1);
+    }
+    for (i = 0; i < N; i++) {
+        struct thread *t = thread_create(f, (void *)(uint64)i, 0, 1 << 30, 0, 1);
+        thread_set_weight(t, weights[i]);
+        thread_add_at(t, 0);
+        work[i] = 0;
+    }
+    nsnap = 0;
+    thread_set_verbose(0);
+    t0 = uptime();
+    thread_start_threading();
+    thread_get_stats(&s);
+    report(policy, s.decisions);
+}
+
+void processes(void)
+{
+    int fds[2], i, k, start;
+    uint64 mine[NWINDOWS];
+
+    if (pipe(fds) < 0) {
+        fprintf(2, "sharebench: pipe failed\n");
+        exit(1);
+    }
+    start = uptime() + 2;
+    for (i = 0; i < N; i++) {
+        if (fork() == 0) {
+            volatile uint64 w = 0;
+            close(fds[0]);
+            if (setshare(0, 100 * weights[i]) < 0) {
+                fprintf(2, "sharebench: setshare failed\n");
+                exit(1);
+            }
+            while (uptime() < start) {}
+            for (k = 0; k < NWINDOWS; k++) {
+                while (uptime() - start < windows[k])
+                    chunk(&w);
+                mine[k] = w;
+            }
+            write(fds[1], &i, sizeof(i));
+            write(fds[1], mine, sizeof(mine));
+            exit(0);
+        }
+    }
+    close(fds[1]);
+    for (i = 0; i < N; i++) {
+        int who;
+        if (read(fds[0], &who, sizeof(who)) != sizeof(who) ||
+            read(fds[0], mine, sizeof(mine)) != sizeof(mine) || who < 0 || who >= N) {
+            fprintf(2, "sharebench: lost a process's counts\n");
+            exit(1);
+        }
+        for (k = 0; k < NWINDOWS; k++)
+            snap[k][who] = mine[k];
+    }
+    close(fds[0]);
+    for (i = 0; i < N; i++)
+        wait(0);
+    report("kernel shares", -1);
+}
+
+int main(int argc, char **argv)
+{
+    calibrate();
+    threads("STRIDE");
+    threads("LOTTERY");
+    processes();
+    exit(0);
+}
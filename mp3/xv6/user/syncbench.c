@@ -0,0 +1,164 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// Sync primitive benchmark.
+//
+// handoff: two threads pass a turn back and forth, through a mutex
+// and condition variable, then through two semaphores; each pass
+// blocks one thread and wakes the other. Reports the time per pass.
+//
+// blocking: a low-priority thread holds a mutex for CS ticks, and a
+// high-priority thread that needs it is released together with
+// NMEDIUM medium-priority threads of C ticks each. Reports the
+// longest the high thread waited for the mutex, which priority
+// inheritance bounds by CS, and its deadline misses under DM.
+//
+//   syncbench
+
+#define HZ 10 // timer ticks per second
+#define HANDOFFS 20000
+#define CS 3
+#define NMEDIUM 3
+#define C 5
+
+static struct thread_mutex m;
+static struct thread_cond c;
+static struct thread_sem sems[2];
+static int turn;
+
+void pingpong(void *arg)
+{
+    int me = (int)(uint64)arg;
+
+    for (int i = 0; i < HANDOFFS / 2; i++) {
+        thread_mutex_lock(&m);
+        while (turn != me)
+            thread_cond_wait(&c, &m);
+        turn = !me;
+        thread_cond_signal(&c);
+        thread_mutex_unlock(&m);
+    }
+}
+
+void pingpong_sem(void *arg)
+{
+    int me = (int)(uint64)arg;
+
+    for (int i = 0; i < HANDOFFS / 2; i++) {
+        thread_sem_wait(&sems[me]);
+        thread_sem_post(&sems[!me]);
+    }
+}
+
+void low(void *arg)
+{
+    int t0;
+
+    thread_mutex_lock(&m);
+    t0 = uptime();
+    while (uptime() - t0 < CS)
+        thread_yield();
+    thread_mutex_unlock(&m);
+}
+
+void medium(void *arg)
+{
+    while (1) {}
+}
+
+void high(void *arg)
+{
+    thread_mutex_lock(&m);
+    thread_mutex_unlock(&m);
+}
+
+void handoff(char *name, void (*f)(void *))
+{
+    int t0, ticks;
+
+    thread_mutex_init(&m);
+    thread_cond_init(&c);
+    thread_sem_init(&sems[0], 1);
+    thread_sem_init(&sems[1], 0);
+    for (int i = 0; i < 2; i++) {
+        struct thread *t = thread_create(f, (void *)(uint64)i, 0, 100000, -1, 1);
+        thread_set_priority(t, 1);
+        thread_add_at(t, 0);
+    }
+    t0 = uptime();
+    thread_start_threading();
+    ticks = uptime() - t0;
+    if (ticks == 0)
+        ticks = 1;
+    printf("%s: %d handoffs in %d ticks, %d us/handoff\n", name, HANDOFFS, ticks,
+           (int)((uint64)ticks * (1000000 / HZ) / HANDOFFS));
+}
+
+void blocking(char *policy, int inherit)
+{
+    struct thread_stats s;
+    struct thread *t;
+    int real_time = strcmp(policy, "DM") == 0;
+
+    thread_mutex_init(&m);
+    thread_set_inherit(inherit);
+    // deadlines 100, 50 and 20 under DM
+    t = thread_create(low, 0, real_time, real_time ? CS + 5 : 1000, real_time ? 100 : -1, 1);
+    thread_set_priority(t, 3);
+    thread_add_at(t, 0);
+    for (int i = 0; i < NMEDIUM; i++) {
+        t = thread_create(medium, 0, real_time, C, real_time ? 50 : -1, 1);
+        thread_set_priority(t, 2);
+        thread_add_at(t, 1);
+    }
+    t = thread_create(high, 0, real_time, real_time ? 2 : 1000, real_time ? 20 : -1, 1);
+    thread_set_priority(t, 1);
+    thread_add_at(t, 1);
+    thread_start_threading();
+    thread_get_stats(&s);
+    printf("%s, inherit %s: high waited %d ticks for the mutex (CS %d), %d misses\n",
+           policy, inherit ? "on" : "off", s.max_blocked, CS, s.misses);
+}
+
+// returns 1 in a new child process, set to run policy quietly, and
+// 0 in the parent once that child has exited.
+int child(char *policy)
+{
+    if (fork() != 0) {
+        wait(0);
+        return 0;
+    }
+    thread_set_verbose(0);
+    thread_set_miss_exit(0);
+    if (thread_set_policy(policy) < 0) {
+        fprintf(2, "syncbench: no policy %s\n", policy);
+        exit(1);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    char *policies[] = { "PRR", "DM" };
+    int p, inherit;
+
+    // each run in its own process, so the threads are freed
+    if (child("PRR")) {
+        handoff("mutex and cond", pingpong);
+        exit(0);
+    }
+    if (child("PRR")) {
+        handoff("semaphores", pingpong_sem);
+        exit(0);
+    }
+    for (p = 0; p < 2; p++) {
+        for (inherit = 1; inherit >= 0; inherit--) {
+            if (child(policies[p])) {
+                blocking(policies[p], inherit);
+                exit(0);
+            }
+        }
+    }
+    exit(0);
+}
@@ -0,0 +1,204 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// Sync primitive check.
+//
+// Runs each case in a child process:
+//   mutex    threads add to a counter, yielding between reading and
+//            writing it; the mutex must keep every update
+//   cond     a producer hands items to two consumers through a
+//            buffer of two; each item must be taken exactly once
+//   sem      threads take turns in a section a semaphore of 2
+//            guards; no more than 2 may be in it at once
+//   inherit  a low-priority thread holds a mutex a high one needs
+//            when a medium one is released with the high one; with
+//            priority inheritance the high one must get the mutex
+//            before the medium one runs, and without it after
+//
+//   synctest
+
+#define NTHREADS 4
+#define ROUNDS 20
+#define ITEMS 40
+
+static struct thread_mutex m;
+static struct thread_cond nonempty, nonfull;
+static struct thread_sem sem;
+static volatile int counter, inside, max_inside;
+static int buf[2], head, count, taken, sum;
+static volatile int h_started, m_ran, h_first;
+
+void adder(void *arg)
+{
+    for (int i = 0; i < ROUNDS; i++) {
+        thread_mutex_lock(&m);
+        int v = counter;
+        thread_yield();
+        counter = v + 1;
+        thread_mutex_unlock(&m);
+    }
+}
+
+void producer(void *arg)
+{
+    for (int i = 1; i <= ITEMS; i++) {
+        thread_mutex_lock(&m);
+        while (count == 2)
+            thread_cond_wait(&nonfull, &m);
+        buf[(head + count++) % 2] = i;
+        thread_cond_signal(&nonempty);
+        thread_mutex_unlock(&m);
+    }
+}
+
+void consumer(void *arg)
+{
+    for (int i = 0; i < ITEMS / 2; i++) {
+        thread_mutex_lock(&m);
+        while (count == 0)
+            thread_cond_wait(&nonempty, &m);
+        sum += buf[head];
+        head = (head + 1) % 2;
+        count--;
+        taken++;
+        thread_cond_signal(&nonfull);
+        thread_mutex_unlock(&m);
+        thread_yield();
+    }
+}
+
+void guarded(void *arg)
+{
+    for (int i = 0; i < ROUNDS; i++) {
+        thread_sem_wait(&sem);
+        if (++inside > max_inside)
+            max_inside = inside;
+        thread_yield();
+        inside--;
+        thread_sem_post(&sem);
+    }
+}
+
+// holds m until the high-priority thread wants it
+void low(void *arg)
+{
+    thread_mutex_lock(&m);
+    while (!h_started)
+        thread_yield();
+    thread_mutex_unlock(&m);
+}
+
+void medium(void *arg)
+{
+    m_ran = 1;
+    while (1) {}
+}
+
+void high(void *arg)
+{
+    h_started = 1;
+    thread_mutex_lock(&m);
+    h_first = !m_ran;
+    thread_mutex_unlock(&m);
+}
+
+struct thread *add(void (*f)(void *), int is_real_time, int processing_time, int period, int priority, int arrival_time)
+{
+    struct thread *t = thread_create(f, 0, is_real_time, processing_time, period, 1);
+
+    thread_set_priority(t, priority);
+    thread_add_at(t, arrival_time);
+    return t;
+}
+
+int check_mutex(void)
+{
+    for (int i = 0; i < NTHREADS; i++)
+        add(adder, 0, 1000, -1, 1, 0);
+    thread_start_threading();
+    return counter == NTHREADS * ROUNDS;
+}
+
+int check_cond(void)
+{
+    thread_cond_init(&nonempty);
+    thread_cond_init(&nonfull);
+    add(producer, 0, 1000, -1, 1, 0);
+    add(consumer, 0, 1000, -1, 1, 0);
+    add(consumer, 0, 1000, -1, 1, 0);
+    thread_start_threading();
+    return taken == ITEMS && sum == ITEMS * (ITEMS + 1) / 2;
+}
+
+int check_sem(void)
+{
+    thread_sem_init(&sem, 2);
+    for (int i = 0; i < NTHREADS; i++)
+        add(guarded, 0, 1000, -1, 1, 0);
+    thread_start_threading();
+    return max_inside == 2 && sem.count == 2;
+}
+
+// under PRR, or DM if real_time; expect is whether the high
+// thread should get the mutex first.
+int check_inherit(int real_time, int expect)
+{
+    struct thread_stats s;
+
+    thread_set_inherit(expect);
+    if (real_time) {
+        add(low, 1, 20, 40, 0, 0);
+        add(medium, 1, 3, 20, 0, 2);
+        add(high, 1, 2, 10, 0, 2);
+    } else {
+        add(low, 0, 1000, -1, 3, 0);
+        add(medium, 0, 3, -1, 2, 2);
+        add(high, 0, 1000, -1, 1, 2);
+    }
+    thread_start_threading();
+    thread_get_stats(&s);
+    return h_first == expect && s.misses == 0;
+}
+
+int run(char *name, char *policy, int c)
+{
+    int status;
+
+    if (fork() == 0) {
+        if (thread_set_policy(policy) < 0) {
+            fprintf(2, "synctest: no policy %s\n", policy);
+            exit(2);
+        }
+        thread_set_verbose(0);
+        thread_set_miss_exit(0);
+        thread_mutex_init(&m);
+        switch (c) {
+        case 0: exit(!check_mutex());
+        case 1: exit(!check_cond());
+        case 2: exit(!check_sem());
+        case 3: exit(!check_inherit(0, 1));
+        case 4: exit(!check_inherit(0, 0));
+        case 5: exit(!check_inherit(1, 1));
+        default: exit(!check_inherit(1, 0));
+        }
+    }
+    wait(&status);
+    printf("synctest: %s under %s: %s\n", name, policy, status == 0 ? "ok" : "FAILED");
+    return status != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    failed += run("mutex", "PRR", 0);
+    failed += run("mutex", "DEFAULT", 0);
+    failed += run("cond", "PRR", 1);
+    failed += run("sem", "PRR", 2);
+    failed += run("inherit", "PRR", 3);
+    failed += run("no inherit", "PRR", 4);
+    failed += run("inherit", "DM", 5);
+    failed += run("no inherit", "DM", 6);
+    exit(failed != 0);
+}
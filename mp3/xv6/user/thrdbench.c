@@ -0,0 +1,116 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/threads.h"
+
+// User thread switching benchmark.
+//
+// raw:   nthreads contexts pass control around a ring with
+//        uctx_save()/uctx_resume() alone, no scheduler involved.
+// sched: nthreads threads of the threads library each call
+//        thread_yield() nyields times, so every switch also runs
+//        __release() and the scheduler over the whole run queue.
+//
+// The difference per switch is the scheduler's overhead.
+//
+//   thrdbench [nthreads [nyields]]
+
+#define HZ 10 // timer ticks per second
+#define STACK_SIZE 1024
+#define RAW_SWITCHES 1000000
+
+static struct uctx main_ctx;
+static struct uctx *ring;
+static int nring;
+static volatile int nswitch;
+
+void ring_thread(void *arg)
+{
+    int i = (int)(uint64)arg;
+
+    for (;;) {
+        if (uctx_save(&ring[i]) == 0) {
+            if (++nswitch >= RAW_SWITCHES)
+                uctx_resume(&main_ctx);
+            uctx_resume(&ring[(i + 1) % nring]);
+        }
+    }
+}
+
+void report(char *what, int switches, int ticks)
+{
+    if (ticks == 0)
+        ticks = 1;
+    printf("%s: %d switches in %d ticks, %d switches/sec, %d ns/switch\n",
+           what, switches, ticks, switches * HZ / ticks,
+           (int)((uint64)ticks * (1000000000 / HZ) / switches));
+}
+
+void raw(int nthreads)
+{
+    char *stack;
+    int i, t0;
+
+    ring = malloc(nthreads * sizeof(struct uctx));
+    stack = malloc(nthreads * STACK_SIZE);
+    if (ring == 0 || stack == 0) {
+        fprintf(2, "thrdbench: out of memory\n");
+        exit(1);
+    }
+    nring = nthreads;
+    memset(ring, 0, nthreads * sizeof(struct uctx));
+    for (i = 0; i < nthreads; i++) {
+        ring[i].sp = (uint64)(stack + (i + 1) * STACK_SIZE);
+        ring[i].pc = (uint64)ring_thread;
+        ring[i].a0 = i;
+    }
+
+    nswitch = 0;
+    t0 = uptime();
+    if (uctx_save(&main_ctx) == 0)
+        uctx_resume(&ring[0]);
+    report("raw  ", nswitch, uptime() - t0);
+    free(stack);
+    free(ring);
+}
+
+static int nyields;
+
+void yield_thread(void *arg)
+{
+    for (int i = 0; i < nyields; i++)
+        thread_yield();
+}
+
+void sched(int nthreads)
+{
+    int i, t0;
+
+    for (i = 0; i < nthreads; i++) {
+        struct thread *t = thread_create(yield_thread, 0, 0, 1000000, -1, 1);
+        thread_add_at(t, 0);
+    }
+
+    thread_set_verbose(0);
+    t0 = uptime();
+    thread_start_threading();
+    report("sched", nthreads * nyields, uptime() - t0);
+}
+
+int main(int argc, char **argv)
+{
+    int nthreads = 300;
+
+    nyields = 20;
+    if (argc > 1)
+        nthreads = atoi(argv[1]);
+    if (argc > 2)
+        nyields = atoi(argv[2]);
+    if (nthreads < 1 || nyields < 1) {
+        fprintf(2, "Usage: thrdbench [nthreads [nyields]]\n");
+        exit(1);
+    }
+
+    raw(nthreads);
+    sched(nthreads);
+    exit(0);
+}
@@ -6,31 +6,153 @@
 
 #define NULL 0
 #define TIME_QUANTUM 2
+#define STACK_SIZE (0x200 * 8)
+
+static int __release_less(struct heap_node *a, struct heap_node *b);
 
 static LIST_HEAD(run_queue);
-static LIST_HEAD(release_queue);
+static LIST_HEAD(admitted);
+// threads that have exited, by thread_list, still to be freed
+static LIST_HEAD(zombies);
+static struct heap release_queue = { .less = __release_less };
+static int release_seq = 0;
 
 static struct list_head *current = NULL;
 static int threading_system_time = 0;
-static int main_thrd_id = -1;
-static int sleeping = 0;
+static struct uctx main_ctx;
+static volatile int sleeping = 0;
 static uint64 allocated_time = 0;
+static int verbose = 1;
+static int miss_exit = 1;
+static struct thread_stats stats;
+static int metrics = 0;
+static LIST_HEAD(metrics_list);
+static int inherit = 1;
+// threads blocked in sync primitives
+static int nblocked = 0;
+// while a thread is in a sync primitive, a timer upcall only records
+// its elapsed ticks here, and the switch happens as the primitive ends
+static volatile int preempt_off = 0;
+static int preempt_pending = 0;
+static uint64 pending_elapsed;
+
+// registered with the kernel by thread_start_threading().
+static volatile struct upcall timer;
+
+// the policy SCHEDPOLICY builds in, unless thread_set_policy() picks another
+#if defined(THREAD_SCHEDULER_HRRN)
+#define DEFAULT_POLICY "HRRN"
+#elif defined(THREAD_SCHEDULER_PRIORITY_RR)
+#define DEFAULT_POLICY "PRR"
+#elif defined(THREAD_SCHEDULER_MLFQ)
+#define DEFAULT_POLICY "MLFQ"
+#elif defined(THREAD_SCHEDULER_STRIDE)
+#define DEFAULT_POLICY "STRIDE"
+#elif defined(THREAD_SCHEDULER_LOTTERY)
+#define DEFAULT_POLICY "LOTTERY"
+#elif defined(THREAD_SCHEDULER_EDF_CBS)
+#define DEFAULT_POLICY "EDF_CBS"
+#elif defined(THREAD_SCHEDULER_DM)
+#define DEFAULT_POLICY "DM"
+#else
+#define DEFAULT_POLICY "DEFAULT"
+#endif
+
+static struct threads_sched_policy *policy = NULL;
+
+// M:N mode, see thread_start_workers()
+enum { MT_PREEMPTED, MT_YIELDED, MT_EXITED }; // why a thread went back to its worker
+static int nworkers = 0;
+static void __mt_back(int why);
+static struct thread *__mutex_handoff(struct thread_mutex *m, int now);
 
 void __dispatch(void);
 void __schedule(void);
 
+static void __heap_add(struct heap *h, struct heap_node *n)
+{
+    if (heap_push(h, n) < 0) {
+        fprintf(2, "[FATAL] out of memory for the thread queues\n");
+        exit(1);
+    }
+}
+
+static void __run_queue_add(struct thread *t)
+{
+    t->queued = 1;
+    list_add_tail(&t->thread_list, &run_queue);
+    if (policy->enqueue)
+        policy->enqueue(t);
+}
+
+static void __run_queue_del(struct thread *t)
+{
+    if (policy->dequeue)
+        policy->dequeue(t);
+    list_del(&t->thread_list);
+    t->queued = 0;
+}
+
+void __run_queue_move_tail(struct thread *t)
+{
+    if (policy->dequeue)
+        policy->dequeue(t);
+    list_del(&t->thread_list);
+    list_add_tail(&t->thread_list, &run_queue);
+    if (policy->enqueue)
+        policy->enqueue(t);
+}
+
+static int __release_less(struct heap_node *a, struct heap_node *b)
+{
+    struct release_queue_entry *x = heap_entry(a, struct release_queue_entry, node);
+    struct release_queue_entry *y = heap_entry(b, struct release_queue_entry, node);
+
+    if (x->release_time != y->release_time)
+        return x->release_time < y->release_time;
+    return x->seq < y->seq;
+}
+
+// call handler(arg) with the running context saved in *ctx
+// once the process has run for delay more ticks.
+static void __arm(volatile struct upcall *u, int delay, struct uctx *ctx, void (*handler)(void *), void *arg)
+{
+    u->delay = 0;
+    u->ctx = (uint64)ctx;
+    u->handler = (uint64)handler;
+    u->arg = (uint64)arg;
+    u->elapsed = 0;
+    __sync_synchronize();
+    u->delay = delay;
+}
+
+// cancel the timer; returns the ticks run since __arm().
+static int __disarm(volatile struct upcall *u)
+{
+    u->delay = 0;
+    __sync_synchronize();
+    return u->elapsed;
+}
+
 struct thread *thread_create(void (*f)(void *), void *arg, int is_real_time, int processing_time, int period, int n)
 {
     static int _id = 1;
     struct thread *t = (struct thread *)malloc(sizeof(struct thread));
     unsigned long new_stack_p;
     unsigned long new_stack;
-    new_stack = (unsigned long)malloc(sizeof(unsigned long) * 0x200);
-    new_stack_p = new_stack + 0x200 * 8 - 0x2 * 8;
+    new_stack = (unsigned long)malloc(STACK_SIZE);
+    new_stack_p = new_stack + STACK_SIZE - 0x2 * 8;
     t->fp = f;
     t->arg = arg;
     t->ID = _id++;
     t->buf_set = 0;
+    t->sched = NULL;
+    t->metrics = NULL;
+    INIT_LIST_HEAD(&t->admit_list);
+    INIT_LIST_HEAD(&t->held);
+    t->blocked_on = NULL;
+    t->donor = NULL;
+    t->queued = 0;
     t->stack = (void *)new_stack;
     t->stack_p = (void *)new_stack_p;
 
@@ -42,8 +164,10 @@ struct thread *thread_create(void (*f)(void *), void *arg, int is_real_time, int
     t->remaining_time = processing_time;
     t->current_deadline = 0;
     t->priority = 100;
+    t->weight = 1;
     t->arrival_time = 30000;
-    
+    init_thread_cbs(t, processing_time, 1);
+
     return t;
 }
 
@@ -51,6 +175,52 @@ void thread_set_priority(struct thread *t, int priority)
 {
     t->priority = priority;
 }
+void thread_set_weight(struct thread *t, int weight)
+{
+    t->weight = weight > 0 ? weight : 1;
+}
+void thread_set_verbose(int v)
+{
+    verbose = v;
+}
+// with metrics on, thread_start_threading() collects per-thread
+// times into histograms and prints them when it returns.
+void thread_set_metrics(int on)
+{
+    metrics = on;
+}
+// with inherit 0, mutex owners keep their own priority and deadline
+// while more urgent threads wait for them.
+void thread_set_inherit(int v)
+{
+    inherit = v;
+}
+// with miss_exit 0, a missed deadline is counted and the job dropped
+// instead of ending the program.
+void thread_set_miss_exit(int v)
+{
+    miss_exit = v;
+}
+int thread_set_policy(char *name)
+{
+    struct threads_sched_policy *p = threads_sched_find(name);
+
+    if (p == NULL)
+        return -1;
+    policy = p;
+    return 0;
+}
+static void __default_policy(void)
+{
+    if (policy == NULL && thread_set_policy(DEFAULT_POLICY) < 0) {
+        fprintf(2, "[FATAL] scheduling policy %s is not built in\n", DEFAULT_POLICY);
+        exit(1);
+    }
+}
+void thread_get_stats(struct thread_stats *s)
+{
+    *s = stats;
+}
 void init_thread_cbs(struct thread *t, int budget, int is_hard_rt)
 {
     t->cbs.budget = budget;
@@ -70,47 +240,246 @@ void thread_add_at(struct thread *t, int arrival_time)
     if (t->is_real_time) {
         t->current_deadline = arrival_time + t->deadline;
     }
-    list_add_tail(&new_entry->thread_list, &release_queue);
+    new_entry->seq = release_seq++;
+    __heap_add(&release_queue, &new_entry->node);
+}
+// thread_add_at() a real-time thread only if the policy's
+// schedulability test says it and the threads admitted before it
+// will all meet their deadlines. Returns 0 if it was added, 1 if it
+// was added with a lower CBS budget, and -1 if it was not.
+int thread_admit(struct thread *t, int arrival_time)
+{
+    int r = 0;
+
+    __default_policy();
+    if (t->is_real_time && policy->admit) {
+        if (t->period <= 0 || (r = policy->admit(&admitted, t)) < 0)
+            return -1;
+        list_add_tail(&t->admit_list, &admitted);
+    }
+    thread_add_at(t, arrival_time);
+    return r;
+}
+
+// Metrics. Each hook does nothing unless thread_set_metrics(1).
+
+static struct thread_metrics *__metrics(struct thread *t)
+{
+    struct thread_metrics *m = t->metrics;
+
+    if (!metrics)
+        return NULL;
+    if (m == NULL) {
+        if ((m = malloc(sizeof(*m))) == NULL) {
+            fprintf(2, "[FATAL] out of memory for thread metrics\n");
+            exit(1);
+        }
+        memset(m, 0, sizeof(*m));
+        m->ID = t->ID;
+        list_add_tail(&m->list, &metrics_list);
+        t->metrics = m;
+    }
+    return m;
+}
+
+static int __bucket(int v)
+{
+    int b = 0;
+
+    while (v > 0 && b < METRICS_BUCKETS - 1) {
+        v >>= 1;
+        b++;
+    }
+    return b;
+}
+
+// a job of t was released
+static void __metrics_release(struct thread *t)
+{
+    struct thread_metrics *m = __metrics(t);
+
+    if (m == NULL)
+        return;
+    m->released_at = t->arrival_time;
+    m->job_run = 0;
+    m->started = 0;
+}
+
+static void __metrics_dispatch(struct thread *t)
+{
+    struct thread_metrics *m = __metrics(t);
+
+    if (m == NULL || m->started)
+        return;
+    m->started = 1;
+    m->response[__bucket(threading_system_time - m->released_at)]++;
+}
+
+// t ran for elapsed ticks; preempted if its job is not done
+static void __metrics_ran(struct thread *t, int elapsed, int preempted)
+{
+    struct thread_metrics *m = __metrics(t);
+
+    if (m == NULL)
+        return;
+    m->run += elapsed;
+    m->job_run += elapsed;
+    m->preemptions += preempted;
+}
+
+// t's job ended now, completed or dropped
+static void __metrics_job_end(struct thread *t)
+{
+    struct thread_metrics *m = __metrics(t);
+    int wait, late;
+
+    if (m == NULL)
+        return;
+    m->jobs++;
+    wait = threading_system_time - m->released_at - m->job_run;
+    m->wait += wait;
+    m->waits[__bucket(wait)]++;
+    if (t->is_real_time || t->period > 0) {
+        late = threading_system_time - t->current_deadline;
+        m->lateness[__bucket(late)]++;
+        if (late > m->max_lateness)
+            m->max_lateness = late;
+    }
+}
+
+static void __metrics_print_hist(char *name, int *hist)
+{
+    printf("  %s:", name);
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        if (hist[b] == 0)
+            continue;
+        if (b == 0)
+            printf(" 0:%d", hist[b]);
+        else if (b == METRICS_BUCKETS - 1)
+            printf(" %d+:%d", 1 << (b - 1), hist[b]);
+        else
+            printf(" %d-%d:%d", 1 << (b - 1), (1 << b) - 1, hist[b]);
+    }
+    printf("\n");
+}
+
+// print and free what was collected.
+static void __metrics_dump(void)
+{
+    struct thread_metrics *m, *n, total;
+    int b;
+
+    memset(&total, 0, sizeof(total));
+    list_for_each_entry_safe(m, n, &metrics_list, list) {
+        printf("thread#%d: %d jobs, ran %d, waited %d, %d preemptions, max lateness %d\n",
+               m->ID, m->jobs, m->run, m->wait, m->preemptions, m->max_lateness);
+        total.jobs += m->jobs;
+        total.run += m->run;
+        total.wait += m->wait;
+        total.preemptions += m->preemptions;
+        if (m->max_lateness > total.max_lateness)
+            total.max_lateness = m->max_lateness;
+        for (b = 0; b < METRICS_BUCKETS; b++) {
+            total.response[b] += m->response[b];
+            total.waits[b] += m->waits[b];
+            total.lateness[b] += m->lateness[b];
+        }
+        list_del(&m->list);
+        free(m);
+    }
+    printf("all threads: %d jobs, ran %d, waited %d, %d preemptions, max lateness %d\n",
+           total.jobs, total.run, total.wait, total.preemptions, total.max_lateness);
+    __metrics_print_hist("response", total.response);
+    __metrics_print_hist("wait", total.waits);
+    __metrics_print_hist("lateness", total.lateness);
 }
 
 void __release()
 {
-    struct release_queue_entry *cur, *nxt;
-    list_for_each_entry_safe(cur, nxt, &release_queue, thread_list) {
-        if (threading_system_time >= cur->release_time) {
-            cur->thrd->remaining_time = cur->thrd->processing_time;
-            cur->thrd->current_deadline = cur->release_time + cur->thrd->deadline;
-            list_add_tail(&cur->thrd->thread_list, &run_queue);
-            list_del(&cur->thread_list);
-            free(cur);
+    struct release_queue_entry *cur, *nxt, *pos;
+    struct heap_node *n;
+    LIST_HEAD(due);
+
+    // due entries join the run queue in the order they were
+    // added, whatever their release times.
+    while ((n = heap_top(&release_queue)) != NULL) {
+        cur = heap_entry(n, struct release_queue_entry, node);
+        if (threading_system_time < cur->release_time)
+            break;
+        heap_pop(&release_queue);
+        list_for_each_entry_reverse(pos, &due, thread_list) {
+            if (pos->seq < cur->seq)
+                break;
         }
+        list_add(&cur->thread_list, &pos->thread_list);
+    }
+
+    list_for_each_entry_safe(cur, nxt, &due, thread_list) {
+        cur->thrd->remaining_time = cur->thrd->processing_time;
+        cur->thrd->current_deadline = cur->release_time + cur->thrd->deadline;
+        __metrics_release(cur->thrd);
+        if (policy->on_release)
+            policy->on_release(cur->thrd);
+        __run_queue_add(cur->thrd);
+        list_del(&cur->thread_list);
+        free(cur);
     }
 }
 
 void __thread_exit(struct thread *to_remove)
 {
     current = to_remove->thread_list.prev;
-    list_del(&to_remove->thread_list);
+    __run_queue_del(to_remove);
+    list_del(&to_remove->admit_list);
+    // the mutexes it still holds go to their waiters
+    while (!list_empty(&to_remove->held))
+        __mutex_handoff(list_entry(to_remove->held.next, struct thread_mutex, held_list), threading_system_time);
 
-    free(to_remove->stack);
-    free(to_remove);
+    // this may still be running on its stack, which the scheduler's
+    // malloc() calls must not be given; __reap() frees it later
+    list_add_tail(&to_remove->thread_list, &zombies);
 
     __schedule();
     __dispatch();
-    thrdresume(main_thrd_id);
+    uctx_resume(&main_ctx);
+}
+
+// count a job of t completing at time now.
+static void __job_done(struct thread *t, int now)
+{
+    stats.jobs++;
+    stats.turnaround += now - t->arrival_time;
+    if (!t->is_real_time && t->period > 0 && now > t->current_deadline)
+        stats.misses++;
+}
+
+// t missed its deadline at time at; ends the program unless
+// thread_set_miss_exit(0) was called.
+static void __deadline_missed(struct thread *t, int at, char *where)
+{
+    if (miss_exit) {
+        printf("thread#%d misses a deadline at %d in %s\n", t->ID, at, where);
+        exit(0);
+    }
+    stats.misses++;
 }
 
 void thread_exit(void)
 {
+    if (nworkers)
+        __mt_back(MT_EXITED);
     if (current == &run_queue) {
         fprintf(2, "[FATAL] thread_exit is called on a nonexistent thread\n");
         exit(1);
     }
 
     struct thread *to_remove = list_entry(current, struct thread, thread_list);
-    int consume_ticks = cancelthrdstop(to_remove->thrdstop_context_id, 1);
+    int consume_ticks = __disarm(&timer);
     threading_system_time += consume_ticks;
 
+    __job_done(to_remove, threading_system_time);
+    __metrics_ran(to_remove, consume_ticks, 0);
+    __metrics_job_end(to_remove);
     __release();
     __thread_exit(to_remove);
 }
@@ -120,74 +489,135 @@ void __finish_current()
     struct thread *current_thread = list_entry(current, struct thread, thread_list);
     --current_thread->n;
 
-    printf("thread#%d finish at %d\n",
-           current_thread->ID, threading_system_time, current_thread->n);
+    if (verbose)
+        printf("thread#%d finish at %d\n",
+               current_thread->ID, threading_system_time, current_thread->n);
+    __job_done(current_thread, threading_system_time);
+    __metrics_job_end(current_thread);
 
     if (current_thread->n > 0) {
-        struct list_head *to_remove = current;
         current = current->prev;
-        list_del(to_remove);
+        __run_queue_del(current_thread);
         thread_add_at(current_thread, current_thread->current_deadline);
     } else {
         __thread_exit(current_thread);
     }
 }
-void __rt_finish_current()
+// end the current job of a real-time thread; completed is 0 if it
+// missed its deadline and is dropped.
+void __rt_finish_current(int completed)
 {
     struct thread *current_thread = list_entry(current, struct thread, thread_list);
     --current_thread->n;
 
-    printf("thread#%d finish one cycle at %d: %d cycles left\n",
-           current_thread->ID, threading_system_time, current_thread->n);
+    if (completed) {
+        if (verbose)
+            printf("thread#%d finish one cycle at %d: %d cycles left\n",
+                   current_thread->ID, threading_system_time, current_thread->n);
+        __job_done(current_thread, threading_system_time);
+    }
+    __metrics_job_end(current_thread);
 
     if (current_thread->n > 0) {
-        struct list_head *to_remove = current;
         current = current->prev;
-        list_del(to_remove);
+        __run_queue_del(current_thread);
         thread_add_at(current_thread, current_thread->current_deadline);
         if (!current_thread->cbs.is_hard_rt) {
             current_thread->cbs.remaining_budget = current_thread->cbs.budget;
+            current_thread->cbs.is_throttled = 0;
         }
     } else {
         __thread_exit(current_thread);
     }
 }
 
-void switch_handler(void *arg)
+// charge the current thread for the elapsed ticks it ran.
+static void __charge(struct thread *current_thread, int elapsed_time)
 {
-    uint64 elapsed_time = (uint64)arg;
-    struct thread *current_thread = list_entry(current, struct thread, thread_list);
-
     threading_system_time += elapsed_time;
      __release();
     current_thread->remaining_time -= elapsed_time;
     if (!current_thread->cbs.is_hard_rt) {
         current_thread->cbs.remaining_budget -= elapsed_time;
     }
-    if (current_thread->is_real_time)
-        if (threading_system_time > current_thread->current_deadline || 
-            (threading_system_time == current_thread->current_deadline && current_thread->remaining_time > 0)) {
-            printf("thread#%d misses a deadline at %d in swicth\n", current_thread->ID, threading_system_time);
-            exit(0);
-        }
+    if (policy->on_tick)
+        policy->on_tick(current_thread, elapsed_time);
+    __metrics_ran(current_thread, elapsed_time, 0);
+}
+
+void switch_handler(void *arg)
+{
+    uint64 elapsed_time = (uint64)arg;
+    struct thread *current_thread = list_entry(current, struct thread, thread_list);
 
-    if (current_thread->remaining_time <= 0) {
+    __charge(current_thread, elapsed_time);
+
+    // a throttled job has been given a later deadline
+    if (current_thread->is_real_time && !current_thread->cbs.is_throttled &&
+        (threading_system_time > current_thread->current_deadline ||
+         (threading_system_time == current_thread->current_deadline && current_thread->remaining_time > 0))) {
+        __deadline_missed(current_thread, threading_system_time, "swicth");
+        __rt_finish_current(0);
+    } else if (current_thread->remaining_time <= 0) {
         if (current_thread->is_real_time)
-            __rt_finish_current();
+            __rt_finish_current(1);
         else
             __finish_current();
     } else {
         // move the current thread to the end of the run_queue
-        struct list_head *to_remove = current;
+        __metrics_ran(current_thread, 0, 1);
         current = current->prev;
-        list_del(to_remove);
-        list_add_tail(to_remove, &run_queue);
+        __run_queue_move_tail(current_thread);
     }
 
     __release();
     __schedule();
     __dispatch();
-    thrdresume(main_thrd_id);
+    uctx_resume(&main_ctx);
+}
+
+// the timer upcall: switch threads, unless the running one is in a
+// sync primitive, which then switches as it ends.
+static void __timer_handler(void *arg)
+{
+    if (preempt_off) {
+        preempt_pending = 1;
+        pending_elapsed = (uint64)arg;
+        uctx_resume(&list_entry(current, struct thread, thread_list)->ctx);
+    }
+    switch_handler(arg);
+}
+
+// give up the rest of the time slice: the scheduler runs as if
+// the timer had gone off, charging the ticks used so far.
+void thread_yield(void)
+{
+    if (nworkers) {
+        __mt_back(MT_YIELDED);
+        return;
+    }
+    struct thread *current_thread = list_entry(current, struct thread, thread_list);
+    int consume_ticks = __disarm(&timer);
+
+    if (uctx_save(&current_thread->ctx) == 0)
+        switch_handler((void *)(uint64)consume_ticks);
+}
+
+// free the threads that have exited, except one whose stack this
+// is running on.
+static void __reap(void)
+{
+    struct thread *t, *n;
+    char here;
+
+    list_for_each_entry_safe(t, n, &zombies, thread_list) {
+        if ((char *)t->stack <= &here && &here < (char *)t->stack + STACK_SIZE)
+            continue;
+        list_del(&t->thread_list);
+        free(t->sched);
+        free(t->stack);
+        free(t);
+    }
 }
 
 void __dispatch()
@@ -195,6 +625,7 @@ void __dispatch()
     if (current == &run_queue) {
         return;
     }
+    __reap();
 
     if (allocated_time < 0) {
         fprintf(2, "[FATAL] allocated_time is negative\n");
@@ -203,24 +634,30 @@ void __dispatch()
 
     struct thread *current_thread = list_entry(current, struct thread, thread_list);
     if (current_thread->is_real_time && allocated_time == 0) {
-        printf("thread#%d misses a deadline at %d in dispatch\n", current_thread->ID, current_thread->current_deadline);
-        exit(0);
+        __deadline_missed(current_thread, current_thread->current_deadline, "dispatch");
+        // drop the job and pick again
+        __rt_finish_current(0);
+        __release();
+        __schedule();
+        __dispatch();
+        return;
     }
 
-    printf("dispatch thread#%d at %d: allocated_time=%d\n", current_thread->ID, threading_system_time, allocated_time);
+    if (verbose)
+        printf("dispatch thread#%d at %d: allocated_time=%d\n", current_thread->ID, threading_system_time, allocated_time);
+    __metrics_dispatch(current_thread);
+    // the job's first dispatch
+    if (current_thread->remaining_time == current_thread->processing_time) {
+        stats.started++;
+        stats.response += threading_system_time - current_thread->arrival_time;
+    }
 
+    __arm(&timer, allocated_time, &current_thread->ctx, __timer_handler, (void *)allocated_time);
     if (current_thread->buf_set) {
-        thrdstop(allocated_time, &(current_thread->thrdstop_context_id), switch_handler, (void *)allocated_time);
-        thrdresume(current_thread->thrdstop_context_id);
+        uctx_resume(&current_thread->ctx);
     } else {
         current_thread->buf_set = 1;
         unsigned long new_stack_p = (unsigned long)current_thread->stack_p;
-        current_thread->thrdstop_context_id = -1;
-        thrdstop(allocated_time, &(current_thread->thrdstop_context_id), switch_handler, (void *)allocated_time);
-        if (current_thread->thrdstop_context_id < 0) {
-            fprintf(2, "[ERROR] number of threads may exceed MAX_THRD_NUM\n");
-            exit(1);
-        }
 
         // set sp to stack pointer of current thread.
         asm volatile("mv sp, %0"
@@ -240,36 +677,8 @@ void __schedule()
         .release_queue = &release_queue,
     };
 
-    struct threads_sched_result r;
-
-#ifdef THREAD_SCHEDULER_DEFAULT
-    r = schedule_default(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_HRRN
-    r = schedule_hrrn(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_PRIORITY_RR
-    r = schedule_priority_rr(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_EDF_CBS
-    r = schedule_edf_cbs(args);
-#endif
-
-#ifdef THREAD_SCHEDULER_DM
-    r = schedule_dm(args);
-#endif
-// #if defined(THREAD_SCHEDULER_HRRN)
-//     r = schedule_hrrn(args);
-// #elif defined(THREAD_SCHEDULER_PRIORITY_RR)
-//     r = schedule_priority_rr(args);
-// #elif defined(THREAD_SCHEDULER_EDF_CBS)
-//     r = schedule_edf_cbs(args);
-// #else
-//     r = schedule_default(args);
-// #endif
+    struct threads_sched_result r = policy->pick_next(args);
+    stats.decisions++;
 
     current = r.scheduled_thread_list_member;
     allocated_time = r.allocated_time;
@@ -279,35 +688,691 @@ void back_to_main_handler(void *arg)
 {
     sleeping = 0;
     threading_system_time += (uint64)arg;
-    thrdresume(main_thrd_id);
+    uctx_resume(&main_ctx);
 }
 
 void thread_start_threading()
 {
     threading_system_time = 0;
     current = &run_queue;
+    memset(&stats, 0, sizeof(stats));
+    nblocked = 0;
+    preempt_off = 0;
+    preempt_pending = 0;
 
-    // call thrdstop just for obtain an ID
-    thrdstop(1000, &main_thrd_id, back_to_main_handler, (void *)0);
-    cancelthrdstop(main_thrd_id, 0);
+    __default_policy();
+    if (policy->init)
+        policy->init();
 
-    while (!list_empty(&run_queue) || !list_empty(&release_queue)) {
+    if (thrdupcall((struct upcall *)&timer) < 0) {
+        fprintf(2, "[FATAL] thrdupcall failed\n");
+        exit(1);
+    }
+
+    while (!list_empty(&run_queue) || !heap_empty(&release_queue)) {
         __release();
         __schedule();
-        cancelthrdstop(main_thrd_id, 0);
+        // threads that exit or end their time slice resume here.
+        __disarm(&timer);
+        uctx_save(&main_ctx);
+        __reap();
         __dispatch();
 
-        if (list_empty(&run_queue) && list_empty(&release_queue)) {
+        if (list_empty(&run_queue) && heap_empty(&release_queue)) {
             break;
         }
 
         // no thread in run_queue, release_queue not empty
-        printf("run_queue is empty, sleep for %d ticks\n", allocated_time);
+        if (verbose)
+            printf("run_queue is empty, sleep for %d ticks\n", allocated_time);
         sleeping = 1;
-        thrdstop(allocated_time, &main_thrd_id, back_to_main_handler, (void *)allocated_time);
+        __arm(&timer, allocated_time, &main_ctx, back_to_main_handler, (void *)allocated_time);
         while (sleeping) {
             // zzz...
         }
     }
+    if (nblocked) {
+        fprintf(2, "[FATAL] %d threads blocked forever\n", nblocked);
+        exit(1);
+    }
+    stats.time = threading_system_time;
+    if (metrics)
+        __metrics_dump();
 }
 
+// Sync primitives
+//
+// They run with preemption off, from __sync_enter() to __sync_leave(),
+// so their lists change as if at once. A thread that has to wait is
+// charged the ticks it ran, leaves the run queue for the waiters list
+// of the mutex, condition variable or semaphore, and the scheduler
+// picks another; waking it puts it back at the tail of the run queue,
+// and switches to it at once if the policy's before() runs it first.
+//
+// A mutex goes straight from its owner to the waiter woken, so no
+// other thread can take it in between. With thread_set_inherit(1),
+// the default, a policy with before() orders an owner as the most
+// urgent thread waiting for it, directly or through a chain of
+// owners, so that thread waits at most for the critical sections
+// in its way, not for the threads that come between.
+
+static struct thread *__sync_enter(void)
+{
+    if (nworkers || current == &run_queue) {
+        fprintf(2, "[FATAL] sync primitives are only for the threads of thread_start_threading\n");
+        exit(1);
+    }
+    preempt_off = 1;
+    __sync_synchronize();
+    return list_entry(current, struct thread, thread_list);
+}
+
+// the time now, counting the ticks of the current time slice.
+static int __sync_now(void)
+{
+    return threading_system_time + (preempt_pending ? pending_elapsed : timer.elapsed);
+}
+
+// end a primitive: switch threads if the timer went off in it, or
+// if woken, a thread it woke, comes before self.
+static void __sync_leave(struct thread *self, struct thread *woken)
+{
+    int elapsed;
+
+    preempt_off = 0;
+    __sync_synchronize();
+    if (!preempt_pending && (woken == NULL || policy->before == NULL || !policy->before(woken, self)))
+        return;
+    elapsed = __disarm(&timer);
+    if (preempt_pending)
+        elapsed = pending_elapsed;
+    preempt_pending = 0;
+    if (uctx_save(&self->ctx) == 0)
+        switch_handler((void *)(uint64)elapsed);
+}
+
+// recompute what t inherits, then what the owners it is blocked
+// behind do, for as long as that changes.
+static void __pi_update(struct thread *t)
+{
+    struct thread_mutex *m;
+    struct thread *w, *d, *old;
+
+    if (!inherit || policy->before == NULL)
+        return;
+    for (; t != NULL; t = t->blocked_on ? t->blocked_on->owner : NULL) {
+        old = t->donor;
+        t->donor = NULL;
+        d = t;
+        list_for_each_entry(m, &t->held, held_list) {
+            list_for_each_entry(w, &m->waiters, thread_list) {
+                if (policy->before(w, d))
+                    d = w->donor ? w->donor : w;
+            }
+        }
+        t->donor = old;
+        if (d == t)
+            d = NULL;
+        if (d == old)
+            return;
+        // re-key t where the policy keeps it
+        if (t->queued && policy->dequeue)
+            policy->dequeue(t);
+        t->donor = d;
+        if (t->queued && policy->enqueue)
+            policy->enqueue(t);
+    }
+}
+
+// the waiter to wake: the first of the most urgent ones.
+static struct thread *__first_waiter(struct list_head *waiters)
+{
+    struct thread *t, *first = list_entry(waiters->next, struct thread, thread_list);
+
+    if (policy->before == NULL)
+        return first;
+    list_for_each_entry(t, waiters, thread_list) {
+        if (policy->before(t, first))
+            first = t;
+    }
+    return first;
+}
+
+// put the running thread self on waiters and run another, until
+// __wake(self); returns with preemption off again.
+static void __block(struct thread *self, struct list_head *waiters)
+{
+    int elapsed = __disarm(&timer);
+
+    // the timer may have gone off before it was disarmed
+    if (preempt_pending)
+        elapsed = pending_elapsed;
+    preempt_pending = 0;
+    if (uctx_save(&self->ctx) != 0) {
+        preempt_off = 1;
+        __sync_synchronize();
+        return;
+    }
+    preempt_off = 0;
+    // the job is not done until the thread gets past here
+    if (self->remaining_time <= elapsed)
+        self->remaining_time = elapsed + 1;
+    __charge(self, elapsed);
+    self->blocked_at = threading_system_time;
+    nblocked++;
+    current = current->prev;
+    __run_queue_del(self);
+    list_add_tail(&self->thread_list, waiters);
+    if (self->blocked_on)
+        __pi_update(self->blocked_on->owner);
+
+    __release();
+    __schedule();
+    __dispatch();
+    uctx_resume(&main_ctx);
+}
+
+// move t from its waiters list to the tail of the run queue.
+static void __wake(struct thread *t)
+{
+    list_del(&t->thread_list);
+    nblocked--;
+    __pi_update(t);
+    __run_queue_add(t);
+}
+
+void thread_mutex_init(struct thread_mutex *m)
+{
+    m->owner = NULL;
+    INIT_LIST_HEAD(&m->waiters);
+    INIT_LIST_HEAD(&m->held_list);
+}
+
+static void __mutex_lock(struct thread *self, struct thread_mutex *m)
+{
+    struct thread *o;
+
+    if (m->owner == NULL) {
+        m->owner = self;
+        list_add_tail(&m->held_list, &self->held);
+        return;
+    }
+    for (o = m->owner; o != NULL; o = o->blocked_on ? o->blocked_on->owner : NULL) {
+        if (o == self) {
+            fprintf(2, "[FATAL] thread#%d would deadlock on a mutex\n", self->ID);
+            exit(1);
+        }
+    }
+    stats.blocks++;
+    self->blocked_on = m;
+    __block(self, &m->waiters);
+    // the owner has handed m over
+}
+
+// give m, which its owner leaves at time now, to the waiter to
+// wake, if any; returns that waiter.
+static struct thread *__mutex_handoff(struct thread_mutex *m, int now)
+{
+    struct thread *w;
+
+    list_del(&m->held_list);
+    m->owner = NULL;
+    if (list_empty(&m->waiters))
+        return NULL;
+    w = __first_waiter(&m->waiters);
+    stats.blocked += now - w->blocked_at;
+    if (now - w->blocked_at > stats.max_blocked)
+        stats.max_blocked = now - w->blocked_at;
+    w->blocked_on = NULL;
+    m->owner = w;
+    list_add_tail(&m->held_list, &w->held);
+    __wake(w);
+    return w;
+}
+
+static void __mutex_check_owner(struct thread *self, struct thread_mutex *m)
+{
+    if (m->owner != self) {
+        fprintf(2, "[FATAL] thread#%d does not hold the mutex\n", self->ID);
+        exit(1);
+    }
+}
+
+void thread_mutex_lock(struct thread_mutex *m)
+{
+    struct thread *self = __sync_enter();
+
+    __mutex_lock(self, m);
+    __sync_leave(self, NULL);
+}
+
+void thread_mutex_unlock(struct thread_mutex *m)
+{
+    struct thread *self = __sync_enter();
+    struct thread *w;
+
+    __mutex_check_owner(self, m);
+    w = __mutex_handoff(m, __sync_now());
+    // self no longer inherits from the waiters of m
+    __pi_update(self);
+    __sync_leave(self, w);
+}
+
+void thread_cond_init(struct thread_cond *c)
+{
+    INIT_LIST_HEAD(&c->waiters);
+}
+
+void thread_cond_wait(struct thread_cond *c, struct thread_mutex *m)
+{
+    struct thread *self = __sync_enter();
+
+    __mutex_check_owner(self, m);
+    __mutex_handoff(m, __sync_now());
+    __pi_update(self);
+    __block(self, &c->waiters);
+    __mutex_lock(self, m);
+    __sync_leave(self, NULL);
+}
+
+void thread_cond_signal(struct thread_cond *c)
+{
+    struct thread *self = __sync_enter();
+    struct thread *w = NULL;
+
+    if (!list_empty(&c->waiters)) {
+        w = __first_waiter(&c->waiters);
+        __wake(w);
+    }
+    __sync_leave(self, w);
+}
+
+// wakes the waiters in the order they came.
+void thread_cond_broadcast(struct thread_cond *c)
+{
+    struct thread *self = __sync_enter();
+    struct thread *t, *w = NULL;
+
+    while (!list_empty(&c->waiters)) {
+        t = list_entry(c->waiters.next, struct thread, thread_list);
+        __wake(t);
+        if (w == NULL || (policy->before && policy->before(t, w)))
+            w = t;
+    }
+    __sync_leave(self, w);
+}
+
+void thread_sem_init(struct thread_sem *s, int count)
+{
+    s->count = count;
+    INIT_LIST_HEAD(&s->waiters);
+}
+
+void thread_sem_wait(struct thread_sem *s)
+{
+    struct thread *self = __sync_enter();
+
+    if (s->count > 0)
+        s->count--;
+    else
+        __block(self, &s->waiters); // thread_sem_post() hands its unit over
+    __sync_leave(self, NULL);
+}
+
+void thread_sem_post(struct thread_sem *s)
+{
+    struct thread *self = __sync_enter();
+    struct thread *w = NULL;
+
+    if (list_empty(&s->waiters)) {
+        s->count++;
+    } else {
+        w = __first_waiter(&s->waiters);
+        __wake(w);
+    }
+    __sync_leave(self, w);
+}
+
+// M:N mode
+//
+// thread_start_workers(n) runs the threads on n worker processes
+// that share this address space, the calling process and n - 1 made
+// by clone(), so up to n of them run at once on different harts.
+//
+// Each worker round-robins the threads that are not real-time on its
+// own run queue, TIME_QUANTUM ticks at a time, and steals from the
+// tail of another worker's queue when its own is empty. Released jobs
+// of real-time threads instead go on one global queue, which every
+// worker picks from first: by absolute deadline (global EDF), or by
+// relative deadline if the policy is DM, then by ID. A real-time job
+// runs until it finishes, reaches its deadline or the next release,
+// whichever comes first; so it waits at most one quantum for a
+// worker running another kind of thread.
+//
+// Time is uptime() ticks since the start, and work done is counted
+// in the ticks each worker ran the thread for. Nothing is printed;
+// see thread_get_stats(). Threads must not create threads or call
+// malloc() while the workers run.
+
+#define MAX_WORKERS 8
+#define WORKER_STACK 4096
+
+struct worker {
+    // protects run_queue, which other workers steal from
+    volatile int lock;
+    struct list_head run_queue;
+    // the thread running, the release entry of its job if it is
+    // real-time, and what it did when it came back
+    struct thread *current;
+    struct release_queue_entry *job;
+    int why;
+    int elapsed;
+    // the scheduler loop, resumed when current comes back
+    struct uctx ctx;
+    volatile struct upcall timer;
+    int pid;
+};
+
+static struct worker workers[MAX_WORKERS];
+// protects everything below, the release queue, stats and the
+// library's malloc() and free() calls
+static volatile int mt_lock;
+// released real-time jobs, most urgent first
+static struct heap rt_queue;
+// threads that have not exited yet
+static volatile int mt_live;
+static int mt_start;
+static int mt_next;
+static int mt_dm;
+
+static void __lock(volatile int *l)
+{
+    while (__sync_lock_test_and_set(l, 1)) {}
+    __sync_synchronize();
+}
+
+static void __unlock(volatile int *l)
+{
+    __sync_lock_release(l);
+}
+
+static int __mt_now(void)
+{
+    return uptime() - mt_start;
+}
+
+static int __mt_key(struct thread *t)
+{
+    return mt_dm ? t->deadline : t->current_deadline;
+}
+
+static int __rt_less(struct heap_node *a, struct heap_node *b)
+{
+    struct thread *x = heap_entry(a, struct release_queue_entry, node)->thrd;
+    struct thread *y = heap_entry(b, struct release_queue_entry, node)->thrd;
+
+    if (__mt_key(x) != __mt_key(y))
+        return __mt_key(x) < __mt_key(y);
+    return x->ID < y->ID;
+}
+
+static struct worker *__mt_self(void)
+{
+    int pid = getpid();
+
+    for (int i = 0; i < nworkers; i++)
+        if (workers[i].pid == pid)
+            return &workers[i];
+    fprintf(2, "[FATAL] thread library call from outside the workers\n");
+    exit(1);
+}
+
+// move released jobs to rt_queue, and released threads that are not
+// real-time to the workers' run queues in turn. mt_lock must be held.
+static void __mt_release(int now)
+{
+    struct release_queue_entry *e;
+    struct heap_node *n;
+    struct thread *t;
+    struct worker *w;
+
+    while ((n = heap_top(&release_queue)) != NULL) {
+        e = heap_entry(n, struct release_queue_entry, node);
+        if (now < e->release_time)
+            break;
+        heap_pop(&release_queue);
+        t = e->thrd;
+        t->remaining_time = t->processing_time;
+        t->current_deadline = e->release_time + t->deadline;
+        if (t->is_real_time) {
+            __heap_add(&rt_queue, &e->node);
+            continue;
+        }
+        free(e);
+        w = &workers[mt_next++ % nworkers];
+        __lock(&w->lock);
+        list_add_tail(&t->thread_list, &w->run_queue);
+        __unlock(&w->lock);
+    }
+}
+
+// t's current job is over: release its next one, or free it.
+// mt_lock must be held.
+static void __mt_next_job(struct thread *t)
+{
+    if (--t->n > 0) {
+        thread_add_at(t, t->current_deadline);
+        return;
+    }
+    list_del(&t->admit_list);
+    free(t->sched);
+    free(t->stack);
+    free(t);
+    mt_live--;
+}
+
+// pick the next thread for w to run and how many ticks to give it,
+// or return NULL if there is none to run now.
+static struct thread *__mt_pick(struct worker *w, int *allocated)
+{
+    struct release_queue_entry *e;
+    struct heap_node *n;
+    struct thread *t;
+    struct worker *v;
+    int now = __mt_now(), i;
+
+    __lock(&mt_lock);
+    __mt_release(now);
+    stats.decisions++;
+    while ((n = heap_pop(&rt_queue)) != NULL) {
+        e = heap_entry(n, struct release_queue_entry, node);
+        t = e->thrd;
+        if (now < t->current_deadline) {
+            w->job = e;
+            *allocated = t->current_deadline - now;
+            if (t->remaining_time < *allocated)
+                *allocated = t->remaining_time;
+            if ((n = heap_top(&release_queue)) != NULL &&
+                heap_entry(n, struct release_queue_entry, node)->release_time - now < *allocated)
+                *allocated = heap_entry(n, struct release_queue_entry, node)->release_time - now;
+            __unlock(&mt_lock);
+            return t;
+        }
+        // its deadline passed while it waited
+        stats.misses++;
+        free(e);
+        __mt_next_job(t);
+    }
+    __unlock(&mt_lock);
+
+    for (i = 0; i < nworkers; i++) {
+        v = &workers[(w - workers + i) % nworkers];
+        __lock(&v->lock);
+        if (list_empty(&v->run_queue)) {
+            __unlock(&v->lock);
+            continue;
+        }
+        // our own queue from the head, others' from the tail
+        t = list_entry(i == 0 ? v->run_queue.next : v->run_queue.prev, struct thread, thread_list);
+        list_del(&t->thread_list);
+        __unlock(&v->lock);
+        if (i != 0)
+            __sync_fetch_and_add(&stats.steals, 1);
+        *allocated = t->remaining_time < TIME_QUANTUM ? t->remaining_time : TIME_QUANTUM;
+        return t;
+    }
+    return NULL;
+}
+
+// the timer upcall, on the interrupted thread's stack.
+static void __mt_preempt(void *arg)
+{
+    struct worker *w = arg;
+
+    w->elapsed = w->timer.elapsed;
+    w->why = MT_PREEMPTED;
+    uctx_resume(&w->ctx);
+}
+
+// leave the running thread for its worker's scheduler loop; a
+// yielding thread returns from here once it is picked again.
+static void __mt_back(int why)
+{
+    struct worker *w = __mt_self();
+
+    w->elapsed = __disarm(&w->timer);
+    w->why = why;
+    if (why == MT_EXITED || uctx_save(&w->current->ctx) == 0)
+        uctx_resume(&w->ctx);
+}
+
+static void __mt_run(struct worker *w, struct thread *t, int allocated)
+{
+    w->current = t;
+    __arm(&w->timer, allocated, &t->ctx, __mt_preempt, w);
+    if (t->buf_set)
+        uctx_resume(&t->ctx);
+    t->buf_set = 1;
+    asm volatile("mv sp, %0"
+                 :
+                 : "r"(t->stack_p));
+    t->fp(t->arg);
+    thread_exit();
+}
+
+// account for the thread that just came back to w and requeue it.
+static void __mt_put_back(struct worker *w)
+{
+    struct thread *t = w->current;
+    struct release_queue_entry *e = w->job;
+    int now = __mt_now();
+
+    w->current = NULL;
+    w->job = NULL;
+    t->remaining_time -= w->elapsed;
+
+    if (w->why == MT_EXITED) {
+        __lock(&mt_lock);
+        __job_done(t, now);
+        free(e);
+        t->n = 0;
+        __mt_next_job(t);
+        __unlock(&mt_lock);
+    } else if (t->is_real_time) {
+        __lock(&mt_lock);
+        if (now > t->current_deadline || (now == t->current_deadline && t->remaining_time > 0)) {
+            stats.misses++;
+            free(e);
+            __mt_next_job(t);
+        } else if (t->remaining_time <= 0) {
+            __job_done(t, now);
+            free(e);
+            __mt_next_job(t);
+        } else {
+            __heap_add(&rt_queue, &e->node);
+        }
+        __unlock(&mt_lock);
+    } else if (t->remaining_time <= 0) {
+        __lock(&mt_lock);
+        __job_done(t, now);
+        __mt_next_job(t);
+        __unlock(&mt_lock);
+    } else {
+        __lock(&w->lock);
+        list_add_tail(&t->thread_list, &w->run_queue);
+        __unlock(&w->lock);
+    }
+}
+
+static void __mt_loop(struct worker *w)
+{
+    struct thread *t;
+    int allocated;
+
+    w->pid = getpid();
+    if (thrdupcall((struct upcall *)&w->timer) < 0) {
+        fprintf(2, "[FATAL] thrdupcall failed\n");
+        exit(1);
+    }
+
+    // threads that are preempted, yield or exit resume here.
+    uctx_save(&w->ctx);
+    if (w->current)
+        __mt_put_back(w);
+    while (mt_live > 0) {
+        if ((t = __mt_pick(w, &allocated)) != NULL)
+            __mt_run(w, t, allocated);
+        // wait for a release, or for another worker's thread to exit
+        sleep(1);
+    }
+    thrdupcall(0);
+}
+
+static void __mt_worker(void *arg)
+{
+    __mt_loop(arg);
+    exit(0);
+}
+
+void thread_start_workers(int n)
+{
+    char *stacks[MAX_WORKERS];
+    int i;
+
+    if (n < 1)
+        n = 1;
+    if (n > MAX_WORKERS)
+        n = MAX_WORKERS;
+
+    __default_policy();
+    mt_dm = strcmp(policy->name, "DM") == 0;
+    heap_init(&rt_queue, __rt_less);
+    memset(&stats, 0, sizeof(stats));
+    mt_live = release_queue.size;
+    mt_next = 0;
+    for (i = 0; i < n; i++) {
+        workers[i].lock = 0;
+        INIT_LIST_HEAD(&workers[i].run_queue);
+        workers[i].current = NULL;
+        workers[i].job = NULL;
+        workers[i].pid = 0;
+    }
+    nworkers = n;
+    mt_start = uptime();
+
+    for (i = 1; i < n; i++) {
+        stacks[i] = malloc(WORKER_STACK);
+        if (clone(__mt_worker, &workers[i], (void *)(((uint64)stacks[i] + WORKER_STACK) & ~15UL)) < 0) {
+            fprintf(2, "[FATAL] clone failed\n");
+            exit(1);
+        }
+    }
+    __mt_loop(&workers[0]);
+    for (i = 1; i < n; i++)
+        wait(0);
+    for (i = 1; i < n; i++)
+        free(stacks[i]);
+
+    stats.time = __mt_now();
+    nworkers = 0;
+}
@@ -2,7 +2,9 @@
 #define THREADS_H_
 
 #include "user/list.h"
+#include "user/heap.h"
 #include "kernel/types.h"
+#include "user/uctx.h"
 
 struct thread {
     void (*fp)(void *arg);
@@ -11,18 +13,23 @@ struct thread {
     void *stack_p;
     int buf_set;
     struct list_head thread_list;
+    // in the real-time threads thread_admit() let in
+    struct list_head admit_list;
+    // the scheduling policy's own state for this thread, or NULL
+    void *sched;
+    // what thread_set_metrics(1) collected about it, or NULL
+    struct thread_metrics *metrics;
 
-    // When yeild or interrupt are happening,
-    // kernel stores the thread context,
-    // this is index for that.
-    int thrdstop_context_id;
+    // Registers saved when the thread is interrupted by
+    // the timer upcall or switches away itself.
+    struct uctx ctx;
     // a unique ID
     int ID;
     // 1 if real-time, 0 if non-real-time
     int is_real_time;
     // the processing time of the thread
     int processing_time;
-    // weight for WRR
+    // the deadline of each job, relative to its release
     int deadline;
     // the period of the thread
     int period;
@@ -34,6 +41,8 @@ struct thread {
     int current_deadline;
     //The priority of thread
     int priority;
+    // share of the processor under STRIDE and LOTTERY
+    int weight;
     // the time when the thread should be released to run queue, measured in ticks
     int arrival_time;
     //CBS 
@@ -45,23 +54,138 @@ struct thread {
         int throttled_arrived_time;   // Time reset remaining budget
         int throttle_new_deadline;    // New deadline assigned after throttling
     } cbs;
+
+    // sync primitives: the mutex the thread is blocked on, or NULL,
+    // the mutexes it holds, and when it last blocked
+    struct thread_mutex *blocked_on;
+    struct list_head held;
+    int blocked_at;
+    // priority inheritance: the most urgent thread blocked, directly
+    // or through other owners, on a mutex this one holds, if the
+    // policy's before() puts it ahead of this one; NULL if none.
+    // The policy then orders this thread as if it were that one.
+    struct thread *donor;
+    // 1 while in the run queue
+    int queued;
 };
 
 struct release_queue_entry {
     struct thread *thrd;
+    // in the release queue heap, by release_time then seq
+    struct heap_node node;
+    // order the entry was added in
+    int seq;
     // for linked list
     struct list_head thread_list;
     // the time when `thrd` should be released to run queue, measured in ticks
     int release_time;
 };
 
+// what one thread_start_threading() run did
+struct thread_stats {
+    // jobs (periods of periodic threads) completed
+    int jobs;
+    // sum over those jobs of completion minus release time, in ticks
+    int turnaround;
+    // jobs dispatched at least once, and the sum over them of first
+    // dispatch minus release time, in ticks
+    int started;
+    int response;
+    // real-time jobs that missed their deadline, and other periodic
+    // jobs that completed after it
+    int misses;
+    // ticks the run took
+    int time;
+    // scheduling decisions made
+    int decisions;
+    // threads a worker took from another's run queue (M:N mode)
+    int steals;
+    // times threads blocked on a mutex, the ticks they waited for
+    // it, and the longest wait
+    int blocks;
+    int blocked;
+    int max_blocked;
+};
+
+// Histograms of per-job times in ticks: bucket 0 counts times of 0
+// (or less), bucket b > 0 times from 2^(b-1) to 2^b - 1, and the last
+// bucket everything from 2^(METRICS_BUCKETS-2) up.
+#define METRICS_BUCKETS 12
+
+// what thread_set_metrics(1) collects about each thread, dumped at
+// the end of thread_start_threading()
+struct thread_metrics {
+    int ID;
+    // jobs ended, completed or dropped
+    int jobs;
+    // ticks run, and ticks waited in the run queue while released
+    int run;
+    int wait;
+    // time slices that ended with the job not done
+    int preemptions;
+    // the latest any job ended after its deadline
+    int max_lateness;
+    // per job: first dispatch minus release, ticks waited, and end
+    // minus deadline (periodic threads only)
+    int response[METRICS_BUCKETS];
+    int waits[METRICS_BUCKETS];
+    int lateness[METRICS_BUCKETS];
+
+    // the current job
+    int released_at;
+    int job_run;
+    int started;
+    struct list_head list;
+};
+
 struct thread *thread_create(void (*f)(void *), void *arg, int is_real_time, int processing_time, int period, int n);
 void thread_set_weight(struct thread *t, int weight);
 void thread_set_priority(struct thread *t, int priority);
+void thread_set_verbose(int verbose);
+void thread_set_metrics(int on);
 void init_thread_cbs(struct thread *th, int budget, int is_hard_rt);
 void thread_add_at(struct thread *t, int arrival_time);
+int thread_admit(struct thread *t, int arrival_time);
 void thread_exit(void);
+void thread_yield(void);
 void thread_start_threading();
+void thread_start_workers(int nworkers);
+int thread_set_policy(char *name);
+void thread_set_miss_exit(int miss_exit);
+void thread_get_stats(struct thread_stats *s);
 void thread_add_direct(struct thread *t);
 
+// Sync primitives for the threads of thread_start_threading(), not
+// for M:N mode. A blocked thread leaves the run queue until it is
+// woken; the most urgent waiter, by the policy's before(), or else
+// the first, is woken first. Under PRR and DM a mutex owner inherits
+// the priority or deadline of the threads blocked on it.
+struct thread_mutex {
+    struct thread *owner;
+    struct list_head waiters;
+    // in the owner's held list
+    struct list_head held_list;
+};
+
+struct thread_cond {
+    struct list_head waiters;
+};
+
+struct thread_sem {
+    int count;
+    struct list_head waiters;
+};
+
+void thread_set_inherit(int inherit);
+void thread_mutex_init(struct thread_mutex *m);
+void thread_mutex_lock(struct thread_mutex *m);
+void thread_mutex_unlock(struct thread_mutex *m);
+void thread_cond_init(struct thread_cond *c);
+void thread_cond_wait(struct thread_cond *c, struct thread_mutex *m);
+void thread_cond_signal(struct thread_cond *c);
+void thread_cond_broadcast(struct thread_cond *c);
+void thread_sem_init(struct thread_sem *s, int count);
+void thread_sem_wait(struct thread_sem *s);
+void thread_sem_post(struct thread_sem *s);
+
 #endif // THREADS_H_
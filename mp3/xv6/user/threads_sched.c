@@ -6,16 +6,112 @@
 #include <limits.h>
 #define NULL 0
 
-/* default scheduling algorithm */
-#ifdef THREAD_SCHEDULER_DEFAULT
-struct threads_sched_result schedule_default(struct threads_sched_args args)
+// Per-thread state of the policies that keep the run queue in
+// heaps, at thread->sched.
+struct sched_node {
+    struct thread *thrd;
+    // in the policy's run heap
+    struct heap_node run;
+    // in the policy's deadline heap, if it keeps one
+    struct heap_node deadline;
+    // in EDF_CBS's heap of soft real-time threads, by cbs_at
+    struct heap_node cbs;
+    // order of joining the tail of the run queue
+    int seq;
+    // the tick at which EDF_CBS resets the thread's deadline
+    int cbs_at;
+    // MLFQ's queue level, and the ticks run at it since it was entered
+    int level;
+    int used;
+    // STRIDE's virtual time
+    uint64 pass;
+};
+
+#define run_entry(n) (heap_entry(n, struct sched_node, run)->thrd)
+#define deadline_entry(n) (heap_entry(n, struct sched_node, deadline)->thrd)
+#define cbs_entry(n) heap_entry(n, struct sched_node, cbs)
+
+static int run_seq;
+
+// the thread t is ordered as: the one it inherits from, or itself
+static struct thread *__as(struct thread *t)
 {
-    struct thread *thread_with_smallest_id = NULL;
-    struct thread *th = NULL;
-    list_for_each_entry(th, args.run_queue, thread_list) {
-        if (thread_with_smallest_id == NULL || th->ID < thread_with_smallest_id->ID)
-            thread_with_smallest_id = th;
+    return t->donor ? t->donor : t;
+}
+
+static void __heap_add(struct heap *h, struct heap_node *n)
+{
+    if (heap_push(h, n) < 0) {
+        fprintf(2, "[FATAL] out of memory for the run queue\n");
+        exit(1);
+    }
+}
+
+static struct sched_node *__sched_node(struct thread *t)
+{
+    struct sched_node *sn = t->sched;
+
+    if (sn == NULL) {
+        if ((sn = malloc(sizeof(*sn))) == NULL) {
+            fprintf(2, "[FATAL] out of memory for the run queue\n");
+            exit(1);
+        }
+        sn->thrd = t;
+        sn->level = 0;
+        sn->used = 0;
+        sn->pass = 0;
+        t->sched = sn;
     }
+    return sn;
+}
+
+// add t to run (and deadline, if not NULL).
+static void __heap_enqueue(struct thread *t, struct heap *run, struct heap *deadline)
+{
+    struct sched_node *sn = __sched_node(t);
+
+    sn->seq = run_seq++;
+    __heap_add(run, &sn->run);
+    if (deadline)
+        __heap_add(deadline, &sn->deadline);
+}
+
+static void __heap_dequeue(struct thread *t, struct heap *run, struct heap *deadline)
+{
+    struct sched_node *sn = t->sched;
+
+    heap_remove(run, &sn->run);
+    if (deadline)
+        heap_remove(deadline, &sn->deadline);
+}
+
+/* default scheduling algorithm */
+static struct heap default_run;
+
+static int __default_less(struct heap_node *a, struct heap_node *b)
+{
+    return run_entry(a)->ID < run_entry(b)->ID;
+}
+
+static void default_init(void)
+{
+    heap_init(&default_run, __default_less);
+}
+
+static void default_enqueue(struct thread *t)
+{
+    __heap_enqueue(t, &default_run, NULL);
+}
+
+static void default_dequeue(struct thread *t)
+{
+    __heap_dequeue(t, &default_run, NULL);
+}
+
+static struct threads_sched_result schedule_default(struct threads_sched_args args)
+{
+    struct heap_node *n = heap_top(&default_run);
+    struct thread *thread_with_smallest_id = n ? run_entry(n) : NULL;
 
     struct threads_sched_result r;
     if (thread_with_smallest_id != NULL) {
@@ -28,13 +124,23 @@ struct threads_sched_result schedule_default(struct threads_sched_args args)
 
     return r;
 }
-#endif
+
+static struct threads_sched_policy default_policy = {
+    .name = "DEFAULT",
+    .real_time = 0,
+    .init = default_init,
+    .enqueue = default_enqueue,
+    .dequeue = default_dequeue,
+    .pick_next = schedule_default,
+};
 
 /* MP3 Part 1 - Non-Real-Time Scheduling */
 
 // HRRN
-#ifdef THREAD_SCHEDULER_HRRN
-struct threads_sched_result schedule_hrrn(struct threads_sched_args args)
+// response ratios grow at different rates as time passes, so no
+// fixed order of the run queue holds from one decision to the next;
+// HRRN scans it instead.
+static struct threads_sched_result schedule_hrrn(struct threads_sched_args args)
 {
     struct thread *selected = NULL;
 
@@ -54,12 +160,14 @@ struct threads_sched_result schedule_hrrn(struct threads_sched_args args)
             continue;
         }
 
-        int w1 = waiting_time;
-        int b1 = burst_time;
-        int w2 = args.current_time - selected->arrival_time;
-        int b2 = selected->processing_time;
+        long w1 = waiting_time;
+        long b1 = burst_time;
+        long w2 = args.current_time - selected->arrival_time;
+        long b2 = selected->processing_time;
 
-        // Compare (w1 + b1) * b2 vs (w2 + b2) * b1
+        // Compare (w1 + b1) * b2 vs (w2 + b2) * b1, in 64 bits: the
+        // products overflow int once waits reach tens of thousands
+        // of ticks.
         if ((w1 + b1) * b2 > (w2 + b2) * b1 ||
             ((w1 + b1) * b2 == (w2 + b2) * b1 && th->ID < selected->ID)) {
             selected = th;
@@ -78,39 +186,71 @@ struct threads_sched_result schedule_hrrn(struct threads_sched_args args)
 
     return r;
 }
-#endif
 
-#ifdef THREAD_SCHEDULER_PRIORITY_RR
+static struct threads_sched_policy hrrn_policy = {
+    .name = "HRRN",
+    .real_time = 0,
+    .pick_next = schedule_hrrn,
+};
+
+// non-real-time threads first, by priority, then in run queue order
+static struct heap prr_run;
+
+static int __prr_less(struct heap_node *a, struct heap_node *b)
+{
+    struct thread *x = run_entry(a), *y = run_entry(b);
+
+    if (x->is_real_time != y->is_real_time)
+        return y->is_real_time;
+    if (__as(x)->priority != __as(y)->priority)
+        return __as(x)->priority < __as(y)->priority;
+    return heap_entry(a, struct sched_node, run)->seq < heap_entry(b, struct sched_node, run)->seq;
+}
+
+static void prr_init(void)
+{
+    heap_init(&prr_run, __prr_less);
+}
+
+static void prr_enqueue(struct thread *t)
+{
+    __heap_enqueue(t, &prr_run, NULL);
+}
+
+static void prr_dequeue(struct thread *t)
+{
+    __heap_dequeue(t, &prr_run, NULL);
+}
+
+static int prr_before(struct thread *a, struct thread *b)
+{
+    return __as(a)->priority < __as(b)->priority;
+}
+
 // priority Round-Robin(RR)
-struct threads_sched_result schedule_priority_rr(struct threads_sched_args args) 
+static struct threads_sched_result schedule_priority_rr(struct threads_sched_args args) 
 {
     struct thread *selected = NULL;
     int highest_priority = 5;
     int count_in_group = 0;
 
-    struct thread *th = NULL;
+    struct heap_node *n = heap_top(&prr_run);
+    struct heap_node *c1, *c2;
 
-    // First pass: Find highest priority among non-real-time threads
-    list_for_each_entry(th, args.run_queue, thread_list) {
-        if (th->is_real_time)
-            continue;
-        if (th->priority < highest_priority){
-            highest_priority = th->priority;
-            count_in_group = 1;
-        }
-        else if (th->priority == highest_priority){
-            count_in_group++;
-        }
-    }
+    // The first thread of the highest priority among non-real-time
+    // threads (round-robin); priorities above 5 are never picked.
+    if (n != NULL && !run_entry(n)->is_real_time && __as(run_entry(n))->priority <= highest_priority) {
+        selected = run_entry(n);
+        highest_priority = __as(selected)->priority;
+        count_in_group = 1;
 
-    // Second pass: Select first thread with highest priority (round-robin)
-    list_for_each_entry(th, args.run_queue, thread_list) {
-        if (th->is_real_time)
-            continue;
-        if (th->priority == highest_priority) {
-            selected = th;
-            break;  // pick the first one in round-robin order
-        }
+        // the runner-up is one of the top's children
+        c1 = heap_at(&prr_run, 1);
+        c2 = heap_at(&prr_run, 2);
+        if (c2 != NULL && __prr_less(c2, c1))
+            c1 = c2;
+        if (c1 != NULL && !run_entry(c1)->is_real_time && __as(run_entry(c1))->priority == highest_priority)
+            count_in_group++;
     }
     struct threads_sched_result r;
     // TO DO
@@ -124,8 +264,7 @@ struct threads_sched_result schedule_priority_rr(struct threads_sched_args args)
             allocated = args.time_quantum;
 
             // Rotate: only if thread will continue after this slice
-            list_del(&selected->thread_list);
-            list_add_tail(&selected->thread_list, args.run_queue);
+            __run_queue_move_tail(selected);
         }
 
         r.scheduled_thread_list_member = &selected->thread_list;
@@ -137,17 +276,306 @@ struct threads_sched_result schedule_priority_rr(struct threads_sched_args args)
 
     return r;
 }
-#endif
+
+static struct threads_sched_policy prr_policy = {
+    .name = "PRR",
+    .real_time = 0,
+    .init = prr_init,
+    .enqueue = prr_enqueue,
+    .dequeue = prr_dequeue,
+    .pick_next = schedule_priority_rr,
+    .before = prr_before,
+};
+
+// MLFQ
+// multi-level feedback queue: each job starts at level 0 and drops a
+// level whenever it uses up the quantum of its level, so threads
+// that give up the processor early stay ahead of ones that do not.
+// Every mlfq_boost ticks all threads go back to level 0, so the long
+// ones are not starved. Round robin within a level.
+static int mlfq_levels = 3;
+static int mlfq_quanta[MLFQ_MAX_LEVELS] = { 2, 4, 8 };
+static int mlfq_boost = 50;
+static int mlfq_boosted;
+static struct heap mlfq_run;
+
+int threads_sched_mlfq_config(int levels, const int *quanta, int boost_period)
+{
+    int i;
+
+    if (levels < 1 || levels > MLFQ_MAX_LEVELS || boost_period < 0)
+        return -1;
+    for (i = 0; i < levels; i++)
+        if (quanta[i] < 1)
+            return -1;
+    mlfq_levels = levels;
+    for (i = 0; i < levels; i++)
+        mlfq_quanta[i] = quanta[i];
+    mlfq_boost = boost_period;
+    return 0;
+}
+
+static int __mlfq_less(struct heap_node *a, struct heap_node *b)
+{
+    struct sched_node *x = heap_entry(a, struct sched_node, run);
+    struct sched_node *y = heap_entry(b, struct sched_node, run);
+
+    if (x->thrd->is_real_time != y->thrd->is_real_time)
+        return y->thrd->is_real_time;
+    if (x->level != y->level)
+        return x->level < y->level;
+    return x->seq < y->seq;
+}
+
+static void mlfq_init(void)
+{
+    heap_init(&mlfq_run, __mlfq_less);
+    mlfq_boosted = 0;
+}
+
+static void mlfq_enqueue(struct thread *t)
+{
+    __heap_enqueue(t, &mlfq_run, NULL);
+}
+
+static void mlfq_dequeue(struct thread *t)
+{
+    __heap_dequeue(t, &mlfq_run, NULL);
+}
+
+static void mlfq_on_release(struct thread *t)
+{
+    struct sched_node *sn = __sched_node(t);
+
+    sn->level = 0;
+    sn->used = 0;
+}
+
+static void mlfq_on_tick(struct thread *t, int elapsed)
+{
+    struct sched_node *sn = t->sched;
+
+    sn->used += elapsed;
+    if (sn->used < mlfq_quanta[sn->level])
+        return;
+    if (sn->level < mlfq_levels - 1)
+        sn->level++;
+    sn->used = 0;
+    if (sn->run.index >= 0)
+        heap_fix(&mlfq_run, &sn->run);
+}
+
+static struct threads_sched_result schedule_mlfq(struct threads_sched_args args)
+{
+    struct threads_sched_result r;
+    struct release_queue_entry *e;
+    struct sched_node *sn;
+    struct heap_node *n;
+    struct thread *t;
+
+    if (mlfq_boost > 0 && args.current_time - mlfq_boosted >= mlfq_boost) {
+        mlfq_boosted = args.current_time;
+        list_for_each_entry(t, args.run_queue, thread_list) {
+            sn = t->sched;
+            sn->used = 0;
+            if (sn->level != 0) {
+                sn->level = 0;
+                heap_fix(&mlfq_run, &sn->run);
+            }
+        }
+    }
+
+    n = heap_top(&mlfq_run);
+    if (n == NULL || run_entry(n)->is_real_time) {
+        r.scheduled_thread_list_member = args.run_queue;
+        r.allocated_time = 1;
+        return r;
+    }
+    sn = heap_entry(n, struct sched_node, run);
+    t = sn->thrd;
+    r.scheduled_thread_list_member = &t->thread_list;
+    r.allocated_time = mlfq_quanta[sn->level] - sn->used;
+    if (t->remaining_time < r.allocated_time)
+        r.allocated_time = t->remaining_time;
+    // below level 0, a new job (at level 0) cuts the slice short
+    if (sn->level > 0 && (n = heap_top(args.release_queue)) != NULL) {
+        e = heap_entry(n, struct release_queue_entry, node);
+        if (e->release_time - args.current_time < r.allocated_time)
+            r.allocated_time = e->release_time - args.current_time;
+    }
+    return r;
+}
+
+static struct threads_sched_policy mlfq_policy = {
+    .name = "MLFQ",
+    .real_time = 0,
+    .init = mlfq_init,
+    .enqueue = mlfq_enqueue,
+    .dequeue = mlfq_dequeue,
+    .pick_next = schedule_mlfq,
+    .on_tick = mlfq_on_tick,
+    .on_release = mlfq_on_release,
+};
+
+// STRIDE
+// proportional share: each thread has a pass that advances by
+// STRIDE1 / weight for every tick it runs, and the one with the
+// lowest pass runs next, for a quantum. A job joins at the pass of
+// the thread picked last, so time spent before its release earns
+// it nothing.
+#define STRIDE1 (1 << 20)
+
+static struct heap stride_run;
+static uint64 stride_vtime;
+
+static int __stride_less(struct heap_node *a, struct heap_node *b)
+{
+    struct sched_node *x = heap_entry(a, struct sched_node, run);
+    struct sched_node *y = heap_entry(b, struct sched_node, run);
+
+    if (x->thrd->is_real_time != y->thrd->is_real_time)
+        return y->thrd->is_real_time;
+    if (x->pass != y->pass)
+        return x->pass < y->pass;
+    return x->thrd->ID < y->thrd->ID;
+}
+
+static void stride_init(void)
+{
+    heap_init(&stride_run, __stride_less);
+    stride_vtime = 0;
+}
+
+static void stride_enqueue(struct thread *t)
+{
+    __heap_enqueue(t, &stride_run, NULL);
+}
+
+static void stride_dequeue(struct thread *t)
+{
+    __heap_dequeue(t, &stride_run, NULL);
+}
+
+static void stride_on_release(struct thread *t)
+{
+    struct sched_node *sn = __sched_node(t);
+
+    if (sn->pass < stride_vtime)
+        sn->pass = stride_vtime;
+}
+
+static void stride_on_tick(struct thread *t, int elapsed)
+{
+    struct sched_node *sn = t->sched;
+
+    sn->pass += (uint64)elapsed * (STRIDE1 / t->weight);
+    if (sn->run.index >= 0)
+        heap_fix(&stride_run, &sn->run);
+}
+
+static struct threads_sched_result schedule_stride(struct threads_sched_args args)
+{
+    struct threads_sched_result r;
+    struct heap_node *n = heap_top(&stride_run);
+    struct sched_node *sn;
+
+    if (n == NULL || run_entry(n)->is_real_time) {
+        r.scheduled_thread_list_member = args.run_queue;
+        r.allocated_time = 1;
+        return r;
+    }
+    sn = heap_entry(n, struct sched_node, run);
+    stride_vtime = sn->pass;
+    r.scheduled_thread_list_member = &sn->thrd->thread_list;
+    r.allocated_time = sn->thrd->remaining_time < args.time_quantum ? sn->thrd->remaining_time : args.time_quantum;
+    return r;
+}
+
+static struct threads_sched_policy stride_policy = {
+    .name = "STRIDE",
+    .real_time = 0,
+    .init = stride_init,
+    .enqueue = stride_enqueue,
+    .dequeue = stride_dequeue,
+    .pick_next = schedule_stride,
+    .on_tick = stride_on_tick,
+    .on_release = stride_on_release,
+};
+
+// LOTTERY
+// each thread holds weight tickets, and a draw among them picks the
+// thread to run for a quantum; shares come out right on average.
+static uint64 lottery_seed;
+
+static void lottery_init(void)
+{
+    lottery_seed = 1;
+}
+
+static struct threads_sched_result schedule_lottery(struct threads_sched_args args)
+{
+    struct threads_sched_result r;
+    struct thread *th, *selected = NULL;
+    uint64 total = 0, draw;
+
+    list_for_each_entry(th, args.run_queue, thread_list) {
+        if (!th->is_real_time)
+            total += th->weight;
+    }
+    if (total > 0) {
+        lottery_seed = lottery_seed * 6364136223846793005UL + 1442695040888963407UL;
+        draw = (lottery_seed >> 33) % total;
+        list_for_each_entry(th, args.run_queue, thread_list) {
+            if (th->is_real_time)
+                continue;
+            if (draw < th->weight) {
+                selected = th;
+                break;
+            }
+            draw -= th->weight;
+        }
+    }
+
+    if (selected == NULL) {
+        r.scheduled_thread_list_member = args.run_queue;
+        r.allocated_time = 1;
+        return r;
+    }
+    r.scheduled_thread_list_member = &selected->thread_list;
+    r.allocated_time = selected->remaining_time < args.time_quantum ? selected->remaining_time : args.time_quantum;
+    return r;
+}
+
+static struct threads_sched_policy lottery_policy = {
+    .name = "LOTTERY",
+    .real_time = 0,
+    .init = lottery_init,
+    .pick_next = schedule_lottery,
+};
 
 /* MP3 Part 2 - Real-Time Scheduling*/
 
-#if defined(THREAD_SCHEDULER_EDF_CBS) || defined(THREAD_SCHEDULER_DM)
-static struct thread *__check_deadline_miss(struct list_head *run_queue, int current_time)
+// run queue threads by current deadline
+static int __deadline_less(struct heap_node *a, struct heap_node *b)
+{
+    struct thread *x = deadline_entry(a), *y = deadline_entry(b);
+
+    if (x->current_deadline != y->current_deadline)
+        return x->current_deadline < y->current_deadline;
+    return x->ID < y->ID;
+}
+
+// earliest is the run queue thread with the earliest deadline, or NULL.
+static struct thread *__check_deadline_miss(struct threads_sched_args args, struct thread *earliest)
 {
     struct thread *th = NULL;
     struct thread *thread_missing_deadline = NULL;
-    list_for_each_entry(th, run_queue, thread_list) {
-        if (th->current_deadline <= current_time) {
+
+    // only a miss, which ends the program, needs a full scan.
+    if (earliest == NULL || earliest->current_deadline > args.current_time)
+        return NULL;
+    list_for_each_entry(th, args.run_queue, thread_list) {
+        if (th->current_deadline <= args.current_time) {
             if (thread_missing_deadline == NULL)
                 thread_missing_deadline = th;
             else if (th->ID < thread_missing_deadline->ID)
@@ -156,10 +584,10 @@ static struct thread *__check_deadline_miss(struct list_head *run_queue, int cur
     }
     return thread_missing_deadline;
 }
-#endif
 
-#ifdef THREAD_SCHEDULER_DM
 /* Deadline-Monotonic Scheduling */
+static struct heap dm_run, dm_deadline;
+
 static int __dm_thread_cmp(struct thread *a, struct thread *b)
 {
     //To DO
@@ -168,28 +596,51 @@ static int __dm_thread_cmp(struct thread *a, struct thread *b)
     return a->ID - b->ID;
 }
 
-struct threads_sched_result schedule_dm(struct threads_sched_args args)
+// real-time threads first, in deadline-monotonic order
+static int __dm_less(struct heap_node *a, struct heap_node *b)
+{
+    struct thread *x = run_entry(a), *y = run_entry(b);
+
+    if (x->is_real_time != y->is_real_time)
+        return x->is_real_time;
+    return __dm_thread_cmp(__as(x), __as(y)) < 0;
+}
+
+static int dm_before(struct thread *a, struct thread *b)
+{
+    return __dm_thread_cmp(__as(a), __as(b)) < 0;
+}
+
+static void dm_init(void)
+{
+    heap_init(&dm_run, __dm_less);
+    heap_init(&dm_deadline, __deadline_less);
+}
+
+static void dm_enqueue(struct thread *t)
+{
+    __heap_enqueue(t, &dm_run, &dm_deadline);
+}
+
+static void dm_dequeue(struct thread *t)
+{
+    __heap_dequeue(t, &dm_run, &dm_deadline);
+}
+
+static struct threads_sched_result schedule_dm(struct threads_sched_args args)
 {
     struct threads_sched_result r;
 
-    // Release any eligible real-time threads
-    int closest_release_time = __INT_MAX__;
-    struct release_queue_entry *entry, *tmp;
-    list_for_each_entry_safe(entry, tmp, args.release_queue, thread_list) {
-        if (entry->release_time <= args.current_time) {
-            list_del(&entry->thread_list);
-            list_add_tail(&entry->thrd->thread_list, args.run_queue);
-        }else{
-            if (entry->release_time < closest_release_time){
-                closest_release_time = entry->release_time;
-            }
-        }
-    }
+    // __release() has already moved every eligible thread to the
+    // run queue, so the earliest release left is still to come.
+    struct heap_node *n = heap_top(args.release_queue);
+    int closest_release_time = n ? heap_entry(n, struct release_queue_entry, node)->release_time : __INT_MAX__;
 
     // first check if there is any thread has missed its current deadline
     // TO DO
 
-    struct thread *missed = __check_deadline_miss(args.run_queue, args.current_time);
+    n = heap_top(&dm_deadline);
+    struct thread *missed = __check_deadline_miss(args, n ? deadline_entry(n) : NULL);
     if (missed != NULL) {
         // fprintf(1, "a");
         r.scheduled_thread_list_member = &missed->thread_list;
@@ -207,14 +658,9 @@ struct threads_sched_result schedule_dm(struct threads_sched_args args)
     }
     // 3. Find the real-time thread with the earliest deadline
     struct thread *selected = NULL;
-    struct thread *th;
-    list_for_each_entry(th, args.run_queue, thread_list) {
-        if (!th->is_real_time)
-            continue;
-
-        if (selected == NULL || __dm_thread_cmp(th, selected) < 0)
-            selected = th;
-    }
+    n = heap_top(&dm_run);
+    if (n != NULL && run_entry(n)->is_real_time)
+        selected = run_entry(n);
 
     // 4. If no real-time thread found
     if (selected == NULL) {
@@ -225,11 +671,7 @@ struct threads_sched_result schedule_dm(struct threads_sched_args args)
     }
 
     // 5. Allocate time to the thread
-    int next_release_time = __INT_MAX__;
-    list_for_each_entry(entry, args.release_queue, thread_list) {
-        if (entry->release_time < next_release_time)
-            next_release_time = entry->release_time;
-    }
+    int next_release_time = closest_release_time;
 
     int deadline_gap = selected->current_deadline - args.current_time;
     int preempt_gap = next_release_time - args.current_time;
@@ -249,29 +691,389 @@ struct threads_sched_result schedule_dm(struct threads_sched_args args)
     // fprintf(1, "d");
     return r;
 }
-#endif
+
+// worst-case response time of th, one of the admitted threads or t,
+// by response-time analysis: the least R with
+//   R = C + sum over higher-priority threads j of ceil(R / T_j) * C_j,
+// stopping once it passes th's deadline.
+static uint64 __dm_response_time(struct list_head *admitted, struct thread *t, struct thread *th)
+{
+    uint64 r = 0, next = th->processing_time;
+    struct thread *hp;
+
+    while (next != r && next <= th->deadline) {
+        r = next;
+        next = th->processing_time;
+        list_for_each_entry(hp, admitted, admit_list) {
+            if (hp != th && __dm_thread_cmp(hp, th) < 0)
+                next += (r + hp->period - 1) / hp->period * hp->processing_time;
+        }
+        if (t != th && __dm_thread_cmp(t, th) < 0)
+            next += (r + t->period - 1) / t->period * t->processing_time;
+    }
+    return next;
+}
+
+// t only delays the threads it comes before.
+static int dm_admit(struct list_head *admitted, struct thread *t)
+{
+    struct thread *th;
+
+    if (__dm_response_time(admitted, t, t) > t->deadline)
+        return -1;
+    list_for_each_entry(th, admitted, admit_list) {
+        if (__dm_thread_cmp(t, th) < 0 && __dm_response_time(admitted, t, th) > th->deadline)
+            return -1;
+    }
+    return 0;
+}
+
+static struct threads_sched_policy dm_policy = {
+    .name = "DM",
+    .real_time = 1,
+    .init = dm_init,
+    .enqueue = dm_enqueue,
+    .dequeue = dm_dequeue,
+    .pick_next = schedule_dm,
+    .admit = dm_admit,
+    .before = dm_before,
+};
 
 
-#ifdef THREAD_SCHEDULER_EDF_CBS
+/* Earliest-Deadline-First with Constant Bandwidth Server */
+// Hard real-time threads are scheduled by plain EDF. A soft one
+// (cbs.is_hard_rt 0) runs in a CBS with budget Q = cbs.budget per
+// period T: a job that uses up the budget is throttled until its
+// current deadline, then comes back with a full budget and the
+// deadline one period later. And whenever r * T > (d - now) * Q for
+// its remaining budget r and deadline d, the deadline is reset to
+// now + T with a full budget, so it cannot take more than Q/T of
+// the processor from the hard threads.
+//
+// Eligible threads are in edf_run by deadline, throttled ones in
+// edf_throttled by when they come back, and the eligible soft ones
+// also in edf_soft by the tick their deadline is next reset at.
+static struct heap edf_run, edf_throttled, edf_soft;
+
 // EDF with CBS comparation
 static int __edf_thread_cmp(struct thread *a, struct thread *b)
 {
-    // TO DO
+    if (a->current_deadline != b->current_deadline)
+        return a->current_deadline - b->current_deadline;
+    return a->ID - b->ID;
+}
+
+static int __edf_less(struct heap_node *a, struct heap_node *b)
+{
+    return __edf_thread_cmp(run_entry(a), run_entry(b)) < 0;
+}
+
+static int __throttled_less(struct heap_node *a, struct heap_node *b)
+{
+    struct thread *x = run_entry(a), *y = run_entry(b);
+
+    if (x->cbs.throttled_arrived_time != y->cbs.throttled_arrived_time)
+        return x->cbs.throttled_arrived_time < y->cbs.throttled_arrived_time;
+    return x->ID < y->ID;
+}
+
+static int __soft_less(struct heap_node *a, struct heap_node *b)
+{
+    return cbs_entry(a)->cbs_at < cbs_entry(b)->cbs_at;
+}
+
+// the first tick now at which r * T > (d - now) * Q holds for t.
+static int __cbs_reset_at(struct thread *t)
+{
+    int q = t->cbs.budget;
+    int x;
+
+    if (q <= 0)
+        return __INT_MAX__;
+    x = t->current_deadline * q - t->cbs.remaining_budget * t->period;
+    // floor(x / q) + 1
+    return (x >= 0 ? x / q : -((q - 1 - x) / q)) + 1;
+}
+
+static void edf_init(void)
+{
+    heap_init(&edf_run, __edf_less);
+    heap_init(&edf_throttled, __throttled_less);
+    heap_init(&edf_soft, __soft_less);
 }
+
+static void edf_enqueue(struct thread *t)
+{
+    struct sched_node *sn = __sched_node(t);
+
+    if (t->cbs.is_throttled) {
+        __heap_add(&edf_throttled, &sn->run);
+        return;
+    }
+    __heap_add(&edf_run, &sn->run);
+    if (!t->cbs.is_hard_rt) {
+        sn->cbs_at = __cbs_reset_at(t);
+        __heap_add(&edf_soft, &sn->cbs);
+    }
+}
+
+static void edf_dequeue(struct thread *t)
+{
+    struct sched_node *sn = t->sched;
+
+    if (t->cbs.is_throttled) {
+        heap_remove(&edf_throttled, &sn->run);
+        return;
+    }
+    heap_remove(&edf_run, &sn->run);
+    if (!t->cbs.is_hard_rt)
+        heap_remove(&edf_soft, &sn->cbs);
+}
+
+// throttle a soft thread whose budget ran out before its job did.
+static void edf_on_tick(struct thread *t, int elapsed)
+{
+    if (t->cbs.is_hard_rt)
+        return;
+
+    edf_dequeue(t);
+    if (t->cbs.remaining_budget <= 0 && t->remaining_time > 0) {
+        t->cbs.is_throttled = 1;
+        t->cbs.throttled_arrived_time = t->current_deadline;
+        t->cbs.throttle_new_deadline = t->current_deadline + t->period;
+    }
+    edf_enqueue(t);
+}
+
+// bring back the throttled threads and reset the soft deadlines
+// that are due by now.
+static void __edf_replenish(int now)
+{
+    struct heap_node *n;
+    struct thread *t;
+
+    while ((n = heap_top(&edf_throttled)) != NULL &&
+           run_entry(n)->cbs.throttled_arrived_time <= now) {
+        t = run_entry(n);
+        heap_pop(&edf_throttled);
+        t->cbs.is_throttled = 0;
+        t->cbs.remaining_budget = t->cbs.budget;
+        t->current_deadline = t->cbs.throttle_new_deadline;
+        edf_enqueue(t);
+    }
+
+    while ((n = heap_top(&edf_soft)) != NULL && cbs_entry(n)->cbs_at <= now) {
+        t = cbs_entry(n)->thrd;
+        edf_dequeue(t);
+        t->current_deadline = now + t->period;
+        t->cbs.remaining_budget = t->cbs.budget;
+        edf_enqueue(t);
+    }
+}
+
+// when the event at n happens, at the returned time, thread *t
+// becomes eligible with deadline *deadline.
+typedef int (*__edf_event_t)(struct heap_node *n, struct thread **t, int *deadline);
+
+static int __release_event(struct heap_node *n, struct thread **t, int *deadline)
+{
+    struct release_queue_entry *e = heap_entry(n, struct release_queue_entry, node);
+
+    *t = e->thrd;
+    *deadline = e->release_time + e->thrd->deadline;
+    return e->release_time;
+}
+
+static int __throttled_event(struct heap_node *n, struct thread **t, int *deadline)
+{
+    *t = run_entry(n);
+    *deadline = (*t)->cbs.throttle_new_deadline;
+    return (*t)->cbs.throttled_arrived_time;
+}
+
+// the earliest event in the subtree of h at index i, which is
+// ordered by event time, that brings in a thread EDF runs before
+// selected; best if none is earlier than that.
+static int __edf_preempt_at(struct heap *h, int i, __edf_event_t event, struct thread *selected, int best)
+{
+    struct heap_node *n = heap_at(h, i);
+    struct thread *t;
+    int at, deadline;
+
+    if (n == NULL)
+        return best;
+    at = event(n, &t, &deadline);
+    if (at >= best)
+        return best;
+    if (deadline < selected->current_deadline ||
+        (deadline == selected->current_deadline && t->ID < selected->ID))
+        return at;
+    best = __edf_preempt_at(h, 2 * i + 1, event, selected, best);
+    return __edf_preempt_at(h, 2 * i + 2, event, selected, best);
+}
+
+// the processor time th reserves per period: its CBS budget if
+// it is soft, its processing time if hard.
+static int __edf_cost(struct thread *th)
+{
+    return th->cbs.is_hard_rt ? th->processing_time : th->cbs.budget;
+}
+
+#define UTIL_ONE (1UL << 32)
+
+// the utilization of the admitted threads, rounded down into *lo and
+// up into *hi, in units of 1/UTIL_ONE; 0 once it surely exceeds 1.
+static int __edf_util(struct list_head *admitted, uint64 *lo, uint64 *hi)
+{
+    struct thread *th;
+    uint64 c;
+
+    *lo = *hi = 0;
+    list_for_each_entry(th, admitted, admit_list) {
+        c = (uint64)__edf_cost(th) * UTIL_ONE;
+        *lo += c / th->period;
+        *hi += (c + th->period - 1) / th->period;
+        if (*lo > UTIL_ONE)
+            return 0;
+    }
+    return 1;
+}
+
+static uint64 __gcd(uint64 a, uint64 b)
+{
+    while (b) {
+        uint64 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// exactly whether the admitted threads and t use at most the whole
+// processor, for when rounding cannot tell; no if the sum of the
+// fractions gets too big to hold.
+static int __edf_util_exact(struct list_head *admitted, struct thread *t)
+{
+    uint64 num = __edf_cost(t), den = t->period, g;
+    struct thread *th;
+
+    list_for_each_entry(th, admitted, admit_list) {
+        if (den > ((uint64)1 << 62) / th->period || num > ((uint64)1 << 62) / th->period)
+            return 0;
+        num = num * th->period + (uint64)__edf_cost(th) * den;
+        den = den * th->period;
+        g = __gcd(num, den);
+        num /= g;
+        den /= g;
+        if (num > den)
+            return 0;
+    }
+    return 1;
+}
+
+// With every deadline equal to its period, the demand bound test
+// reduces to utilization at most 1. A soft thread that does not fit
+// is let in with the budget that is left, if there is any.
+static int edf_admit(struct list_head *admitted, struct thread *t)
+{
+    uint64 lo, hi, c = (uint64)__edf_cost(t) * UTIL_ONE;
+
+    if (__edf_util(admitted, &lo, &hi)) {
+        if (hi + (c + t->period - 1) / t->period <= UTIL_ONE)
+            return 0;
+        if (lo + c / t->period <= UTIL_ONE && __edf_util_exact(admitted, t))
+            return 0;
+    }
+    if (t->cbs.is_hard_rt || hi >= UTIL_ONE)
+        return -1;
+    c = (UTIL_ONE - hi) * t->period / UTIL_ONE;
+    if (c >= t->cbs.budget)
+        return 0;
+    if (c == 0)
+        return -1;
+    t->cbs.budget = t->cbs.remaining_budget = c;
+    return 1;
+}
+
 //  EDF_CBS scheduler
-struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args)
+static struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args)
 {
     struct threads_sched_result r;
+    struct heap_node *n;
+    int next;
 
     // notify the throttle task
-    // TO DO
+    __edf_replenish(args.current_time);
 
     // first check if there is any thread has missed its current deadline
-    // TO DO
+    n = heap_top(&edf_run);
+    struct thread *missed = __check_deadline_miss(args, n ? run_entry(n) : NULL);
+    if (missed != NULL) {
+        r.scheduled_thread_list_member = &missed->thread_list;
+        r.allocated_time = 0;
+        return r;
+    }
 
-    // handle the case where run queue is empty
-    // TO DO
+    // handle the case where run queue is empty, or every thread in
+    // it is throttled: wait for the next release or replenishment
+    if (n == NULL) {
+        next = __INT_MAX__;
+        if ((n = heap_top(args.release_queue)) != NULL)
+            next = heap_entry(n, struct release_queue_entry, node)->release_time;
+        if ((n = heap_top(&edf_throttled)) != NULL && run_entry(n)->cbs.throttled_arrived_time < next)
+            next = run_entry(n)->cbs.throttled_arrived_time;
+        r.scheduled_thread_list_member = args.run_queue;
+        r.allocated_time = next == __INT_MAX__ ? 1 : next - args.current_time;
+        return r;
+    }
+
+    // run the earliest deadline until it finishes, reaches its
+    // deadline, uses up its budget, or a thread that comes before it
+    // is released or replenished
+    struct thread *selected = run_entry(n);
+    int alloc = selected->remaining_time;
+
+    if (selected->current_deadline - args.current_time < alloc)
+        alloc = selected->current_deadline - args.current_time;
+    if (!selected->cbs.is_hard_rt && selected->cbs.remaining_budget < alloc)
+        alloc = selected->cbs.remaining_budget;
+    next = __edf_preempt_at(args.release_queue, 0, __release_event, selected, __INT_MAX__);
+    next = __edf_preempt_at(&edf_throttled, 0, __throttled_event, selected, next);
+    if (next - args.current_time < alloc)
+        alloc = next - args.current_time;
 
+    r.scheduled_thread_list_member = &selected->thread_list;
+    r.allocated_time = alloc > 0 ? alloc : 0;
     return r;
 }
-#endif
\ No newline at end of file
+
+static struct threads_sched_policy edf_cbs_policy = {
+    .name = "EDF_CBS",
+    .real_time = 1,
+    .init = edf_init,
+    .enqueue = edf_enqueue,
+    .dequeue = edf_dequeue,
+    .pick_next = schedule_edf_cbs,
+    .on_tick = edf_on_tick,
+    .admit = edf_admit,
+};
+
+struct threads_sched_policy *threads_sched_policies[] = {
+    &default_policy,
+    &hrrn_policy,
+    &prr_policy,
+    &mlfq_policy,
+    &stride_policy,
+    &lottery_policy,
+    &dm_policy,
+    &edf_cbs_policy,
+    NULL,
+};
+
+struct threads_sched_policy *threads_sched_find(char *name)
+{
+    for (int i = 0; threads_sched_policies[i]; i++)
+        if (strcmp(threads_sched_policies[i]->name, name) == 0)
+            return threads_sched_policies[i];
+    return NULL;
+}
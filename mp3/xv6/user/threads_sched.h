@@ -2,6 +2,7 @@
 #define THREADS_SCHE_H_
 
 #include "user/list.h"
+#include "user/heap.h"
 
 struct threads_sched_args {
     // the number of ticks since threading starts
@@ -10,8 +11,9 @@ struct threads_sched_args {
     int time_quantum;
     // the linked list containing all the threads available to be run
     struct list_head *run_queue;
-    // the linked list containing all the threads that will be available later
-    struct list_head *release_queue;
+    // the release_queue_entry's of the threads that will be available later,
+    // earliest release_time first
+    struct heap *release_queue;
 };
 
 struct threads_sched_result {
@@ -21,20 +23,48 @@ struct threads_sched_result {
     // the number of ticks allocated for this thread to run
     int allocated_time;
 };
-#ifdef THREAD_SCHEDULER_DEFAULT
-struct threads_sched_result schedule_default(struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_HRRN
-struct threads_sched_result schedule_hrrn (struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_PRIORITY_RR
-struct threads_sched_result schedule_priority_rr(struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_EDF_CBS
-struct threads_sched_result schedule_edf_cbs(struct threads_sched_args args);
-#endif
-#ifdef THREAD_SCHEDULER_DM
-struct threads_sched_result schedule_dm(struct threads_sched_args args);
-#endif
+struct thread;
+
+// A scheduling policy. thread_set_policy() picks one by name before
+// thread_start_threading(); the library tells it which threads are
+// in the run queue and asks it which to run next. All hooks but
+// pick_next may be NULL.
+struct threads_sched_policy {
+    char *name;
+    // 1 if the policy runs real-time threads, 0 if it runs the others
+    int real_time;
+    // reset the policy's state, when threading starts
+    void (*init)(void);
+    // t joined the tail of the run queue
+    void (*enqueue)(struct thread *t);
+    // t left the run queue
+    void (*dequeue)(struct thread *t);
+    // choose the thread to run and for how long
+    struct threads_sched_result (*pick_next)(struct threads_sched_args args);
+    // t ran for elapsed ticks and was stopped
+    void (*on_tick)(struct thread *t, int elapsed);
+    // a new job of t was released, before t is enqueued
+    void (*on_release)(struct thread *t);
+    // schedulability test for thread_admit(): 0 if every thread on
+    // admitted (linked by admit_list) and t would meet its deadlines,
+    // 1 if they would once t's CBS budget was lowered, -1 if not
+    int (*admit)(struct list_head *admitted, struct thread *t);
+    // 1 if a must run before b, counting what each inherits (see
+    // thread->donor); NULL if the policy has no fixed order, and so
+    // no priority inheritance
+    int (*before)(struct thread *a, struct thread *b);
+};
+
+// every policy, NULL-terminated
+extern struct threads_sched_policy *threads_sched_policies[];
+struct threads_sched_policy *threads_sched_find(char *name);
+
+// MLFQ's levels, the quantum of each and the ticks between priority
+// boosts (0 for none); returns -1 if they make no sense.
+#define MLFQ_MAX_LEVELS 8
+int threads_sched_mlfq_config(int levels, const int *quanta, int boost_period);
+
+// move t to the tail of the run queue (threads.c)
+void __run_queue_move_tail(struct thread *t);
 
 #endif
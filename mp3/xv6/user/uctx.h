@@ -0,0 +1,11 @@
+#ifndef UCTX_H_
+#define UCTX_H_
+
+#include "kernel/types.h"
+#include "kernel/upcall.h"
+
+// uctx.S
+int uctx_save(struct uctx *ctx) __attribute__((returns_twice));
+void uctx_resume(struct uctx *ctx) __attribute__((noreturn));
+
+#endif // UCTX_H_
@@ -26,6 +26,8 @@ free(void *ap)
 {
   Header *bp, *p;
 
+  if(ap == 0)
+    return;
   bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
@@ -1,5 +1,6 @@
 struct stat;
 struct rtcdate;
+struct upcall;
 
 // system calls
 int fork(void);
@@ -24,9 +25,11 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 // for mp3
-int thrdstop(int delay, int *thrdstop_context_id_ptr, void (*handler)(void *), void *handler_arg);
-int thrdresume(int thrdstop_context_id);
-int cancelthrdstop( int thrdstop_context_id, int is_exit);
+int thrdupcall(struct upcall*);
+int clone(void (*)(void*), void*, void*);
+int sched_setattr(int, int, int, int);
+int sched_yield(void);
+int setshare(int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -37,7 +37,9 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 # for mp3
-entry("thrdstop");
-entry("thrdresume");
-entry("cancelthrdstop");
+entry("thrdupcall");
+entry("clone");
+entry("sched_setattr");
+entry("sched_yield");
+entry("setshare");
 
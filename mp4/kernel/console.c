@@ -26,23 +26,27 @@
 #define C(x) ((x) - '@') // Control-x
 
 //
-// send one character to the uart.
-// called by printf, and to echo input characters,
+// send one character to the uart, through the
+// kernel printf log so it stays in order.
+// called to echo input characters,
 // but not from write().
 //
 void consputc(int c)
 {
+    push_off();
     if (c == BACKSPACE)
     {
         // if the user typed backspace, overwrite with a space.
-        uartputc_sync('\b');
-        uartputc_sync(' ');
-        uartputc_sync('\b');
+        prputc('\b');
+        prputc(' ');
+        prputc('\b');
     }
     else
     {
-        uartputc_sync(c);
+        prputc(c);
     }
+    prflush();
+    pop_off();
 }
 
 struct
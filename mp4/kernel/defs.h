@@ -82,6 +82,9 @@ int pipewrite(struct pipe *, uint64, int);
 void printf(char *, ...);
 void panic(char *) __attribute__((noreturn));
 void printfinit(void);
+void prputc(int);
+void prflush(void);
+int prgetc(void);
 
 // proc.c
 int cpuid(void);
@@ -115,6 +118,7 @@ void acquire(struct spinlock *);
 int holding(struct spinlock *);
 void initlock(struct spinlock *, char *);
 void release(struct spinlock *);
+int tryacquire(struct spinlock *);
 void push_off(void);
 void pop_off(void);
 
@@ -153,6 +157,7 @@ void uartinit(void);
 void uartintr(void);
 void uartputc(int);
 void uartputc_sync(int);
+void uartkick(void);
 int uartgetc(void);
 
 // vm.c
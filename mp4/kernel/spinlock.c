@@ -40,6 +40,23 @@ void acquire(struct spinlock *lk)
     lk->cpu = mycpu();
 }
 
+// Acquire the lock only if that needs no waiting.
+// Returns 1 if the lock is now held, 0 if not; also 0
+// if this CPU already holds it.
+int tryacquire(struct spinlock *lk)
+{
+    push_off();
+    if (holding(lk) || __sync_lock_test_and_set(&lk->locked, 1) != 0)
+    {
+        pop_off();
+        return 0;
+    }
+
+    __sync_synchronize();
+    lk->cpu = mycpu();
+    return 1;
+}
+
 // Release the lock.
 void release(struct spinlock *lk)
 {
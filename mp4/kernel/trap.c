@@ -160,6 +160,8 @@ void clockintr()
     ticks++;
     wakeup(&ticks);
     release(&tickslock);
+    // send printf() output that lost a race for uart_tx_lock.
+    uartkick();
 }
 
 // check if it's an external interrupt or software interrupt,
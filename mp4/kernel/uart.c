@@ -35,6 +35,8 @@
 #define LSR_RX_READY (1 << 0)   // input is waiting to be read from RHR
 #define LSR_TX_IDLE (1 << 5)    // THR can accept another character to send
 
+#define UART_FIFO_SIZE 16 // bytes the transmit FIFO holds
+
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
@@ -112,9 +114,9 @@ void uartputc(int c)
 }
 
 // alternate version of uartputc() that doesn't
-// use interrupts, for use by kernel printf() and
-// to echo characters. it spins waiting for the uart's
-// output register to be empty.
+// use interrupts, for use by kernel printf() before
+// it is buffered and after a panic. it spins waiting
+// for the uart's output register to be empty.
 void uartputc_sync(int c)
 {
     push_off();
@@ -133,20 +135,43 @@ void uartputc_sync(int c)
     pop_off();
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
+// fill the UART's transmit FIFO, first with kernel printf()
+// output and then, if user is set, from the transmit buffer.
+// the UART only reports it can take a byte once the FIFO is
+// empty, so there is room for a FIFO's worth without asking
+// again. returns the number of bytes sent.
 // caller must hold uart_tx_lock.
-// called from both the top- and bottom-half.
-void uartstart()
+static int uartfill(int user)
 {
-    while (1)
+    int c, n, taken = 0;
+
+    for (n = 0; n < UART_FIFO_SIZE; n++)
     {
-        if (uart_tx_w == uart_tx_r)
+        if ((c = prgetc()) < 0)
         {
-            // transmit buffer is empty.
-            return;
+            if (!user || uart_tx_w == uart_tx_r)
+                break;
+            c = uart_tx_buf[uart_tx_r];
+            uart_tx_r = (uart_tx_r + 1) % UART_TX_BUF_SIZE;
+            taken = 1;
         }
+        WriteReg(THR, c);
+    }
+
+    // maybe uartputc() is waiting for space in the buffer.
+    if (taken)
+        wakeup(&uart_tx_r);
+    return n;
+}
 
+// if the UART is idle, and characters are waiting in
+// the kernel printf() logs or the transmit buffer, send them.
+// caller must hold uart_tx_lock.
+// called from both the top- and bottom-half.
+void uartstart()
+{
+    while (1)
+    {
         if ((ReadReg(LSR) & LSR_TX_IDLE) == 0)
         {
             // the UART transmit holding register is full,
@@ -155,16 +180,29 @@ void uartstart()
             return;
         }
 
-        int c = uart_tx_buf[uart_tx_r];
-        uart_tx_r = (uart_tx_r + 1) % UART_TX_BUF_SIZE;
-
-        // maybe uartputc() is waiting for space in the buffer.
-        wakeup(&uart_tx_r);
-
-        WriteReg(THR, c);
+        if (uartfill(1) == 0)
+        {
+            // transmit buffer is empty.
+            return;
+        }
     }
 }
 
+// send kernel printf() output, if no other CPU holds
+// uart_tx_lock. called by printf() with interrupts off and
+// perhaps other locks held, so it neither waits for the lock
+// nor wakes up writers: a CPU holding the lock sends the new
+// output itself, or the next transmit interrupt or clock
+// tick does.
+void uartkick(void)
+{
+    if (!tryacquire(&uart_tx_lock))
+        return;
+    while ((ReadReg(LSR) & LSR_TX_IDLE) && uartfill(0) > 0)
+        ;
+    release(&uart_tx_lock);
+}
+
 // read one input character from the UART.
 // return -1 if none is waiting.
 int uartgetc(void)
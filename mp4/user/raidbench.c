@@ -0,0 +1,64 @@
+// RAID 1 write benchmark.
+//
+// Writes and syncs a file of the given number of blocks, so that
+// every block goes through bwrite() and its BW_DIAG/BW_ACTION
+// console lines, and reports the ticks taken and the blocks
+// written per tick.
+//
+//   raidbench [blocks [runs]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fcntl.h"
+
+#define BSIZE 1024
+
+char buf[BSIZE];
+
+int run(int nblocks)
+{
+    int fd, i, t0;
+
+    t0 = uptime();
+    fd = open("raidbench.dat", O_CREATE | O_RDWR | O_TRUNC);
+    if (fd < 0)
+    {
+        printf("raidbench: open failed\n");
+        exit(1);
+    }
+    for (i = 0; i < nblocks; i++)
+    {
+        buf[0] = (char)i;
+        if (write(fd, buf, BSIZE) != BSIZE)
+        {
+            printf("raidbench: write failed\n");
+            exit(1);
+        }
+    }
+    close(fd);
+    unlink("raidbench.dat");
+    return uptime() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+    int nblocks = 64, runs = 3;
+    int i, t, total = 0;
+
+    if (argc > 1)
+        nblocks = atoi(argv[1]);
+    if (argc > 2)
+        runs = atoi(argv[2]);
+
+    memset(buf, 'R', BSIZE);
+    for (i = 0; i < runs; i++)
+    {
+        t = run(nblocks);
+        total += t;
+        printf("raidbench: run %d: %d blocks in %d ticks\n", i, nblocks, t);
+    }
+    if (total > 0)
+        printf("raidbench: %d blocks/tick\n", nblocks * runs / total);
+    exit(0);
+}